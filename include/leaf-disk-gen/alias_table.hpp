@@ -0,0 +1,162 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_ALIAS_TABLE_HPP
+#define LEAF_DISK_GEN_ALIAS_TABLE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <leaf-disk-gen/common.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup alias_table Alias table
+ *
+ * `<leaf-disk-gen/alias_table.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Alias table.
+ *
+ * Discrete distribution over @f$ n @f$ indices, sampled in constant 
+ * time by Walker's alias method. The table is built in linear time
+ * by Vose's algorithm.
+ */
+class AliasTable
+{
+public:
+
+    /**
+     * @brief Default constructor.
+     */
+    AliasTable() = default;
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] weights
+     * Non-negative weights, not necessarily normalized.
+     *
+     * @param[in] n
+     * Number of weights.
+     */
+    AliasTable(const Float* weights, std::size_t n)
+    {
+        init(weights, n);
+    }
+
+    /**
+     * @brief Initialize.
+     *
+     * @note
+     * If the weights sum to zero, the table falls back to the uniform 
+     * distribution so that sampling is always well-defined.
+     */
+    void init(const Float* weights, std::size_t n);
+
+    /**
+     * @brief Size.
+     */
+    std::size_t size() const
+    {
+        return entries_.size();
+    }
+
+    /**
+     * @brief Sum of weights.
+     */
+    Float sum() const
+    {
+        return sum_;
+    }
+
+    /**
+     * @brief Sample index.
+     *
+     * @param[inout] u
+     * Canonical random sample. On return, this holds a new canonical 
+     * random sample recovered from the bits not consumed by the alias 
+     * lookup, which is independent of the returned index.
+     */
+    std::size_t sample(Float& u) const
+    {
+        assert(!entries_.empty());
+        Float x = u * entries_.size();
+        std::size_t k = static_cast<std::size_t>(x);
+        if (k > entries_.size() - 1) {
+            k = entries_.size() - 1;
+        }
+        const Entry& entry = entries_[k];
+        Float f = x - k;
+        if (f < entry.prob) {
+            u = f / entry.prob;
+            return k;
+        }
+        else {
+            u = (f - entry.prob) / (1 - entry.prob);
+            return entry.alias;
+        }
+    }
+
+private:
+
+    /**
+     * @brief Entry.
+     */
+    struct Entry
+    {
+        /**
+         * @brief Probability of keeping index rather than alias.
+         */
+        Float prob = 1;
+
+        /**
+         * @brief Alias index.
+         */
+        std::uint32_t alias = 0;
+    };
+
+    /**
+     * @brief Entries.
+     */
+    std::vector<Entry> entries_;
+
+    /**
+     * @brief Sum of weights.
+     */
+    Float sum_ = 0;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_ALIAS_TABLE_HPP
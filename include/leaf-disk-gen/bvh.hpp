@@ -0,0 +1,348 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_BVH_HPP
+#define LEAF_DISK_GEN_BVH_HPP
+
+#include <cstdint>
+#include <vector>
+#include <preform/aabb.hpp>
+#include <leaf-disk-gen/common.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup bvh Bounding volume hierarchy
+ *
+ * `<leaf-disk-gen/bvh.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Bounding volume hierarchy.
+ *
+ * Binary hierarchy over primitive bounding boxes, built top-down with
+ * the binned surface area heuristic (SAH). The top levels are split 
+ * serially, then the remaining subtrees are built in parallel. The 
+ * hierarchy only stores primitive indices, so callers are responsible 
+ * for primitive storage and intersection, typically by reordering 
+ * primitives according to `primIndices()` for locality.
+ */
+class Bvh
+{
+public:
+
+    /**
+     * @brief Node.
+     *
+     * Bounds are stored in single precision, rounded outward, so that 
+     * nodes are 32 bytes. Children of interior nodes are adjacent.
+     */
+    struct Node
+    {
+        /**
+         * @brief Lower bound.
+         */
+        float lower[3];
+
+        /**
+         * @brief Upper bound.
+         */
+        float upper[3];
+
+        /**
+         * @brief First child index if interior, or first primitive 
+         * position if leaf.
+         */
+        std::uint32_t offset;
+
+        /**
+         * @brief Primitive count, or zero if interior.
+         */
+        std::uint32_t count;
+    };
+
+public:
+
+    /**
+     * @brief Build.
+     *
+     * @param[in] prim_bounds
+     * Primitive bounding boxes.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     */
+    void build(
+            const std::vector<pre::aabb3<Float>>& prim_bounds, 
+            unsigned int num_threads = 0);
+
+    /**
+     * @brief Nodes.
+     */
+    const std::vector<Node>& nodes() const
+    {
+        return nodes_;
+    }
+
+    /**
+     * @brief Primitive indices, in hierarchy order.
+     */
+    const std::vector<std::uint32_t>& primIndices() const
+    {
+        return prim_indices_;
+    }
+
+    /**
+     * @brief Intersect ray.
+     *
+     * Visits leaves in approximately front-to-back order, invoking 
+     * `func(position, tmax)` for each primitive position in each leaf 
+     * overlapping the ray segment. The function may shrink `tmax` on 
+     * hit, and returns true to terminate traversal early.
+     *
+     * @param[in] org
+     * Ray origin.
+     *
+     * @param[in] dir
+     * Ray direction.
+     *
+     * @param[in] tmin
+     * Ray parameter minimum.
+     *
+     * @param[inout] tmax
+     * Ray parameter maximum.
+     *
+     * @param[in] func
+     * Function.
+     */
+    template <typename Func>
+    void intersectRay(
+            const Vec3<Float>& org, 
+            const Vec3<Float>& dir,
+            Float tmin,
+            Float& tmax,
+            Func&& func) const
+    {
+        if (nodes_.empty()) {
+            return;
+        }
+        Vec3<Float> inv_dir = {
+            1 / dir[0],
+            1 / dir[1],
+            1 / dir[2]
+        };
+        struct Entry {
+            std::uint32_t node;
+            Float tnear;
+        };
+        Entry stack[max_depth + 2];
+        int stack_size = 0;
+        Float tnear = 0;
+        if (!intersectNode(nodes_[0], org, inv_dir, tmin, tmax, tnear)) {
+            return;
+        }
+        stack[stack_size++] = {0, tnear};
+        while (stack_size > 0) {
+            Entry entry = stack[--stack_size];
+            if (entry.tnear > tmax) {
+                continue;
+            }
+            const Node& node = nodes_[entry.node];
+            if (node.count > 0) {
+                for (std::uint32_t pos = node.offset; 
+                                   pos < node.offset + node.count; pos++) {
+                    if (func(pos, tmax)) {
+                        return;
+                    }
+                }
+            }
+            else {
+                Float tnear0 = 0;
+                Float tnear1 = 0;
+                bool hit0 = intersectNode(
+                        nodes_[node.offset + 0], 
+                        org, inv_dir, tmin, tmax, tnear0);
+                bool hit1 = intersectNode(
+                        nodes_[node.offset + 1], 
+                        org, inv_dir, tmin, tmax, tnear1);
+                if (hit0 && hit1) {
+                    // Push far child first.
+                    if (tnear0 <= tnear1) {
+                        stack[stack_size++] = {node.offset + 1, tnear1};
+                        stack[stack_size++] = {node.offset + 0, tnear0};
+                    }
+                    else {
+                        stack[stack_size++] = {node.offset + 0, tnear0};
+                        stack[stack_size++] = {node.offset + 1, tnear1};
+                    }
+                }
+                else if (hit0) {
+                    stack[stack_size++] = {node.offset + 0, tnear0};
+                }
+                else if (hit1) {
+                    stack[stack_size++] = {node.offset + 1, tnear1};
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Overlap box.
+     *
+     * Invokes `func(position)` for each primitive position in each
+     * leaf overlapping the box. The function returns true to terminate
+     * traversal early.
+     */
+    template <typename Func>
+    void overlapBox(const pre::aabb3<Float>& box, Func&& func) const
+    {
+        if (nodes_.empty()) {
+            return;
+        }
+        std::uint32_t stack[max_depth + 2];
+        int stack_size = 0;
+        stack[stack_size++] = 0;
+        while (stack_size > 0) {
+            const Node& node = nodes_[stack[--stack_size]];
+            bool overlaps = true;
+            for (int j = 0; j < 3; j++) {
+                if (box[1][j] < node.lower[j] ||
+                    box[0][j] > node.upper[j]) {
+                    overlaps = false;
+                    break;
+                }
+            }
+            if (!overlaps) {
+                continue;
+            }
+            if (node.count > 0) {
+                for (std::uint32_t pos = node.offset; 
+                                   pos < node.offset + node.count; pos++) {
+                    if (func(pos)) {
+                        return;
+                    }
+                }
+            }
+            else {
+                stack[stack_size++] = node.offset + 1;
+                stack[stack_size++] = node.offset + 0;
+            }
+        }
+    }
+
+private:
+
+    /**
+     * @brief Maximum depth.
+     */
+    static constexpr int max_depth = 96;
+
+    /**
+     * @brief Intersect node bounds by slab test.
+     */
+    static bool intersectNode(
+            const Node& node,
+            const Vec3<Float>& org,
+            const Vec3<Float>& inv_dir,
+            Float tmin,
+            Float tmax,
+            Float& tnear)
+    {
+        for (int j = 0; j < 3; j++) {
+            Float t0 = (node.lower[j] - org[j]) * inv_dir[j];
+            Float t1 = (node.upper[j] - org[j]) * inv_dir[j];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            // Written so that NaN, from zero times infinity, does 
+            // not reject the node.
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+        }
+        tnear = tmin;
+        return tmin <= tmax;
+    }
+
+    /**
+     * @brief Subtree build task.
+     */
+    struct BuildTask
+    {
+        /**
+         * @brief Node index.
+         */
+        std::uint32_t node;
+
+        /**
+         * @brief Primitive position range.
+         */
+        std::uint32_t begin, end;
+
+        /**
+         * @brief Depth.
+         */
+        int depth;
+    };
+
+    /**
+     * @brief Build node.
+     *
+     * If `tasks` is non-null, ranges not exceeding `task_size` are 
+     * deferred as tasks rather than built.
+     */
+    void buildNode(
+            std::vector<Node>& nodes,
+            std::uint32_t node_index,
+            std::uint32_t begin,
+            std::uint32_t end,
+            int depth,
+            const std::vector<pre::aabb3<Float>>& prim_bounds,
+            const std::vector<Vec3<Float>>& prim_centers,
+            std::size_t task_size,
+            std::vector<BuildTask>* tasks);
+
+private:
+
+    /**
+     * @brief Nodes.
+     */
+    std::vector<Node> nodes_;
+
+    /**
+     * @brief Primitive indices.
+     */
+    std::vector<std::uint32_t> prim_indices_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_BVH_HPP
@@ -0,0 +1,255 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_CANOPY_ANALYSIS_HPP
+#define LEAF_DISK_GEN_CANOPY_ANALYSIS_HPP
+
+#include <vector>
+#include <leaf-disk-gen/common.hpp>
+#include <leaf-disk-gen/leaf_disk.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup canopy_analysis Canopy analysis
+ *
+ * `<leaf-disk-gen/canopy_analysis.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Canopy analysis.
+ *
+ * Accumulates leaf normals and areas, then computes the directional 
+ * projected leaf area 
+ * @f[
+ *      A_p(\omega) = \sum_k A_k |\omega \cdot \hat{n}_k|
+ * @f]
+ * and the Ross G-function @f$ G(\omega) = A_p(\omega) / \sum_k A_k @f$ 
+ * over a grid of directions.
+ */
+class CanopyAnalysis
+{
+public:
+
+    /**
+     * @brief Direction result.
+     */
+    struct Direction
+    {
+        /**
+         * @brief Zenith angle in degrees.
+         */
+        Float zenith = 0;
+
+        /**
+         * @brief Azimuth angle in degrees.
+         */
+        Float azimuth = 0;
+
+        /**
+         * @brief Projected leaf area.
+         */
+        Float projected_area = 0;
+
+        /**
+         * @brief G-function value.
+         */
+        Float g = 0;
+
+        /**
+         * @brief Reference G-function value, e.g., from the
+         * leaf angle distribution.
+         */
+        Float g_reference = 0;
+    };
+
+public:
+
+    /**
+     * @brief Add leaf.
+     */
+    void addLeaf(const LeafDisk& leaf_disk)
+    {
+        addLeaf(leaf_disk.normal, leaf_disk.computeArea());
+    }
+
+    /**
+     * @brief Add leaf by normal and area.
+     */
+    void addLeaf(const Vec3<Float>& normal, Float area)
+    {
+        normal_x_.push_back(normal[0]);
+        normal_y_.push_back(normal[1]);
+        normal_z_.push_back(normal[2]);
+        area_.push_back(area);
+    }
+
+    /**
+     * @brief Add ground area.
+     */
+    void addGroundArea(Float ground_area)
+    {
+        ground_area_ += ground_area;
+    }
+
+    /**
+     * @brief Number of leaves.
+     */
+    std::size_t numLeaves() const
+    {
+        return area_.size();
+    }
+
+    /**
+     * @brief Total leaf area.
+     */
+    Float leafArea() const;
+
+    /**
+     * @brief Ground area.
+     */
+    Float groundArea() const
+    {
+        return ground_area_;
+    }
+
+    /**
+     * @brief Set direction grid.
+     *
+     * @param[in] num_zenith
+     * Number of zenith angles, evenly spaced from 0 to 90 degrees 
+     * inclusive.
+     *
+     * @param[in] num_azimuth
+     * Number of azimuth angles, evenly spaced from 0 to 360 degrees
+     * exclusive.
+     */
+    void setDirectionGrid(int num_zenith, int num_azimuth);
+
+    /**
+     * @brief Add direction.
+     *
+     * @param[in] zenith
+     * Zenith angle in degrees.
+     *
+     * @param[in] azimuth
+     * Azimuth angle in degrees.
+     */
+    void addDirection(Float zenith, Float azimuth)
+    {
+        Direction direction;
+        direction.zenith = zenith;
+        direction.azimuth = azimuth;
+        directions_.push_back(direction);
+    }
+
+    /**
+     * @brief Compute projected areas and G-function values.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     */
+    void compute(unsigned int num_threads = 0);
+
+    /**
+     * @brief Compute reference G-function values from another 
+     * analysis, e.g., of normals sampled directly from a leaf 
+     * angle distribution.
+     *
+     * @param[in] other
+     * Other analysis, computed over the same direction grid.
+     */
+    void setReference(const CanopyAnalysis& other);
+
+    /**
+     * @brief Directions.
+     */
+    const std::vector<Direction>& directions() const
+    {
+        return directions_;
+    }
+
+public:
+
+    /**
+     * @name Write helpers
+     */
+    /**@{*/
+
+    /**
+     * @brief Write JSON.
+     */
+    void writeJson(std::ostream& ostr) const;
+
+    /**
+     * @brief Write CSV.
+     */
+    void writeCsv(std::ostream& ostr) const;
+
+    /**@}*/
+
+private:
+
+    /**
+     * @brief Normal X-components.
+     */
+    std::vector<Float> normal_x_;
+
+    /**
+     * @brief Normal Y-components.
+     */
+    std::vector<Float> normal_y_;
+
+    /**
+     * @brief Normal Z-components.
+     */
+    std::vector<Float> normal_z_;
+
+    /**
+     * @brief Areas.
+     */
+    std::vector<Float> area_;
+
+    /**
+     * @brief Ground area.
+     */
+    Float ground_area_ = 0;
+
+    /**
+     * @brief Directions.
+     */
+    std::vector<Direction> directions_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_CANOPY_ANALYSIS_HPP
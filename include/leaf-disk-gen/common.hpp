@@ -31,6 +31,7 @@
 #define LEAF_DISK_GEN_COMMON_HPP
 
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <preform/multi.hpp>
 #include <preform/multi_math.hpp>
@@ -100,6 +101,24 @@ Vec3<Float> generateCanonical3(Pcg32& pcg)
     return pre::generate_canonical<Float, 3>(pcg);
 }
 
+/**
+ * @brief Hash combine.
+ *
+ * Mixes `value` into `seed` with the SplitMix64 finalizer. This is 
+ * useful for deriving statistically independent generator seeds from 
+ * a user seed and, e.g., chunk indices, such that results do not 
+ * depend on how work is scheduled across threads.
+ */
+inline
+std::uint64_t hashCombine(std::uint64_t seed, std::uint64_t value)
+{
+    std::uint64_t z = seed ^ (value + 0x9e3779b97f4a7c15ULL + 
+                                (seed << 6) + (seed >> 2));
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
 /**@}*/
 
 } // namespace ld
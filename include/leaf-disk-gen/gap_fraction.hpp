@@ -0,0 +1,196 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_GAP_FRACTION_HPP
+#define LEAF_DISK_GEN_GAP_FRACTION_HPP
+
+#include <memory>
+#include <vector>
+#include <leaf-disk-gen/leaf_disk.hpp>
+#include <leaf-disk-gen/leaf_volume.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup gap_fraction Gap fraction
+ *
+ * `<leaf-disk-gen/gap_fraction.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Gap fraction analysis.
+ *
+ * Estimates directional gap fraction by ray casting through each leaf 
+ * volume, and compares against the Beer-Lambert prediction
+ * @f[
+ *      P(\omega) = 
+ *      \left\langle\exp\left(-G(\omega)\int u_l\,ds\right)\right\rangle
+ * @f]
+ * where @f$ u_l @f$ is the leaf area density of the volume and 
+ * @f$ G @f$ is the G-function of the generated leaves, or of those in
+ * the group of the volume, if grouped. For box volumes, this reduces to
+ * the familiar @f$ \exp(-G(\omega) L / \cos\theta) @f$.
+ */
+class GapFractionAnalysis
+{
+public:
+
+    /**
+     * @brief Result.
+     */
+    struct Result
+    {
+        /**
+         * @brief Volume index.
+         */
+        std::size_t volume = 0;
+
+        /**
+         * @brief Zenith angle in degrees.
+         */
+        Float zenith = 0;
+
+        /**
+         * @brief Number of rays cast.
+         */
+        std::size_t num_rays = 0;
+
+        /**
+         * @brief Azimuth-averaged G-function value.
+         */
+        Float g = 0;
+
+        /**
+         * @brief Gap fraction, measured by ray casting.
+         */
+        Float gap_fraction = 0;
+
+        /**
+         * @brief Gap fraction, as predicted by Beer-Lambert.
+         */
+        Float gap_fraction_beer_lambert = 0;
+    };
+
+public:
+
+    /**
+     * @brief Number of zenith angles, evenly spaced from 0 to 80
+     * degrees inclusive.
+     */
+    int num_zenith = 9;
+
+    /**
+     * @brief Number of azimuth angles, evenly spaced from 0 to 360 
+     * degrees exclusive, over which rays are stratified.
+     */
+    int num_azimuth = 12;
+
+    /**
+     * @brief Number of rays to sample per volume per zenith angle.
+     */
+    std::size_t num_rays = 100000;
+
+    /**
+     * @brief Seed.
+     */
+    std::uint64_t seed = 0;
+
+    /**
+     * @brief Compute.
+     *
+     * @param[in] leaf_disks
+     * Leaf disks.
+     *
+     * @param[in] volumes
+     * Leaf volumes.
+     *
+     * @param[in] lais
+     * Leaf area index per volume.
+     *
+     * @param[in] volume_groups
+     * Group per volume, e.g., by angle distribution, such that the 
+     * G-function for each volume is of the leaf disks of the volumes in
+     * its group. If empty, it is of all leaf disks.
+     *
+     * @param[in] volume_leaf_ends
+     * End of the leaf disks of each volume, for leaf disks in order of 
+     * volume. Ignored if there are no groups.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     */
+    void compute(
+            const std::vector<LeafDisk>& leaf_disks,
+            const std::vector<std::unique_ptr<LeafVolume>>& volumes,
+            const std::vector<Float>& lais,
+            const std::vector<std::size_t>& volume_groups,
+            const std::vector<std::size_t>& volume_leaf_ends,
+            unsigned int num_threads = 0);
+
+    /**
+     * @brief Results.
+     */
+    const std::vector<Result>& results() const
+    {
+        return results_;
+    }
+
+public:
+
+    /**
+     * @name Write helpers
+     */
+    /**@{*/
+
+    /**
+     * @brief Write JSON.
+     */
+    void writeJson(std::ostream& ostr) const;
+
+    /**
+     * @brief Write CSV.
+     */
+    void writeCsv(std::ostream& ostr) const;
+
+    /**@}*/
+
+private:
+
+    /**
+     * @brief Results.
+     */
+    std::vector<Result> results_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_GAP_FRACTION_HPP
@@ -30,7 +30,9 @@
 #ifndef LEAF_DISK_GEN_LEAF_ANGLE_DISTRIBUTION_HPP
 #define LEAF_DISK_GEN_LEAF_ANGLE_DISTRIBUTION_HPP
 
+#include <variant>
 #include <leaf-disk-gen/common.hpp>
+#include <leaf-disk-gen/alias_table.hpp>
 
 namespace ld {
 
@@ -41,6 +43,30 @@ namespace ld {
  */
 /**@{*/
 
+class UniformLeafAngleDistribution;
+class TrigonometricLeafAngleDistribution;
+class VerhoefBimodalLeafAngleDistribution;
+class TrowbridgeReitzLeafAngleDistribution;
+class BeckmannLeafAngleDistribution;
+class TabulatedLeafAngleDistribution;
+
+/**
+ * @brief Leaf angle distribution variant.
+ *
+ * Holds any concrete leaf angle distribution by value. Sampling loops 
+ * should be instantiated per concrete type with `std::visit`, outside
+ * the loop, such that `sampleNormal()` is resolved statically and 
+ * inlined. Where `is_batched` is true, the concrete type also maps
+ * arrays of canonical numbers to normals with `sampleNormals()`.
+ */
+typedef std::variant<
+            UniformLeafAngleDistribution,
+            TrigonometricLeafAngleDistribution,
+            VerhoefBimodalLeafAngleDistribution,
+            TrowbridgeReitzLeafAngleDistribution,
+            BeckmannLeafAngleDistribution,
+            TabulatedLeafAngleDistribution> LeafAngleDistributionVariant;
+
 /**
  * @brief Leaf angle distribution.
  */
@@ -58,12 +84,36 @@ public:
      */
     virtual Vec3<Float> sampleNormal(Pcg32& pcg) const = 0;
 
+    /**
+     * @brief Sample normal direction from canonical numbers.
+     *
+     * Maps 2 canonical numbers to a normal direction, consuming no 
+     * other randomness, for use with low-discrepancy sequences.
+     */
+    virtual Vec3<Float> sampleNormal(const Vec2<Float>& u) const = 0;
+
+    /**
+     * @brief Has batched `sampleNormals()`?
+     *
+     * If so, `sampleNormal(Pcg32&)` consumes exactly 2 canonical 
+     * numbers in order, and is the same as `sampleNormal()` of them, 
+     * such that callers may draw the numbers themselves and map them 
+     * in batches.
+     */
+    static constexpr bool is_batched = false;
+
 public:
 
     /**
      * @brief Initialize from string.
      */
     static LeafAngleDistribution* fromString(const std::string& args);
+
+    /**
+     * @brief Initialize variant from string.
+     */
+    static LeafAngleDistributionVariant variantFromString(
+                                const std::string& args);
 };
 
 /**
@@ -74,9 +124,14 @@ class UniformLeafAngleDistribution final : public LeafAngleDistribution
 public:
 
     /**
-     * @copydoc LeafAngleDistribution::sampleNormal()
+     * @copydoc LeafAngleDistribution::sampleNormal(Pcg32&) const
      */
     Vec3<Float> sampleNormal(Pcg32& pcg) const;
+
+    /**
+     * @copydoc LeafAngleDistribution::sampleNormal(const Vec2<Float>&) const
+     */
+    Vec3<Float> sampleNormal(const Vec2<Float>& u) const;
 };
 
 /**
@@ -87,10 +142,15 @@ class IsotropicLidfLeafAngleDistribution : public LeafAngleDistribution
 public:
 
     /**
-     * @copydoc LeafAngleDistribution::sampleNormal()
+     * @copydoc LeafAngleDistribution::sampleNormal(Pcg32&) const
      */
     Vec3<Float> sampleNormal(Pcg32& pcg) const final;
 
+    /**
+     * @copydoc LeafAngleDistribution::sampleNormal(const Vec2<Float>&) const
+     */
+    Vec3<Float> sampleNormal(const Vec2<Float>& u) const final;
+
 protected:
 
     /**
@@ -239,7 +299,8 @@ private:
 /**
  * @brief Trowbridge-Reitz (GGX) leaf angle distribution.
  */
-class TrowbridgeReitzLeafAngleDistribution : public LeafAngleDistribution
+class TrowbridgeReitzLeafAngleDistribution final : 
+                        public LeafAngleDistribution
 {
 public:
 
@@ -258,10 +319,40 @@ public:
     }
 
     /**
-     * @copydoc LeafAngleDistribution::sampleNormal()
+     * @copydoc LeafAngleDistribution::sampleNormal(Pcg32&) const
      */
     Vec3<Float> sampleNormal(Pcg32& pcg) const;
 
+    /**
+     * @copydoc LeafAngleDistribution::sampleNormal(const Vec2<Float>&) const
+     */
+    Vec3<Float> sampleNormal(const Vec2<Float>& u) const;
+
+    /**
+     * @brief Sample normal directions from canonical numbers.
+     *
+     * Bitwise the same as `sampleNormal()` per element, but 
+     * branch-free, such that the loop vectorizes.
+     *
+     * @param[in] u
+     * Canonical numbers.
+     *
+     * @param[out] normals
+     * Normal directions.
+     *
+     * @param[in] count
+     * Count.
+     */
+    void sampleNormals(
+            const Vec2<Float>* u, 
+            Vec3<Float>* normals, 
+            std::size_t count) const;
+
+    /**
+     * @copydoc LeafAngleDistribution::is_batched
+     */
+    static constexpr bool is_batched = true;
+
 private:
 
     /**
@@ -278,7 +369,8 @@ private:
 /**
  * @brief Beckmann leaf angle distribution.
  */
-class BeckmannLeafAngleDistribution : public LeafAngleDistribution
+class BeckmannLeafAngleDistribution final : 
+                        public LeafAngleDistribution
 {
 public:
 
@@ -297,10 +389,40 @@ public:
     }
 
     /**
-     * @copydoc LeafAngleDistribution::sampleNormal()
+     * @copydoc LeafAngleDistribution::sampleNormal(Pcg32&) const
      */
     Vec3<Float> sampleNormal(Pcg32& pcg) const;
 
+    /**
+     * @copydoc LeafAngleDistribution::sampleNormal(const Vec2<Float>&) const
+     */
+    Vec3<Float> sampleNormal(const Vec2<Float>& u) const;
+
+    /**
+     * @brief Sample normal directions from canonical numbers.
+     *
+     * Bitwise the same as `sampleNormal()` per element, but 
+     * branch-free, such that the loop vectorizes.
+     *
+     * @param[in] u
+     * Canonical numbers.
+     *
+     * @param[out] normals
+     * Normal directions.
+     *
+     * @param[in] count
+     * Count.
+     */
+    void sampleNormals(
+            const Vec2<Float>* u, 
+            Vec3<Float>* normals, 
+            std::size_t count) const;
+
+    /**
+     * @copydoc LeafAngleDistribution::is_batched
+     */
+    static constexpr bool is_batched = true;
+
 private:
 
     /**
@@ -314,6 +436,127 @@ private:
     Float alphay_ = 1;
 };
 
+/**
+ * @brief Tabulated leaf angle distribution.
+ *
+ * Leaf normal histogram binned uniformly in zenith 
+ * @f$ \theta \in [0, \pi/2] @f$ and azimuth @f$ \phi \in [0, 2\pi) @f$.
+ * Sampling selects a zenith bin from the marginal alias table, then
+ * an azimuth bin from the conditional alias table of that zenith bin, 
+ * then jitters uniformly within the selected bin. Sampling is thus 
+ * constant time regardless of table resolution.
+ */
+class TabulatedLeafAngleDistribution final : public LeafAngleDistribution
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] num_theta
+     * Number of zenith bins.
+     *
+     * @param[in] num_phi
+     * Number of azimuth bins.
+     *
+     * @param[in] weights
+     * Bin weights in row-major order, such that the weight of zenith
+     * bin `i` and azimuth bin `j` is `weights[i * num_phi + j]`. 
+     * These need not be normalized.
+     */
+    TabulatedLeafAngleDistribution(
+            int num_theta, 
+            int num_phi, 
+            const std::vector<Float>& weights);
+
+    /**
+     * @copydoc LeafAngleDistribution::sampleNormal(Pcg32&) const
+     */
+    Vec3<Float> sampleNormal(Pcg32& pcg) const;
+
+    /**
+     * @copydoc LeafAngleDistribution::sampleNormal(const Vec2<Float>&) const
+     */
+    Vec3<Float> sampleNormal(const Vec2<Float>& u) const;
+
+public:
+
+    /**
+     * @brief Load from file.
+     *
+     * @par Format
+     * Plain text, whitespace separated. The file begins with the
+     * number of zenith bins and the number of azimuth bins, followed
+     * by the bin weights in row-major order (one zenith bin per row).
+     * Lines beginning with `#` are comments.
+     */
+    static TabulatedLeafAngleDistribution loadFromFile(
+                        const std::string& filename);
+
+private:
+
+    /**
+     * @brief Number of zenith bins.
+     */
+    int num_theta_ = 0;
+
+    /**
+     * @brief Number of azimuth bins.
+     */
+    int num_phi_ = 0;
+
+    /**
+     * @brief Marginal alias table over zenith bins.
+     */
+    AliasTable marginal_;
+
+    /**
+     * @brief Conditional alias tables over azimuth bins, one per 
+     * zenith bin.
+     */
+    std::vector<AliasTable> conditional_;
+};
+
+/**
+ * @brief Leaf angle distribution held by variant, for uses where 
+ * virtual dispatch is acceptable.
+ */
+inline
+const LeafAngleDistribution& toLeafAngleDistribution(
+            const LeafAngleDistributionVariant& variant)
+{
+    return std::visit(
+        [](const auto& distribution) -> const LeafAngleDistribution& {
+            return distribution;
+        }, 
+        variant);
+}
+
+/**
+ * @brief Visit normals at midpoint quadrature nodes.
+ *
+ * Invokes `func(normal)` for each node of a `num_nodes` by `num_nodes`
+ * midpoint grid over the canonical square, mapped through 
+ * `sampleNormal(const Vec2<Float>&)`. The mean of a function over the
+ * nodes is then a deterministic estimate of its expectation over the 
+ * distribution, independent of any seed.
+ */
+template <typename Func>
+inline
+void visitQuadratureNormals(
+            const LeafAngleDistribution& distribution,
+            int num_nodes,
+            Func&& func)
+{
+    for (int i = 0; i < num_nodes; i++)
+    for (int j = 0; j < num_nodes; j++) {
+        func(distribution.sampleNormal(
+             Vec2<Float>{
+                 (i + Float(0.5)) / num_nodes,
+                 (j + Float(0.5)) / num_nodes
+             }));
+    }
+}
 
 /**@}*/
 
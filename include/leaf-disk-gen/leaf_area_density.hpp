@@ -0,0 +1,194 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_AREA_DENSITY_HPP
+#define LEAF_DISK_GEN_LEAF_AREA_DENSITY_HPP
+
+#include <vector>
+#include <preform/aabb.hpp>
+#include <leaf-disk-gen/leaf_disk.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_area_density Leaf area density
+ *
+ * `<leaf-disk-gen/leaf_area_density.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf area density grid.
+ *
+ * Voxelizes leaf disks for turbid medium models. Each disk is 
+ * supersampled by a stratified grid of points over its area, mapped 
+ * concentrically so that every point carries equal area, and each 
+ * point deposits its share of the disk area in the voxel containing
+ * it. Since disks near a face of the bounds stick out by up to their
+ * radius, the grid is padded on each side by as many whole voxels as
+ * cover the largest radius, so that no point lands outside the grid, 
+ * the voxels stay aligned with the bounds, and the outer voxels of 
+ * the bounds hold only the area inside them. Total leaf area is thus
+ * conserved. Optionally, the area-weighted first 
+ * and second moments of the leaf normal are accumulated alongside,
+ * with normals flipped into the upper hemisphere since leaves are
+ * two-sided.
+ *
+ * Leaves are accumulated in parallel, with one grid per thread, and
+ * the grids are summed at the end. The grid is limited to @f$ 2^{26} @f$
+ * values over all channels, and the number of threads accumulating is
+ * limited so that their grids total at most @f$ 2^{27} @f$ values.
+ */
+class LeafAreaDensityGrid
+{
+public:
+
+    /**
+     * @brief Voxel size in meters. The grid spacing is adjusted to 
+     * divide the bounds evenly.
+     */
+    Float voxel_size = 0.1;
+
+    /**
+     * @brief Number of samples per disk, rounded up to a square.
+     */
+    int num_samples = 64;
+
+    /**
+     * @brief Accumulate normal moments?
+     */
+    bool moments = false;
+
+    /**
+     * @brief Compute.
+     *
+     * @param[in] leaf_disks
+     * Leaf disks.
+     *
+     * @param[in] bounds
+     * Bounds, before padding.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     *
+     * @throw std::runtime_error
+     * If the grid would have too many voxels.
+     */
+    void compute(
+            const std::vector<LeafDisk>& leaf_disks,
+            const pre::aabb3<Float>& bounds,
+            unsigned int num_threads = 0);
+
+    /**
+     * @brief Number of channels.
+     *
+     * The first channel is the leaf area density in square meters per 
+     * cubic meter. If accumulating moments, the next 3 channels are 
+     * the mean normal XYZ, and the next 6 are the mean normal outer 
+     * product XX, YY, ZZ, XY, XZ, and YZ, all weighted by area.
+     */
+    int numChannels() const
+    {
+        return moments ? 10 : 1;
+    }
+
+    /**
+     * @brief Number of voxels along each axis.
+     */
+    const int* dims() const
+    {
+        return dims_;
+    }
+
+    /**
+     * @brief Bounds, after padding.
+     */
+    const pre::aabb3<Float>& bounds() const
+    {
+        return bounds_;
+    }
+
+    /**
+     * @brief Voxel spacing.
+     */
+    const Vec3<Float>& spacing() const
+    {
+        return spacing_;
+    }
+
+    /**
+     * @brief Values, with channels fastest, then X, then Y, then Z.
+     */
+    const std::vector<Float>& values() const
+    {
+        return values_;
+    }
+
+public:
+
+    /**
+     * @name Write helpers
+     */
+    /**@{*/
+
+    /**
+     * @brief Write NRRD, with raw little endian single precision data.
+     */
+    void writeNrrd(std::ostream& ostr) const;
+
+    /**@}*/
+
+private:
+
+    /**
+     * @brief Bounds.
+     */
+    pre::aabb3<Float> bounds_;
+
+    /**
+     * @brief Voxel spacing.
+     */
+    Vec3<Float> spacing_;
+
+    /**
+     * @brief Number of voxels along each axis.
+     */
+    int dims_[3] = {};
+
+    /**
+     * @brief Values.
+     */
+    std::vector<Float> values_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_AREA_DENSITY_HPP
@@ -0,0 +1,237 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_CELLS_HPP
+#define LEAF_DISK_GEN_LEAF_CELLS_HPP
+
+#include <preform/aabb.hpp>
+#include <leaf-disk-gen/leaf_disk.hpp>
+#include <leaf-disk-gen/leaf_volume.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_cells Leaf cells
+ *
+ * `<leaf-disk-gen/leaf_cells.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf cell generator.
+ *
+ * Generates leaves procedurally per cell of a square grid over the 
+ * ground footprint of a volume, where each cell is a column spanning 
+ * the volume vertically. Each cell is seeded from the seed and its 
+ * coordinates alone, so any cell may be generated independently, and 
+ * a query over bounds generates only the cells overlapping them. The
+ * number of leaves in a cell is its expected number rounded randomly
+ * up or down, which is unbiased, and leaves whose ground positions 
+ * fall outside the footprint are rejected.
+ */
+class LeafCellGenerator
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] volume
+     * Volume, which must outlive the generator.
+     *
+     * @param[in] lai
+     * Leaf area index.
+     *
+     * @param[in] leaf_radius
+     * Leaf radius.
+     *
+     * @param[in] cell_size
+     * Cell size in meters.
+     *
+     * @param[in] seed
+     * Seed.
+     *
+     * @throw std::runtime_error
+     * If the grid would have too many cells.
+     */
+    LeafCellGenerator(
+            const LeafVolume& volume,
+            Float lai,
+            Float leaf_radius,
+            Float cell_size,
+            std::uint64_t seed);
+
+    /**
+     * @brief Cell range overlapping bounds, from first to last 
+     * exclusive along X and Y. This is empty if there is no overlap.
+     */
+    void cellRange(
+            const pre::aabb3<Float>& bounds, 
+            int first[2], 
+            int last[2]) const;
+
+    /**
+     * @brief Generate leaves in cell.
+     *
+     * @param[in] cell
+     * Cell coordinates.
+     *
+     * @param[in] distribution
+     * Leaf angle distribution.
+     *
+     * @param[in] func
+     * Function to invoke on each leaf.
+     */
+    template <typename Distribution, typename Func>
+    void generateCell(
+            const int cell[2],
+            const Distribution& distribution,
+            Func&& func) const
+    {
+        Pcg32 pcg(cellSeed(cell));
+        std::uint64_t num_leaves = 
+            leaves_per_cell_ + generateCanonical(pcg);
+        for (std::uint64_t k = 0; k < num_leaves; k++) {
+            Vec2<Float> xy = {
+                origin_[0] + (cell[0] + generateCanonical(pcg)) * cell_size_,
+                origin_[1] + (cell[1] + generateCanonical(pcg)) * cell_size_
+            };
+            Float u = generateCanonical(pcg);
+            LeafDisk leaf_disk;
+            leaf_disk.normal = distribution.sampleNormal(pcg);
+            leaf_disk.radius = leaf_radius_;
+            if (volume_->samplePositionAbove(xy, u, leaf_disk.pos)) {
+                func(leaf_disk);
+            }
+        }
+    }
+
+    /**
+     * @brief Generate leaves in cells overlapping bounds, and invoke
+     * function on each leaf positioned within bounds.
+     *
+     * Cells are generated with Y outermost, so leaves are in the same 
+     * order as in `generate()`.
+     */
+    template <typename Distribution, typename Func>
+    void query(
+            const pre::aabb3<Float>& bounds,
+            const Distribution& distribution,
+            Func&& func) const
+    {
+        int first[2];
+        int last[2];
+        cellRange(bounds, first, last);
+        int cell[2];
+        for (cell[1] = first[1]; cell[1] < last[1]; cell[1]++) 
+        for (cell[0] = first[0]; cell[0] < last[0]; cell[0]++) {
+            generateCell(cell, distribution, 
+            [&](const LeafDisk& leaf_disk) {
+                for (int j = 0; j < 3; j++) {
+                    if (!(leaf_disk.pos[j] >= bounds[0][j] && 
+                          leaf_disk.pos[j] <= bounds[1][j])) {
+                        return;
+                    }
+                }
+                func(leaf_disk);
+            });
+        }
+    }
+
+    /**
+     * @brief Generate leaves in all cells.
+     */
+    template <typename Distribution, typename Func>
+    void generate(
+            const Distribution& distribution,
+            Func&& func) const
+    {
+        int cell[2];
+        for (cell[1] = 0; cell[1] < num_cells_[1]; cell[1]++) 
+        for (cell[0] = 0; cell[0] < num_cells_[0]; cell[0]++) {
+            generateCell(cell, distribution, func);
+        }
+    }
+
+private:
+
+    /**
+     * @brief Cell seed.
+     */
+    std::uint64_t cellSeed(const int cell[2]) const
+    {
+        return 
+            hashCombine(
+            hashCombine(seed_, std::uint64_t(cell[0])), 
+                               std::uint64_t(cell[1]));
+    }
+
+private:
+
+    /**
+     * @brief Volume.
+     */
+    const LeafVolume* volume_ = nullptr;
+
+    /**
+     * @brief Leaf radius.
+     */
+    Float leaf_radius_ = 0;
+
+    /**
+     * @brief Cell size.
+     */
+    Float cell_size_ = 0;
+
+    /**
+     * @brief Expected number of leaves per cell.
+     */
+    Float leaves_per_cell_ = 0;
+
+    /**
+     * @brief Grid origin, at the lower XY corner of the volume bounds.
+     */
+    Vec2<Float> origin_;
+
+    /**
+     * @brief Number of cells along X and Y.
+     */
+    int num_cells_[2] = {};
+
+    /**
+     * @brief Seed.
+     */
+    std::uint64_t seed_ = 0;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_CELLS_HPP
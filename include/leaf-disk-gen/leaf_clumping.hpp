@@ -0,0 +1,190 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_CLUMPING_HPP
+#define LEAF_DISK_GEN_LEAF_CLUMPING_HPP
+
+#include <vector>
+#include <leaf-disk-gen/common.hpp>
+#include <leaf-disk-gen/leaf_volume.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_clumping Leaf clumping
+ *
+ * `<leaf-disk-gen/leaf_clumping.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Thomas cluster process leaf clumping.
+ *
+ * Places leaves by a Neyman-Scott process with Gaussian clusters, 
+ * also known as a Thomas process. Cluster centers (parents) are 
+ * placed by the volume, each leaf is assigned to a uniformly random 
+ * parent, and is offset from it by an isotropic Gaussian with 
+ * standard deviation equal to the cluster radius. Offsets are only 
+ * along axes where the volume bounds have positive extent, so that 
+ * flat volumes stay flat, and are reflected at the volume bounds, or, 
+ * if periodic, wrapped around them in X and Y, so that clusters near
+ * the boundary keep all of their leaves. For volumes other than boxes,
+ * offsets that still leave the volume are rejected. The number of 
+ * leaves is unchanged, so LAI is unchanged.
+ *
+ * The number of leaves per cluster is calibrated to a target 
+ * clumping index @f$ \Omega @f$, defined by the nadir gap fraction
+ * @f$ P = \exp(-G \Omega L) @f$. Viewed from nadir, each cluster 
+ * projects to a Gaussian optical depth with peak
+ * @f[
+ *      q = \frac{G m A}{2 \pi \sigma^2}
+ * @f]
+ * for @f$ m @f$ leaves of area @f$ A @f$, and blocks an effective area
+ * of @f$ 2 \pi \sigma^2 \operatorname{Ein}(q) @f$, where
+ * @f[
+ *      \operatorname{Ein}(q) = \int_0^q \frac{1 - e^{-s}}{s}\,ds.
+ * @f]
+ * With Poisson parents, it follows that 
+ * @f$ \Omega = \operatorname{Ein}(q) / q @f$, which is solved for 
+ * @f$ q @f$ and then @f$ m @f$.
+ *
+ * Parents are ordered by a uniform grid, and leaves are ordered by
+ * parent, so nearby leaves are generated together and cost is linear
+ * in the number of leaves and parents.
+ */
+class ThomasLeafClumping
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] volume
+     * Volume, which must outlive this.
+     *
+     * @param[in] num_leaves
+     * Number of leaves.
+     *
+     * @param[in] leaves_per_cluster
+     * Mean number of leaves per cluster.
+     *
+     * @param[in] cluster_radius
+     * Cluster radius, being the standard deviation of offsets.
+     *
+     * @param[in] seed
+     * Seed for placing parents and assigning leaves to them.
+     *
+     * @param[in] periodic
+     * Wrap offsets around the volume bounds in X and Y, as for a 
+     * periodic tile?
+     */
+    ThomasLeafClumping(
+            const LeafVolume& volume,
+            std::size_t num_leaves,
+            Float leaves_per_cluster,
+            Float cluster_radius,
+            std::uint64_t seed,
+            bool periodic = false);
+
+    /**
+     * @brief Number of clusters.
+     */
+    std::size_t numClusters() const
+    {
+        return parents_.size();
+    }
+
+    /**
+     * @brief Sample position of leaf.
+     *
+     * @param[in] k
+     * Leaf index.
+     *
+     * @param[inout] pcg
+     * Generator for offset.
+     */
+    Vec3<Float> samplePosition(std::size_t k, Pcg32& pcg) const;
+
+public:
+
+    /**
+     * @brief Mean number of leaves per cluster for target clumping 
+     * index.
+     *
+     * @param[in] clumping_index
+     * Clumping index, in @f$ (0, 1] @f$.
+     *
+     * @param[in] cluster_radius
+     * Cluster radius.
+     *
+     * @param[in] leaf_area
+     * Area of each leaf.
+     *
+     * @param[in] g
+     * G-function at nadir.
+     */
+    static Float leavesPerCluster(
+            Float clumping_index,
+            Float cluster_radius,
+            Float leaf_area,
+            Float g);
+
+private:
+
+    /**
+     * @brief Volume.
+     */
+    const LeafVolume* volume_ = nullptr;
+
+    /**
+     * @brief Cluster radius.
+     */
+    Float cluster_radius_ = 0;
+
+    /**
+     * @brief Periodic in X and Y?
+     */
+    bool periodic_ = false;
+
+    /**
+     * @brief Parents, in grid order.
+     */
+    std::vector<Vec3<Float>> parents_;
+
+    /**
+     * @brief Parent index of each leaf.
+     */
+    std::vector<std::uint32_t> leaf_parents_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_CLUMPING_HPP
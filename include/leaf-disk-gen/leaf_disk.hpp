@@ -131,10 +131,37 @@ public:
      * the sector it represents.
      */
     void writeObj(std::ostream& ostr, 
-                  unsigned int& ver_offset, 
+                  std::uint64_t& ver_offset, 
                   unsigned int ver_res = 12) const;
 
+    /**
+     * @brief Write OBJ, with relative face indices.
+     *
+     * As `writeObj()`, except that faces index vertices relative to 
+     * the last vertex written, negatively, as in `f -7 -6 -5`. The 
+     * text is then the same wherever the disk is in the file, so disks 
+     * may be written in any number of independent chunks and 
+     * concatenated.
+     *
+     * @param[inout] ostr
+     * Output stream.
+     *
+     * @param[in] ver_res
+     * Vertex resolution.
+     */
+    void writeObjRelative(std::ostream& ostr, 
+                          unsigned int ver_res = 12) const;
+
     /**@}*/
+
+private:
+
+    /**
+     * @brief Write OBJ vertices, returning the vertex resolution as
+     * clamped.
+     */
+    unsigned int writeObjVertices(std::ostream& ostr, 
+                                  unsigned int ver_res) const;
 };
 
 /**@}*/
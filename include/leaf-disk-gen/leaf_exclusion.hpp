@@ -0,0 +1,163 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_EXCLUSION_HPP
+#define LEAF_DISK_GEN_LEAF_EXCLUSION_HPP
+
+#include <string>
+#include <vector>
+#include <leaf-disk-gen/bvh.hpp>
+#include <leaf-disk-gen/leaf_disk.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_exclusion Leaf exclusion
+ *
+ * `<leaf-disk-gen/leaf_exclusion.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf exclusion.
+ *
+ * Triangle meshes that leaves must keep out of, such as trunks and 
+ * branches, through a bounding volume hierarchy over the triangles. 
+ * A leaf disk is excluded if it intersects any triangle, or comes 
+ * within the clearance distance of one, or is inside a closed mesh. 
+ * The surface test is exact for the disk primitive of the GList 
+ * output. Meshes are the connected components of each OBJ, with 
+ * vertices welded by position, and a mesh is closed if every edge is
+ * shared by exactly two triangles. The inside test is by the parity of
+ * ray crossings of each closed mesh, so that overlapping meshes, such
+ * as a branch stuck into the trunk, do not cancel, and open meshes, 
+ * such as uncapped cylinders, are tested by surface only.
+ */
+class LeafExclusion
+{
+public:
+
+    /**
+     * @brief Load OBJ mesh, appending its triangles.
+     *
+     * Reads vertices and faces only, with absolute or relative (negative)
+     * vertex indices. Polygons are fan triangulated, and degenerate 
+     * triangles are skipped. Connected components are found, and those
+     * that are closed are numbered for the inside test.
+     *
+     * @throw std::runtime_error
+     * If the file can't be read, or has malformed vertices or faces.
+     */
+    void loadObj(const std::string& filename);
+
+    /**
+     * @brief Build.
+     *
+     * @param[in] clearance
+     * Clearance distance, in meters.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     */
+    void build(Float clearance, unsigned int num_threads = 0);
+
+    /**
+     * @brief Empty?
+     */
+    bool empty() const
+    {
+        return triangles_.empty();
+    }
+
+    /**
+     * @brief Number of triangles.
+     */
+    std::size_t numTriangles() const
+    {
+        return triangles_.size();
+    }
+
+    /**
+     * @brief Excludes leaf disk?
+     *
+     * This must only be called after `build()`, and is safe to call
+     * concurrently.
+     */
+    bool excludes(const LeafDisk& leaf_disk) const;
+
+private:
+
+    /**
+     * @brief Contains point, by parity of ray crossings of any closed
+     * mesh?
+     */
+    bool contains(const Vec3<Float>& pos) const;
+
+    /**
+     * @brief Triangle.
+     */
+    struct Triangle
+    {
+        /**
+         * @brief Vertices.
+         */
+        Vec3<Float> v[3];
+
+        /**
+         * @brief Closed mesh index, or the maximum if the mesh is open.
+         */
+        std::uint32_t mesh;
+    };
+
+    /**
+     * @brief Clearance distance.
+     */
+    Float clearance_ = 0;
+
+    /**
+     * @brief Number of closed meshes.
+     */
+    std::uint32_t num_closed_meshes_ = 0;
+
+    /**
+     * @brief Bounding volume hierarchy.
+     */
+    Bvh bvh_;
+
+    /**
+     * @brief Triangles, in hierarchy order once built.
+     */
+    std::vector<Triangle> triangles_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_EXCLUSION_HPP
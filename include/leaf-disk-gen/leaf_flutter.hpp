@@ -0,0 +1,226 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_FLUTTER_HPP
+#define LEAF_DISK_GEN_LEAF_FLUTTER_HPP
+
+#include <leaf-disk-gen/leaf_writer.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_flutter Leaf flutter
+ *
+ * `<leaf-disk-gen/leaf_flutter.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf flutter.
+ *
+ * Deterministic per-leaf oscillation model for wind flutter. Each leaf
+ * tilts about the two tangent axes of its rest normal, each by a 
+ * sinusoid of the given amplitude, with phase and frequency (within 
+ * 25 percent of the given frequency) hashed from the seed and the leaf 
+ * index. Positions stay fixed, so evaluating a frame is a hash and a 
+ * few trigonometric functions per leaf, independent of any other leaf 
+ * or frame.
+ */
+class LeafFlutter
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] amplitude
+     * Tilt amplitude in radians.
+     *
+     * @param[in] frequency
+     * Mean frequency in hertz.
+     *
+     * @param[in] seed
+     * Seed.
+     */
+    LeafFlutter(Float amplitude, Float frequency, std::uint64_t seed) :
+            amplitude_(amplitude),
+            frequency_(frequency),
+            seed_(seed)
+    {
+    }
+
+    /**
+     * @brief Perturb rest normal of leaf at time.
+     *
+     * @param[in] normal
+     * Rest normal.
+     *
+     * @param[in] leaf_index
+     * Leaf index.
+     *
+     * @param[in] time
+     * Time in seconds.
+     */
+    Vec3<Float> perturbNormal(
+            const Vec3<Float>& normal,
+            std::uint64_t leaf_index, 
+            Float time) const;
+
+private:
+
+    /**
+     * @brief Tilt amplitude in radians.
+     */
+    Float amplitude_ = 0;
+
+    /**
+     * @brief Mean frequency in hertz.
+     */
+    Float frequency_ = 0;
+
+    /**
+     * @brief Seed.
+     */
+    std::uint64_t seed_ = 0;
+};
+
+/**
+ * @brief Flutter leaf writer.
+ *
+ * Forwards leaves to another writer, keeping each rest normal packed
+ * by `LeafDiskPacker::encodeOctahedral()`. On `finish()`, writes a 
+ * binary flutter file with the perturbed normal of every leaf in every
+ * frame, in the order the leaves were written, so that the canopy is
+ * generated and written once regardless of the number of frames. 
+ *
+ * The flutter file is little endian, with a 32-byte header
+ * - `char[4]` magic `"LDFL"`,
+ * - `uint32` version, currently 1,
+ * - `uint64` number of leaves,
+ * - `uint64` number of frames,
+ * - `float64` frame time in seconds,
+ *
+ * followed by one `uint32` octahedral normal per leaf per frame, with 
+ * frames outermost. This is 4 bytes per leaf per frame, and frame `f` 
+ * is at time `f * frame_time`.
+ */
+class FlutterLeafWriter final : public LeafWriter
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] writer
+     * Writer to forward leaves to.
+     *
+     * @param[in] filename
+     * Flutter filename.
+     *
+     * @param[in] flutter
+     * Flutter model.
+     *
+     * @param[in] num_frames
+     * Number of frames.
+     *
+     * @param[in] frame_time
+     * Frame time in seconds.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     *
+     * @throw std::runtime_error
+     * If the flutter file can't be opened.
+     */
+    FlutterLeafWriter(
+            std::unique_ptr<LeafWriter> writer,
+            const std::string& filename,
+            const LeafFlutter& flutter,
+            std::size_t num_frames,
+            Float frame_time,
+            unsigned int num_threads = 0);
+
+    /**
+     * @copydoc LeafWriter::write()
+     */
+    void write(const LeafDisk& leaf_disk);
+
+    /**
+     * @copydoc LeafWriter::finish()
+     */
+    void finish();
+
+    /**
+     * @copydoc LeafWriter::checkCapacity()
+     */
+    void checkCapacity(std::uint64_t num_leaf_disks) const;
+
+private:
+
+    /**
+     * @brief Writer.
+     */
+    std::unique_ptr<LeafWriter> writer_;
+
+    /**
+     * @brief Output file stream.
+     */
+    std::ofstream ofs_;
+
+    /**
+     * @brief Flutter model.
+     */
+    LeafFlutter flutter_;
+
+    /**
+     * @brief Number of frames.
+     */
+    std::size_t num_frames_ = 0;
+
+    /**
+     * @brief Frame time in seconds.
+     */
+    Float frame_time_ = 0;
+
+    /**
+     * @brief Number of threads.
+     */
+    unsigned int num_threads_ = 0;
+
+    /**
+     * @brief Rest normals, packed.
+     */
+    std::vector<std::uint32_t> normals_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_FLUTTER_HPP
@@ -0,0 +1,152 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_INVENTORY_HPP
+#define LEAF_DISK_GEN_LEAF_INVENTORY_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <leaf-disk-gen/leaf_angle_distribution.hpp>
+#include <leaf-disk-gen/leaf_volume.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_inventory Leaf inventory
+ *
+ * `<leaf-disk-gen/leaf_inventory.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf crown.
+ */
+struct LeafCrown
+{
+    /**
+     * @brief Volume.
+     */
+    std::unique_ptr<LeafVolume> volume;
+
+    /**
+     * @brief Leaf area index over the ground area of the volume.
+     */
+    Float lai = 1;
+
+    /**
+     * @brief Leaf radius.
+     */
+    Float leaf_radius = 0.05;
+
+    /**
+     * @brief Index of angle distribution in the inventory.
+     */
+    std::size_t angle_distribution = 0;
+};
+
+/**
+ * @brief Leaf inventory.
+ *
+ * Crowns of a forest stand, e.g., from a stand inventory, such that 
+ * thousands of crowns may be generated at once. Crowns with the same 
+ * angle distribution string share one distribution.
+ */
+class LeafInventory
+{
+public:
+
+    /**
+     * @brief Load CSV, appending its crowns.
+     *
+     * The first line names the columns, in any order and any case, and
+     * each later line gives one crown. Blank lines and lines starting 
+     * with `#` are skipped, and fields may be double quoted. Columns are
+     * - `x`, `y`, `z`, the center of the crown bounds, in meters;
+     * - `shape`, one of `sphere`, `ellipsoid`, or `cone`;
+     * - `radius`, the horizontal radius of the crown, in meters;
+     * - `height`, the vertical extent of the crown, in meters, which is
+     * required for ellipsoids and cones, and ignored for spheres;
+     * - `lai`, the leaf area index over the crown footprint, or 
+     * `leaf_area`, the total leaf area, in square meters;
+     * - `leaf_radius`, in meters;
+     * - `distribution`, the angle distribution string.
+     *
+     * The center, shape, and radius columns are required. Other columns
+     * may be missing or empty, in which case the given defaults apply.
+     *
+     * @throw std::runtime_error
+     * If the file can't be read, or has malformed or missing fields.
+     */
+    void loadCsv(
+            const std::string& filename,
+            Float default_lai,
+            Float default_leaf_radius,
+            const std::string& default_angle_distribution);
+
+    /**
+     * @brief Crowns.
+     */
+    std::vector<LeafCrown>& crowns()
+    {
+        return crowns_;
+    }
+
+    /**
+     * @brief Angle distributions.
+     */
+    std::vector<LeafAngleDistributionVariant>& angleDistributions()
+    {
+        return angle_distributions_;
+    }
+
+private:
+
+    /**
+     * @brief Crowns.
+     */
+    std::vector<LeafCrown> crowns_;
+
+    /**
+     * @brief Angle distributions.
+     */
+    std::vector<LeafAngleDistributionVariant> angle_distributions_;
+
+    /**
+     * @brief Angle distribution indices by string.
+     */
+    std::map<std::string, std::size_t> angle_distribution_indices_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_INVENTORY_HPP
@@ -0,0 +1,137 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_MERGE_HPP
+#define LEAF_DISK_GEN_LEAF_MERGE_HPP
+
+#include <string>
+#include <vector>
+#include <leaf-disk-gen/common.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_merge Leaf merge
+ *
+ * `<leaf-disk-gen/leaf_merge.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf split options.
+ *
+ * Exactly one of the number of leaves per part and the cell size 
+ * must be positive.
+ */
+struct LeafSplitOptions
+{
+    /**
+     * @brief Number of leaves per part, or zero for none. Parts are 
+     * consecutive runs of leaves in file order, named by index.
+     */
+    std::uint64_t count = 0;
+
+    /**
+     * @brief Cell size for parts by region, or zero for none. Parts 
+     * are square cells in XY of a grid anchored at the origin, named 
+     * by cell indices, and hold the leaves centered within them.
+     */
+    Float cell_size = 0;
+};
+
+/**
+ * @brief Merge leaf outputs.
+ *
+ * Concatenates GList or OBJ outputs, byte for byte except as follows.
+ * For GList, the objects of each input are streamed into one geometry
+ * list without parsing the XML. For OBJ, face indices are offset by the 
+ * number of vertices in preceding inputs, with each input rewritten in
+ * parallel chunks of lines. Relative face indices are left as they are.
+ *
+ * @param[in] filenames
+ * Input filenames.
+ *
+ * @param[in] filename
+ * Output filename, of the same format as the inputs.
+ *
+ * @param[in] num_threads
+ * Number of threads. If zero, uses `defaultNumThreads()`.
+ *
+ * @throw std::runtime_error
+ * If formats differ or are unknown, if an input is tiled instancing 
+ * GList output, or if a file can't be opened or is malformed.
+ */
+void mergeLeafOutputs(
+            const std::vector<std::string>& filenames,
+            const std::string& filename,
+            unsigned int num_threads = 0);
+
+/**
+ * @brief Split leaf output.
+ *
+ * Partitions GList or OBJ output into parts, copying each leaf's text 
+ * into its part byte for byte, except that OBJ face indices are 
+ * rebased to the part. Object headers and materials are carried into 
+ * each part as they change. Leaves are recovered in parallel with 
+ * `LeafReader`, and parts are buffered in memory and flushed as they
+ * fill, so any number of parts may be written without holding files 
+ * open.
+ *
+ * @param[in] filename
+ * Input filename.
+ *
+ * @param[in] part_filename
+ * Part filename, of the same format as the input, to which the part
+ * name is appended before the extension, e.g., `part_3.obj` or 
+ * `part_-1_2.glist`.
+ *
+ * @param[in] options
+ * Options.
+ *
+ * @param[in] num_threads
+ * Number of threads. If zero, uses `defaultNumThreads()`.
+ *
+ * @returns
+ * Number of parts.
+ *
+ * @throw std::runtime_error
+ * If options are invalid, if formats differ or are unknown, or if a 
+ * file can't be opened or is malformed.
+ */
+std::size_t splitLeafOutput(
+            const std::string& filename,
+            const std::string& part_filename,
+            const LeafSplitOptions& options,
+            unsigned int num_threads = 0);
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_MERGE_HPP
@@ -0,0 +1,110 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_PIPELINE_HPP
+#define LEAF_DISK_GEN_LEAF_PIPELINE_HPP
+
+#include <functional>
+#include <vector>
+#include <leaf-disk-gen/leaf_writer.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_pipeline Leaf pipeline
+ *
+ * `<leaf-disk-gen/leaf_pipeline.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf pipeline sample function.
+ *
+ * Invoked as `sample(batch_index, leaf_disks, num_leaf_disks)` to fill 
+ * the leaves of a batch. This is invoked concurrently from worker 
+ * threads, so it must be thread safe.
+ */
+typedef std::function<void(std::size_t, LeafDisk*, std::size_t)> 
+        LeafPipelineSampleFunc;
+
+/**
+ * @brief Leaf pipeline observe function.
+ *
+ * Invoked as `observe(leaf_disk)` on each leaf in output order, from the 
+ * calling thread.
+ */
+typedef std::function<void(const LeafDisk&)> 
+        LeafPipelineObserveFunc;
+
+/**
+ * @brief Run leaf pipeline.
+ *
+ * Worker threads claim batches in order, sample their leaves, and, if
+ * the writer is formattable, format them into bytes, then push them
+ * onto a lock-free bounded queue. The calling thread pops batches, 
+ * restores batch order, and writes them sequentially, so the CPU keeps
+ * sampling and formatting while output blocks on I/O. Workers may run 
+ * at most a fixed window of batches ahead of the writer, bounding 
+ * memory. Threads that must wait spin briefly, then block on a 
+ * `Notifier`, so idle threads do not take CPU from busy ones. The 
+ * output depends only on the batches, not on the number of threads 
+ * or on scheduling.
+ *
+ * @param[in] batch_sizes
+ * Number of leaves in each batch.
+ *
+ * @param[in] sample
+ * Sample function.
+ *
+ * @param[in] writer
+ * Writer.
+ *
+ * @param[in] observe
+ * Observe function, or empty.
+ *
+ * @param[in] num_threads
+ * Number of threads, including the calling thread. If zero, uses 
+ * `defaultNumThreads()`.
+ *
+ * @throw std::exception
+ * Rethrows the first exception thrown by sampling, formatting, or 
+ * writing, after stopping all workers.
+ */
+void runLeafPipeline(
+            const std::vector<std::size_t>& batch_sizes,
+            const LeafPipelineSampleFunc& sample,
+            LeafWriter& writer,
+            const LeafPipelineObserveFunc& observe,
+            unsigned int num_threads = 0);
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_PIPELINE_HPP
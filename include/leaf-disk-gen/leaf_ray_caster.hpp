@@ -0,0 +1,194 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_RAY_CASTER_HPP
+#define LEAF_DISK_GEN_LEAF_RAY_CASTER_HPP
+
+#include <leaf-disk-gen/bvh.hpp>
+#include <leaf-disk-gen/leaf_disk.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_ray_caster Leaf ray caster
+ *
+ * `<leaf-disk-gen/leaf_ray_caster.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf ray caster.
+ *
+ * Ray casting against leaf disks through a bounding volume hierarchy. 
+ * Intersection is exact for the disk primitive of the GList output, 
+ * i.e., the set of points in the plane of the leaf within the leaf 
+ * radius of the leaf position.
+ */
+class LeafRayCaster
+{
+public:
+
+    /**
+     * @brief Build.
+     *
+     * @param[in] leaf_disks
+     * Leaf disks.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     */
+    void build(
+            const std::vector<LeafDisk>& leaf_disks, 
+            unsigned int num_threads = 0);
+
+    /**
+     * @brief Any leaf intersects ray segment?
+     */
+    bool occluded(
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            Float tmin,
+            Float tmax) const
+    {
+        bool hit = false;
+        bvh_.intersectRay(
+            org, dir, tmin, tmax,
+            [&](std::uint32_t pos, Float& tmax) {
+                hit = intersectDisk(disks_[pos], org, dir, tmin, tmax);
+                return hit;
+            });
+        return hit;
+    }
+
+    /**
+     * @brief Intersect closest leaf.
+     *
+     * @param[in] org
+     * Ray origin.
+     *
+     * @param[in] dir
+     * Ray direction.
+     *
+     * @param[in] tmin
+     * Ray parameter minimum.
+     *
+     * @param[inout] tmax
+     * Ray parameter maximum. On hit, this is the ray parameter
+     * of the closest intersection.
+     *
+     * @param[out] index
+     * On hit, the index of the leaf in the array passed to `build()`.
+     */
+    bool intersect(
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            Float tmin,
+            Float& tmax,
+            std::size_t& index) const
+    {
+        bool hit = false;
+        bvh_.intersectRay(
+            org, dir, tmin, tmax,
+            [&](std::uint32_t pos, Float& tmax) {
+                if (intersectDisk(disks_[pos], org, dir, tmin, tmax)) {
+                    index = bvh_.primIndices()[pos];
+                    hit = true;
+                }
+                return false;
+            });
+        return hit;
+    }
+
+private:
+
+    /**
+     * @brief Disk, as stored for intersection.
+     */
+    struct Disk
+    {
+        /**
+         * @brief Position.
+         */
+        Vec3<Float> pos;
+
+        /**
+         * @brief Normal direction.
+         */
+        Vec3<Float> normal;
+
+        /**
+         * @brief Radius squared.
+         */
+        Float radius2;
+    };
+
+    /**
+     * @brief Intersect disk.
+     */
+    static bool intersectDisk(
+            const Disk& disk,
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            Float tmin,
+            Float& tmax)
+    {
+        Float denom = pre::dot(dir, disk.normal);
+        if (denom == 0) {
+            return false;
+        }
+        Float t = pre::dot(disk.pos - org, disk.normal) / denom;
+        if (!(t > tmin && t < tmax)) {
+            return false;
+        }
+        Vec3<Float> off = org + t * dir - disk.pos;
+        if (!(pre::dot(off, off) <= disk.radius2)) {
+            return false;
+        }
+        tmax = t;
+        return true;
+    }
+
+private:
+
+    /**
+     * @brief Bounding volume hierarchy.
+     */
+    Bvh bvh_;
+
+    /**
+     * @brief Disks, in hierarchy order.
+     */
+    std::vector<Disk> disks_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_RAY_CASTER_HPP
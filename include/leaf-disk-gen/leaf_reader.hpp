@@ -0,0 +1,235 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_READER_HPP
+#define LEAF_DISK_GEN_LEAF_READER_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <leaf-disk-gen/leaf_disk.hpp>
+#include <leaf-disk-gen/mapped_file.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_reader Leaf reader
+ *
+ * `<leaf-disk-gen/leaf_reader.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf reader read function.
+ *
+ * Invoked as `func(leaf_disk)` on each leaf in file order, from the 
+ * calling thread.
+ */
+typedef std::function<void(const LeafDisk&)> LeafReaderFunc;
+
+/**
+ * @brief Leaf reader record function.
+ *
+ * Invoked as `func(leaf_disk, record_begin, record_end)` on each leaf in
+ * file order, from the calling thread, where the record is the text the 
+ * leaf was recovered from, within the mapped data. For GList, this is
+ * the instance line. For OBJ, this is the vertex and face lines. The 
+ * text remains readable for the lifetime of the reader.
+ */
+typedef std::function<void(const LeafDisk&, const char*, const char*)> 
+        LeafReaderRecordFunc;
+
+/**
+ * @brief Leaf reader.
+ *
+ * Recovers leaf disks from GList output, as written by 
+ * `LeafDisk::writeGListInstance()`, or from OBJ output, as written by 
+ * `LeafDisk::writeObj()`. For GList, the normal and radius are the 
+ * direction and length of the third column of each instance matrix, and
+ * the position is the fourth column. For OBJ, each leaf is a run of 
+ * vertices, the center followed by the perimeter, then a run of faces
+ * forming the triangle fan. The normal is the direction of the fan area
+ * vector, and the radius is the mean perimeter distance undoing the 
+ * area-preserving scale. Recovered leaves are only as precise as the
+ * text, so generally within a relative 1e-6.
+ *
+ * The file is memory mapped and scanned in windows, each split into 
+ * one chunk per thread at record boundaries. Chunks are parsed in 
+ * parallel with a hand-rolled float parser, then passed to the read 
+ * function in file order, and the window is released before moving 
+ * on. So memory is bounded regardless of file size.
+ */
+class LeafReader
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] filename
+     * Filename, ending with either `.glist` or `.obj`.
+     *
+     * @throw std::runtime_error
+     * If the filename has neither extension, if the file can't be 
+     * mapped, or if it is a tiled instancing GList, whose tile should 
+     * be read instead.
+     */
+    explicit LeafReader(const std::string& filename);
+
+    /**
+     * @brief Non-copyable.
+     */
+    LeafReader(const LeafReader&) = delete;
+
+    /**
+     * @brief Non-copyable.
+     */
+    LeafReader& operator=(const LeafReader&) = delete;
+
+    /**
+     * @brief Is OBJ, otherwise GList?
+     */
+    bool isObj() const
+    {
+        return is_obj_;
+    }
+
+    /**
+     * @brief Mapped data, or nullptr if empty.
+     */
+    const char* data() const
+    {
+        return file_.data();
+    }
+
+    /**
+     * @brief File size in bytes.
+     */
+    std::size_t size() const
+    {
+        return file_.size();
+    }
+
+    /**
+     * @brief Read.
+     *
+     * @param[in] func
+     * Read function.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     *
+     * @throw std::runtime_error
+     * If a record is malformed, with its byte offset.
+     */
+    void read(const LeafReaderFunc& func, unsigned int num_threads = 0);
+
+    /**
+     * @brief Read records.
+     *
+     * @param[in] func
+     * Read record function.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     *
+     * @throw std::runtime_error
+     * If a record is malformed, with its byte offset.
+     */
+    void readRecords(
+            const LeafReaderRecordFunc& func, 
+            unsigned int num_threads = 0);
+
+private:
+
+    /**
+     * @brief Record.
+     */
+    struct Record
+    {
+        /**
+         * @brief Leaf disk.
+         */
+        LeafDisk leaf_disk;
+
+        /**
+         * @brief Text begin.
+         */
+        const char* begin = nullptr;
+
+        /**
+         * @brief Text end.
+         */
+        const char* end = nullptr;
+    };
+
+    /**
+     * @brief Filename.
+     */
+    std::string filename_;
+
+    /**
+     * @brief Is OBJ, otherwise GList?
+     */
+    bool is_obj_ = false;
+
+    /**
+     * @brief Mapped file.
+     */
+    MappedFile file_;
+
+    /**
+     * @brief Find first record beginning at or after position.
+     */
+    const char* findRecord(const char* pos) const;
+
+    /**
+     * @brief Parse records beginning in range.
+     */
+    void parseRange(
+            const char* begin, 
+            const char* end, 
+            std::vector<Record>& records) const;
+
+    /**
+     * @brief Parse GList record, or return nullptr if malformed.
+     */
+    const char* parseGList(const char* pos, LeafDisk& leaf_disk) const;
+
+    /**
+     * @brief Parse OBJ record, or return nullptr if malformed.
+     */
+    const char* parseObj(const char* pos, LeafDisk& leaf_disk) const;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_READER_HPP
@@ -0,0 +1,266 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_SORT_HPP
+#define LEAF_DISK_GEN_LEAF_SORT_HPP
+
+#include <cstdio>
+#include <leaf-disk-gen/leaf_writer.hpp>
+#include <leaf-disk-gen/packed_leaf_disk.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_sort Leaf sort
+ *
+ * `<leaf-disk-gen/leaf_sort.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Sort key.
+ */
+struct SortKey
+{
+    /**
+     * @brief Key.
+     */
+    std::uint64_t key;
+
+    /**
+     * @brief Index of item with key.
+     */
+    std::uint64_t index;
+};
+
+/**
+ * @brief Parallel least-significant-digit radix sort.
+ *
+ * Stable sort by key, with 8-bit digits. Each pass histograms per 
+ * thread, prefix sums digit-major then thread-minor, and scatters per 
+ * thread, so the result is independent of the number of threads. 
+ * Passes on digits shared by all keys are skipped.
+ *
+ * @param[inout] keys
+ * Keys.
+ *
+ * @param[in] num_bits
+ * Number of significant key bits.
+ *
+ * @param[in] num_threads
+ * Number of threads. If zero, uses `defaultNumThreads()`.
+ */
+void parallelRadixSort(
+            std::vector<SortKey>& keys, 
+            int num_bits = 64,
+            unsigned int num_threads = 0);
+
+/**
+ * @brief Encode 63-bit Morton code from 21-bit coordinates.
+ */
+inline
+std::uint64_t encodeMorton63(
+            std::uint32_t x, 
+            std::uint32_t y, 
+            std::uint32_t z)
+{
+    auto spread = [](std::uint64_t v) {
+        v &= 0x1FFFFF;
+        v = (v | (v << 32)) & 0x001F00000000FFFFULL;
+        v = (v | (v << 16)) & 0x001F0000FF0000FFULL;
+        v = (v | (v <<  8)) & 0x100F00F00F00F00FULL;
+        v = (v | (v <<  4)) & 0x10C30C30C30C30C3ULL;
+        v = (v | (v <<  2)) & 0x1249249249249249ULL;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+/**
+ * @brief Morton sort leaf writer.
+ *
+ * Buffers leaves, sorts them by the 63-bit Morton code of their 
+ * position quantized over given bounds, then forwards them to another 
+ * writer. If the buffer would exceed the memory limit, sorted runs are
+ * spilled to temporary files and merged on `finish()`, such that 
+ * memory stays bounded and the result is identical to sorting in 
+ * memory. If packed, leaves are buffered and spilled as 
+ * `PackedLeafDisk`, which fits several times more leaves in the same 
+ * memory at the cost of the quantization error documented by 
+ * `LeafDiskPacker`.
+ */
+class MortonSortLeafWriter final : public LeafWriter
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] writer
+     * Writer to forward sorted leaves to.
+     *
+     * @param[in] bounds
+     * Bounds over which to quantize positions.
+     *
+     * @param[in] max_memory
+     * Memory limit in bytes.
+     *
+     * @param[in] num_threads
+     * Number of threads. If zero, uses `defaultNumThreads()`.
+     *
+     * @param[in] packed
+     * Buffer packed leaves?
+     */
+    MortonSortLeafWriter(
+            std::unique_ptr<LeafWriter> writer,
+            const pre::aabb3<Float>& bounds,
+            std::size_t max_memory,
+            unsigned int num_threads = 0,
+            bool packed = false);
+
+    /**
+     * @brief Destructor.
+     */
+    ~MortonSortLeafWriter();
+
+    /**
+     * @copydoc LeafWriter::write()
+     */
+    void write(const LeafDisk& leaf_disk);
+
+    /**
+     * @copydoc LeafWriter::finish()
+     */
+    void finish();
+
+    /**
+     * @copydoc LeafWriter::checkCapacity()
+     */
+    void checkCapacity(std::uint64_t num_leaf_disks) const;
+
+private:
+
+    /**
+     * @brief Compute Morton code.
+     */
+    std::uint64_t computeMorton(const Vec3<Float>& pos) const;
+
+    /**
+     * @brief Compute Morton code of packed leaf.
+     */
+    std::uint64_t computeMorton(const PackedLeafDisk& packed) const;
+
+    /**
+     * @brief Number of buffered leaves.
+     */
+    std::size_t bufferSize() const;
+
+    /**
+     * @brief Buffered leaf.
+     */
+    LeafDisk bufferedLeaf(std::size_t k) const;
+
+    /**
+     * @brief Sort buffered leaves, returning sorted keys.
+     */
+    std::vector<SortKey> sortBuffer();
+
+    /**
+     * @brief Spill buffered leaves as a sorted run.
+     */
+    void spill();
+
+    /**
+     * @brief Run record size in bytes.
+     */
+    std::size_t recordSize() const;
+
+    /**
+     * @brief Encode buffered leaf with key as run record.
+     */
+    void encodeRecord(const SortKey& key, char* record) const;
+
+    /**
+     * @brief Decode run record, returning leaf and key.
+     */
+    LeafDisk decodeRecord(const char* record, std::uint64_t& key) const;
+
+private:
+
+    /**
+     * @brief Writer.
+     */
+    std::unique_ptr<LeafWriter> writer_;
+
+    /**
+     * @brief Bounds.
+     */
+    pre::aabb3<Float> bounds_;
+
+    /**
+     * @brief Maximum number of leaves to buffer.
+     */
+    std::size_t max_leaves_ = 0;
+
+    /**
+     * @brief Number of threads.
+     */
+    unsigned int num_threads_ = 0;
+
+    /**
+     * @brief Buffer packed leaves?
+     */
+    bool packed_ = false;
+
+    /**
+     * @brief Packer, over bounds.
+     */
+    LeafDiskPacker packer_;
+
+    /**
+     * @brief Buffered leaves, if not packed.
+     */
+    std::vector<LeafDisk> leaf_disks_;
+
+    /**
+     * @brief Buffered packed leaves, if packed.
+     */
+    std::vector<PackedLeafDisk> packed_leaf_disks_;
+
+    /**
+     * @brief Spilled runs.
+     */
+    std::vector<std::FILE*> runs_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_SORT_HPP
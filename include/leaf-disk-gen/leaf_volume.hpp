@@ -0,0 +1,537 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_VOLUME_HPP
+#define LEAF_DISK_GEN_LEAF_VOLUME_HPP
+
+#include <preform/aabb.hpp>
+#include <leaf-disk-gen/common.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_volume Leaf volume
+ *
+ * `<leaf-disk-gen/leaf_volume.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf volume.
+ *
+ * Region in which to generate leaf positions.
+ */
+class LeafVolume
+{
+public:
+
+    /**
+     * @brief Destructor.
+     */
+    virtual ~LeafVolume() {}
+
+    /**
+     * @brief Number of leaves to generate for given LAI and leaf radius.
+     *
+     * @throw std::runtime_error
+     * If the number of leaves is invalid or doesn't fit in 63 bits.
+     */
+    virtual std::uint64_t numLeaves(Float lai, Float leaf_radius) const = 0;
+
+    /**
+     * @brief Ground area, with respect to which LAI is defined.
+     */
+    virtual Float groundArea() const = 0;
+
+    /**
+     * @brief Bounds.
+     */
+    virtual pre::aabb3<Float> bounds() const = 0;
+
+    /**
+     * @brief Sample position.
+     *
+     * @param[in] u
+     * Canonical random sample.
+     */
+    virtual Vec3<Float> samplePosition(const Vec3<Float>& u) const = 0;
+
+    /**
+     * @brief Sample position above ground position.
+     *
+     * Leaves are distributed uniformly over the ground footprint of 
+     * every volume, and uniformly in height above each ground position,
+     * so this samples the height alone. Sampling ground positions 
+     * uniformly then matches `samplePosition()`.
+     *
+     * @param[in] xy
+     * Ground position.
+     *
+     * @param[in] u
+     * Canonical random sample.
+     *
+     * @param[out] pos
+     * Position.
+     *
+     * @returns
+     * False if the ground position is outside the ground footprint.
+     */
+    virtual bool samplePositionAbove(
+                        const Vec2<Float>& xy,
+                        Float u,
+                        Vec3<Float>& pos) const = 0;
+
+    /**
+     * @brief Leaf area density at position for given LAI, in units
+     * of leaf area per unit volume.
+     */
+    virtual Float leafAreaDensity(
+                        const Vec3<Float>& pos, Float lai) const = 0;
+
+    /**
+     * @brief Sample ray origin for transmittance estimation.
+     *
+     * @param[in] dir
+     * Ray direction, pointing upward.
+     *
+     * @param[in] u
+     * Canonical random sample.
+     *
+     * @param[out] org
+     * Ray origin.
+     *
+     * @returns
+     * False if the sample is rejected, e.g., because the ray would 
+     * leave the volume through its sides.
+     */
+    virtual bool sampleRayOrigin(
+                        const Vec3<Float>& dir, 
+                        const Vec2<Float>& u, 
+                        Vec3<Float>& org) const = 0;
+
+    /**
+     * @brief Clip ray to volume.
+     *
+     * @param[in] org
+     * Ray origin.
+     *
+     * @param[in] dir
+     * Ray direction.
+     *
+     * @param[in] margin
+     * Margin by which to expand the volume before clipping.
+     *
+     * @param[out] tmin
+     * Ray parameter minimum.
+     *
+     * @param[out] tmax
+     * Ray parameter maximum.
+     *
+     * @returns
+     * False if the ray misses the volume.
+     */
+    virtual bool clipRay(
+                        const Vec3<Float>& org,
+                        const Vec3<Float>& dir,
+                        Float margin,
+                        Float& tmin,
+                        Float& tmax) const = 0;
+};
+
+/**
+ * @brief Box leaf volume.
+ *
+ * Leaves are distributed uniformly in the box, so that LAI is 
+ * uniform over the XY extent of the box.
+ */
+class BoxLeafVolume final : public LeafVolume
+{
+public:
+
+    /**
+     * @brief Constructor.
+     */
+    explicit
+    BoxLeafVolume(const pre::aabb3<Float>& box) : box_(box)
+    {
+    }
+
+    /**
+     * @copydoc LeafVolume::numLeaves()
+     */
+    std::uint64_t numLeaves(Float lai, Float leaf_radius) const;
+
+    /**
+     * @copydoc LeafVolume::groundArea()
+     */
+    Float groundArea() const;
+
+    /**
+     * @copydoc LeafVolume::bounds()
+     */
+    pre::aabb3<Float> bounds() const
+    {
+        return box_;
+    }
+
+    /**
+     * @copydoc LeafVolume::samplePosition()
+     */
+    Vec3<Float> samplePosition(const Vec3<Float>& u) const
+    {
+        return box_.lerp(u);
+    }
+
+    /**
+     * @copydoc LeafVolume::samplePositionAbove()
+     */
+    bool samplePositionAbove(
+                const Vec2<Float>& xy,
+                Float u,
+                Vec3<Float>& pos) const;
+
+    /**
+     * @copydoc LeafVolume::leafAreaDensity()
+     */
+    Float leafAreaDensity(const Vec3<Float>& pos, Float lai) const;
+
+    /**
+     * @copydoc LeafVolume::sampleRayOrigin()
+     */
+    bool sampleRayOrigin(
+                const Vec3<Float>& dir, 
+                const Vec2<Float>& u, 
+                Vec3<Float>& org) const;
+
+    /**
+     * @copydoc LeafVolume::clipRay()
+     */
+    bool clipRay(
+                const Vec3<Float>& org,
+                const Vec3<Float>& dir,
+                Float margin,
+                Float& tmin,
+                Float& tmax) const;
+
+private:
+
+    /**
+     * @brief Box.
+     */
+    pre::aabb3<Float> box_;
+};
+
+/**
+ * @brief Sphere leaf volume.
+ *
+ * Leaves are distributed uniformly over the projected disk of the 
+ * sphere in XY, then uniformly along the vertical chord through the
+ * sphere, so that LAI is uniform over the projected disk.
+ */
+class SphereLeafVolume final : public LeafVolume
+{
+public:
+
+    /**
+     * @brief Constructor.
+     */
+    SphereLeafVolume(const Vec3<Float>& center, Float radius) :
+            center_(center),
+            radius_(radius)
+    {
+    }
+
+    /**
+     * @copydoc LeafVolume::numLeaves()
+     */
+    std::uint64_t numLeaves(Float lai, Float leaf_radius) const;
+
+    /**
+     * @copydoc LeafVolume::groundArea()
+     */
+    Float groundArea() const;
+
+    /**
+     * @copydoc LeafVolume::bounds()
+     */
+    pre::aabb3<Float> bounds() const
+    {
+        return {
+            center_ - Vec3<Float>{radius_, radius_, radius_},
+            center_ + Vec3<Float>{radius_, radius_, radius_}
+        };
+    }
+
+    /**
+     * @copydoc LeafVolume::samplePosition()
+     */
+    Vec3<Float> samplePosition(const Vec3<Float>& u) const;
+
+    /**
+     * @copydoc LeafVolume::samplePositionAbove()
+     */
+    bool samplePositionAbove(
+                const Vec2<Float>& xy,
+                Float u,
+                Vec3<Float>& pos) const;
+
+    /**
+     * @copydoc LeafVolume::leafAreaDensity()
+     */
+    Float leafAreaDensity(const Vec3<Float>& pos, Float lai) const;
+
+    /**
+     * @copydoc LeafVolume::sampleRayOrigin()
+     */
+    bool sampleRayOrigin(
+                const Vec3<Float>& dir, 
+                const Vec2<Float>& u, 
+                Vec3<Float>& org) const;
+
+    /**
+     * @copydoc LeafVolume::clipRay()
+     */
+    bool clipRay(
+                const Vec3<Float>& org,
+                const Vec3<Float>& dir,
+                Float margin,
+                Float& tmin,
+                Float& tmax) const;
+
+private:
+
+    /**
+     * @brief Center.
+     */
+    Vec3<Float> center_ = {0, 0, 0};
+
+    /**
+     * @brief Radius.
+     */
+    Float radius_ = 1;
+};
+
+/**
+ * @brief Ellipsoid leaf volume.
+ *
+ * Axis-aligned ellipsoid, e.g., a tree crown. Leaves are distributed 
+ * as in `SphereLeafVolume`, so that LAI is uniform over the projected 
+ * ellipse.
+ */
+class EllipsoidLeafVolume final : public LeafVolume
+{
+public:
+
+    /**
+     * @brief Constructor.
+     */
+    EllipsoidLeafVolume(const Vec3<Float>& center, const Vec3<Float>& radii) :
+            center_(center),
+            radii_(radii)
+    {
+    }
+
+    /**
+     * @copydoc LeafVolume::numLeaves()
+     */
+    std::uint64_t numLeaves(Float lai, Float leaf_radius) const;
+
+    /**
+     * @copydoc LeafVolume::groundArea()
+     */
+    Float groundArea() const;
+
+    /**
+     * @copydoc LeafVolume::bounds()
+     */
+    pre::aabb3<Float> bounds() const
+    {
+        return {center_ - radii_, center_ + radii_};
+    }
+
+    /**
+     * @copydoc LeafVolume::samplePosition()
+     */
+    Vec3<Float> samplePosition(const Vec3<Float>& u) const;
+
+    /**
+     * @copydoc LeafVolume::samplePositionAbove()
+     */
+    bool samplePositionAbove(
+                const Vec2<Float>& xy,
+                Float u,
+                Vec3<Float>& pos) const;
+
+    /**
+     * @copydoc LeafVolume::leafAreaDensity()
+     */
+    Float leafAreaDensity(const Vec3<Float>& pos, Float lai) const;
+
+    /**
+     * @copydoc LeafVolume::sampleRayOrigin()
+     */
+    bool sampleRayOrigin(
+                const Vec3<Float>& dir, 
+                const Vec2<Float>& u, 
+                Vec3<Float>& org) const;
+
+    /**
+     * @copydoc LeafVolume::clipRay()
+     */
+    bool clipRay(
+                const Vec3<Float>& org,
+                const Vec3<Float>& dir,
+                Float margin,
+                Float& tmin,
+                Float& tmax) const;
+
+private:
+
+    /**
+     * @brief Center.
+     */
+    Vec3<Float> center_ = {0, 0, 0};
+
+    /**
+     * @brief Radii.
+     */
+    Vec3<Float> radii_ = {1, 1, 1};
+};
+
+/**
+ * @brief Cone leaf volume.
+ *
+ * Upright circular cone, e.g., a conifer crown, with its apex above the
+ * center of its base. Leaves are distributed uniformly over the 
+ * projected disk of the base, then uniformly along the vertical chord 
+ * through the cone, so that LAI is uniform over the projected disk.
+ */
+class ConeLeafVolume final : public LeafVolume
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] base
+     * Center of base.
+     *
+     * @param[in] radius
+     * Radius of base.
+     *
+     * @param[in] height
+     * Height of apex above base.
+     */
+    ConeLeafVolume(const Vec3<Float>& base, Float radius, Float height) :
+            base_(base),
+            radius_(radius),
+            height_(height)
+    {
+    }
+
+    /**
+     * @copydoc LeafVolume::numLeaves()
+     */
+    std::uint64_t numLeaves(Float lai, Float leaf_radius) const;
+
+    /**
+     * @copydoc LeafVolume::groundArea()
+     */
+    Float groundArea() const;
+
+    /**
+     * @copydoc LeafVolume::bounds()
+     */
+    pre::aabb3<Float> bounds() const
+    {
+        return {
+            base_ - Vec3<Float>{radius_, radius_, 0},
+            base_ + Vec3<Float>{radius_, radius_, height_}
+        };
+    }
+
+    /**
+     * @copydoc LeafVolume::samplePosition()
+     */
+    Vec3<Float> samplePosition(const Vec3<Float>& u) const;
+
+    /**
+     * @copydoc LeafVolume::samplePositionAbove()
+     */
+    bool samplePositionAbove(
+                const Vec2<Float>& xy,
+                Float u,
+                Vec3<Float>& pos) const;
+
+    /**
+     * @copydoc LeafVolume::leafAreaDensity()
+     */
+    Float leafAreaDensity(const Vec3<Float>& pos, Float lai) const;
+
+    /**
+     * @copydoc LeafVolume::sampleRayOrigin()
+     */
+    bool sampleRayOrigin(
+                const Vec3<Float>& dir, 
+                const Vec2<Float>& u, 
+                Vec3<Float>& org) const;
+
+    /**
+     * @copydoc LeafVolume::clipRay()
+     */
+    bool clipRay(
+                const Vec3<Float>& org,
+                const Vec3<Float>& dir,
+                Float margin,
+                Float& tmin,
+                Float& tmax) const;
+
+private:
+
+    /**
+     * @brief Center of base.
+     */
+    Vec3<Float> base_ = {0, 0, 0};
+
+    /**
+     * @brief Radius of base.
+     */
+    Float radius_ = 1;
+
+    /**
+     * @brief Height of apex above base.
+     */
+    Float height_ = 1;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_VOLUME_HPP
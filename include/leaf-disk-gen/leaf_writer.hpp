@@ -0,0 +1,673 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LEAF_WRITER_HPP
+#define LEAF_DISK_GEN_LEAF_WRITER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <preform/aabb.hpp>
+#include <leaf-disk-gen/leaf_disk.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup leaf_writer Leaf writer
+ *
+ * `<leaf-disk-gen/leaf_writer.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Leaf writer options.
+ */
+struct LeafWriterOptions
+{
+    /**
+     * @brief Material ID.
+     */
+    int matid = 100;
+
+    /**
+     * @brief Vertex resolution, for triangulated formats.
+     */
+    unsigned int ver_res = 6;
+
+    /**
+     * @brief Cell size for spatially bucketed output, or zero for 
+     * none. This only affects GList output.
+     */
+    Float cell_size = 0;
+
+    /**
+     * @brief Memory limit in bytes for buffering leaves, if bucketing.
+     */
+    std::size_t cell_memory = std::size_t(1024) << 20;
+
+    /**
+     * @brief Level-of-detail viewpoints, or empty for none. This only
+     * affects OBJ output.
+     *
+     * If non-empty, each leaf is tessellated with the least vertex 
+     * resolution, up to `ver_res`, such that the outline error of the 
+     * area-preserving polygon as seen from the nearest viewpoint is 
+     * within `lod_error`.
+     */
+    std::vector<Vec3<Float>> lod_viewpoints;
+
+    /**
+     * @brief Level-of-detail angular error in radians.
+     */
+    Float lod_error = 0;
+
+    /**
+     * @brief Write OBJ faces with relative (negative) vertex indices?
+     *
+     * Each leaf's text then doesn't depend on the leaves before it, so
+     * OBJ output with level of detail is formattable, and appending 
+     * needs no vertex count.
+     */
+    bool relative_indices = false;
+
+    /**
+     * @brief Append to existing output, written with the same options?
+     * Only GList output without bucketing, and OBJ output without level
+     * of detail unless with relative indices, can be appended to.
+     */
+    bool append = false;
+
+    /**
+     * @brief Number of leaves in existing output, if appending.
+     */
+    std::uint64_t append_num_leaves = 0;
+};
+
+/**
+ * @brief Leaf writer.
+ */
+class LeafWriter
+{
+public:
+
+    /**
+     * @brief Destructor.
+     */
+    virtual ~LeafWriter() {}
+
+    /**
+     * @brief Write leaf disk.
+     */
+    virtual void write(const LeafDisk& leaf_disk) = 0;
+
+    /**
+     * @brief Finish, writing anything buffered along with the footer.
+     */
+    virtual void finish() = 0;
+
+    /**
+     * @brief Check that the format can hold the given number of leaves,
+     * in addition to those already written.
+     *
+     * Called before generating with the planned total, so that a scene
+     * too large for the format fails fast instead of after writing. By
+     * default, does nothing.
+     *
+     * @throw std::runtime_error
+     * If the format can't hold the given number of leaves.
+     */
+    virtual void checkCapacity(std::uint64_t num_leaf_disks) const
+    {
+        (void) num_leaf_disks;
+    }
+
+    /**
+     * @brief Is formattable?
+     *
+     * If true, `format()` may be called concurrently from any thread to 
+     * format leaves into bytes, which `writeFormatted()` then writes in
+     * order, such that the output is identical to calling `write()` on
+     * each leaf. By default, false.
+     */
+    virtual bool isFormattable() const
+    {
+        return false;
+    }
+
+    /**
+     * @brief Format leaves into bytes.
+     *
+     * @param[in] leaf_disks
+     * Leaves.
+     *
+     * @param[in] num_leaf_disks
+     * Number of leaves.
+     *
+     * @param[in] first_index
+     * Index of first leaf, being the number of leaves written before.
+     *
+     * @param[out] bytes
+     * Bytes.
+     *
+     * @throw std::runtime_error
+     * If not formattable.
+     */
+    virtual void format(
+                const LeafDisk* leaf_disks,
+                std::size_t num_leaf_disks,
+                std::size_t first_index,
+                std::string& bytes) const;
+
+    /**
+     * @brief Write leaves formatted by `format()`.
+     *
+     * @param[in] bytes
+     * Bytes.
+     *
+     * @param[in] num_leaf_disks
+     * Number of leaves.
+     *
+     * @throw std::runtime_error
+     * If not formattable.
+     */
+    virtual void writeFormatted(
+                const std::string& bytes,
+                std::size_t num_leaf_disks);
+
+public:
+
+    /**
+     * @brief Initialize from filename, by extension.
+     *
+     * @throw std::runtime_error
+     * If the extension is unknown or the file can't be opened.
+     */
+    static std::unique_ptr<LeafWriter> fromFilename(
+                        const std::string& filename,
+                        const LeafWriterOptions& options);
+};
+
+/**
+ * @brief GList leaf writer.
+ *
+ * Writes one object with a disk base geometry, and one static 
+ * instance per leaf. 
+ *
+ * If the cell size option is positive, leaves are instead spilled 
+ * to a temporary file and bucketed into a uniform grid of cells over 
+ * their bounds, and each non-empty cell is written as its own object, 
+ * so that the renderer builds spatially coherent per-object 
+ * hierarchies. Bucketing is a streaming counting sort in two passes 
+ * over the spilled leaves. The first pass counts per cell, and groups
+ * consecutive cells into runs that fit in a buffer bounded by the 
+ * cell memory option. The second pass scatters leaves by run into 
+ * a second temporary file, through small per-run buffers. Each run 
+ * is then read back once, in order, and gathered by cell in the 
+ * buffer, except that a cell too large for the buffer alone is its 
+ * own run, streamed twice for bounds and instances. So memory is one 
+ * counter per cell plus that buffer, and I/O is linear in the number 
+ * of leaves, independent of the cell memory. Leaves keep their write
+ * order within each cell. The tight bounds of each cell are 
+ * written to a CSV file alongside, named by `cellsFilename()`, with 
+ * one row per object in order.
+ */
+class GListLeafWriter final : public LeafWriter
+{
+public:
+
+    /**
+     * @brief Constructor.
+     */
+    GListLeafWriter(
+            const std::string& filename,
+            const LeafWriterOptions& options);
+
+    /**
+     * @brief Destructor.
+     */
+    ~GListLeafWriter();
+
+    /**
+     * @copydoc LeafWriter::write()
+     */
+    void write(const LeafDisk& leaf_disk);
+
+    /**
+     * @copydoc LeafWriter::finish()
+     */
+    void finish();
+
+    /**
+     * @copydoc LeafWriter::isFormattable()
+     */
+    bool isFormattable() const;
+
+    /**
+     * @copydoc LeafWriter::format()
+     */
+    void format(
+            const LeafDisk* leaf_disks,
+            std::size_t num_leaf_disks,
+            std::size_t first_index,
+            std::string& bytes) const;
+
+    /**
+     * @copydoc LeafWriter::writeFormatted()
+     */
+    void writeFormatted(
+            const std::string& bytes,
+            std::size_t num_leaf_disks);
+
+    /**
+     * @brief Cells filename for output filename, replacing the 
+     * `.glist` extension with `_cells.csv`.
+     */
+    static std::string cellsFilename(const std::string& filename);
+
+private:
+
+    /**
+     * @brief Write object header.
+     */
+    void writeObjectHeader();
+
+    /**
+     * @brief Write spilled leaves bucketed into cells.
+     */
+    void writeCells();
+
+    /**
+     * @brief Spill buffered leaves to the temporary file.
+     */
+    void spill();
+
+    /**
+     * @brief Output file stream.
+     */
+    std::ofstream ofs_;
+
+    /**
+     * @brief Options.
+     */
+    LeafWriterOptions options_;
+
+    /**
+     * @brief Buffered leaf disks, if bucketing.
+     */
+    std::vector<LeafDisk> leaf_disks_;
+
+    /**
+     * @brief Bounds of spilled leaf disk positions, if bucketing.
+     */
+    pre::aabb3<Float> bounds_;
+
+    /**
+     * @brief Temporary file of spilled leaves, if bucketing.
+     */
+    std::FILE* spill_ = nullptr;
+
+    /**
+     * @brief Number of spilled leaves, if bucketing.
+     */
+    std::uint64_t num_spilled_ = 0;
+
+    /**
+     * @brief Cells file stream, if bucketing.
+     */
+    std::ofstream cells_ofs_;
+};
+
+/**
+ * @brief OBJ leaf writer.
+ *
+ * Writes each leaf as a triangle fan. If level-of-detail viewpoints
+ * are given, the vertex resolution is picked per leaf, in which case
+ * vertex offsets depend on every leaf before, so the writer is not 
+ * formattable unless faces use relative indices.
+ */
+class ObjLeafWriter final : public LeafWriter
+{
+public:
+
+    /**
+     * @brief Constructor.
+     */
+    ObjLeafWriter(
+            const std::string& filename,
+            const LeafWriterOptions& options);
+
+    /**
+     * @copydoc LeafWriter::write()
+     */
+    void write(const LeafDisk& leaf_disk);
+
+    /**
+     * @copydoc LeafWriter::finish()
+     */
+    void finish();
+
+    /**
+     * @copydoc LeafWriter::checkCapacity()
+     */
+    void checkCapacity(std::uint64_t num_leaf_disks) const;
+
+    /**
+     * @copydoc LeafWriter::isFormattable()
+     */
+    bool isFormattable() const;
+
+    /**
+     * @copydoc LeafWriter::format()
+     */
+    void format(
+            const LeafDisk* leaf_disks,
+            std::size_t num_leaf_disks,
+            std::size_t first_index,
+            std::string& bytes) const;
+
+    /**
+     * @copydoc LeafWriter::writeFormatted()
+     */
+    void writeFormatted(
+            const std::string& bytes,
+            std::size_t num_leaf_disks);
+
+    /**
+     * @brief Number of triangles written.
+     */
+    std::uint64_t numTriangles() const
+    {
+        return num_triangles_;
+    }
+
+    /**
+     * @brief Number of triangles at full vertex resolution, being the
+     * triangle budget without level of detail.
+     */
+    std::uint64_t numTrianglesBudget() const
+    {
+        return num_leaves_ * std::max(ver_res_, 4u);
+    }
+
+private:
+
+    /**
+     * @brief Vertex resolution for leaf.
+     */
+    unsigned int verRes(const LeafDisk& leaf_disk) const;
+
+private:
+
+    /**
+     * @brief Output file stream.
+     */
+    std::ofstream ofs_;
+
+    /**
+     * @brief Vertex offset.
+     */
+    std::uint64_t ver_offset_ = 0;
+
+    /**
+     * @brief Vertex offset on construction, nonzero if appending.
+     */
+    std::uint64_t ver_offset_begin_ = 0;
+
+    /**
+     * @brief Vertex resolution.
+     */
+    unsigned int ver_res_ = 6;
+
+    /**
+     * @brief Relative indices?
+     */
+    bool relative_indices_ = false;
+
+    /**
+     * @brief Level-of-detail viewpoints.
+     */
+    std::vector<Vec3<Float>> lod_viewpoints_;
+
+    /**
+     * @brief Level-of-detail outline errors relative to leaf radius, 
+     * indexed by vertex resolution from 4 to `ver_res_`.
+     */
+    std::vector<Float> lod_errors_;
+
+    /**
+     * @brief Level-of-detail angular error in radians.
+     */
+    Float lod_error_ = 0;
+
+    /**
+     * @brief Number of leaves written.
+     */
+    std::uint64_t num_leaves_ = 0;
+
+    /**
+     * @brief Number of triangles written.
+     */
+    std::uint64_t num_triangles_ = 0;
+};
+
+/**
+ * @brief glTF 2.0 binary leaf writer.
+ *
+ * Writes a single triangulated unit disk mesh, instanced once per
+ * leaf by the `EXT_mesh_gpu_instancing` extension with per-instance 
+ * translation, rotation, and scale. Instance attributes are buffered 
+ * as single precision arrays, then written as raw binary buffers 
+ * on `finish()`. Without leaves, the scene is empty, and only the 
+ * mesh is written, since glTF requires nonempty accessors.
+ *
+ * @note
+ * glTF is Y-up, so the root node rotates Z-up to Y-up.
+ */
+class GlbLeafWriter final : public LeafWriter
+{
+public:
+
+    /**
+     * @brief Constructor.
+     */
+    GlbLeafWriter(
+            const std::string& filename,
+            const LeafWriterOptions& options);
+
+    /**
+     * @copydoc LeafWriter::write()
+     */
+    void write(const LeafDisk& leaf_disk);
+
+    /**
+     * @copydoc LeafWriter::finish()
+     */
+    void finish();
+
+    /**
+     * @copydoc LeafWriter::checkCapacity()
+     */
+    void checkCapacity(std::uint64_t num_leaf_disks) const;
+
+private:
+
+    /**
+     * @brief Output file stream.
+     */
+    std::ofstream ofs_;
+
+    /**
+     * @brief Options.
+     */
+    LeafWriterOptions options_;
+
+    /**
+     * @brief Instance translations.
+     */
+    std::vector<float> translations_;
+
+    /**
+     * @brief Instance rotations, as unit quaternions in XYZW order.
+     */
+    std::vector<float> rotations_;
+
+    /**
+     * @brief Instance scales.
+     */
+    std::vector<float> scales_;
+};
+
+/**
+ * @brief GList tiling.
+ */
+struct GListTiling
+{
+    /**
+     * @brief Origin, being the lower XY corner of the domain.
+     */
+    Vec2<Float> origin = {0, 0};
+
+    /**
+     * @brief Tile size in XY.
+     */
+    Vec2<Float> tile_size = {1, 1};
+
+    /**
+     * @brief Number of tiles in XY.
+     */
+    int num_tiles[2] = {1, 1};
+
+    /**
+     * @brief Seed for per-tile flips.
+     */
+    std::uint64_t seed = 0;
+};
+
+/**
+ * @brief Tiled GList leaf writer.
+ *
+ * Writes leaves, in tile coordinates with XY in `[0, tile_size)`, to
+ * a tile GList next to the output, with the suffix `_tile.glist`. The
+ * output GList then references the tile GList as its base geometry, 
+ * and instances it once per tile across the domain. Each instance is 
+ * randomly flipped in X, flipped in Y, rotated 180 degrees, or left 
+ * as is, which hides the periodicity while preserving any anisotropy
+ * of the leaf angle distribution along X and Y.
+ */
+class TiledGListLeafWriter final : public LeafWriter
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] filename
+     * Filename, which must end with `.glist`.
+     *
+     * @param[in] options
+     * Options, which apply to the tile GList.
+     *
+     * @param[in] tiling
+     * Tiling.
+     */
+    TiledGListLeafWriter(
+            const std::string& filename,
+            const LeafWriterOptions& options,
+            const GListTiling& tiling);
+
+    /**
+     * @copydoc LeafWriter::write()
+     */
+    void write(const LeafDisk& leaf_disk);
+
+    /**
+     * @copydoc LeafWriter::finish()
+     */
+    void finish();
+
+    /**
+     * @copydoc LeafWriter::isFormattable()
+     */
+    bool isFormattable() const;
+
+    /**
+     * @copydoc LeafWriter::format()
+     */
+    void format(
+            const LeafDisk* leaf_disks,
+            std::size_t num_leaf_disks,
+            std::size_t first_index,
+            std::string& bytes) const;
+
+    /**
+     * @copydoc LeafWriter::writeFormatted()
+     */
+    void writeFormatted(
+            const std::string& bytes,
+            std::size_t num_leaf_disks);
+
+public:
+
+    /**
+     * @brief Tile filename for output filename.
+     */
+    static std::string tileFilename(const std::string& filename);
+
+private:
+
+    /**
+     * @brief Output file stream.
+     */
+    std::ofstream ofs_;
+
+    /**
+     * @brief Tile filename.
+     */
+    std::string tile_filename_;
+
+    /**
+     * @brief Tile writer.
+     */
+    GListLeafWriter tile_writer_;
+
+    /**
+     * @brief Tiling.
+     */
+    GListTiling tiling_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LEAF_WRITER_HPP
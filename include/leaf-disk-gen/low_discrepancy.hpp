@@ -0,0 +1,162 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_LOW_DISCREPANCY_HPP
+#define LEAF_DISK_GEN_LOW_DISCREPANCY_HPP
+
+#include <vector>
+#include <leaf-disk-gen/common.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup low_discrepancy Low discrepancy
+ *
+ * `<leaf-disk-gen/low_discrepancy.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Randomized low-discrepancy sequence.
+ *
+ * Each dimension is randomized independently from the seed, so points
+ * are unbiased over seeds while retaining the stratification of the
+ * underlying sequence:
+ * - Sobol points use Joe-Kuo direction numbers, with hash-based nested
+ * uniform (Owen) scrambling,
+ * - Halton points use the first primes as bases, with an independent 
+ * random permutation of each digit.
+ */
+class LowDiscrepancySequence
+{
+public:
+
+    /**
+     * @brief Type.
+     */
+    enum Type {
+
+        /**
+         * @brief Sobol.
+         */
+        eTypeSobol,
+
+        /**
+         * @brief Halton.
+         */
+        eTypeHalton
+    };
+
+    /**
+     * @brief Maximum number of dimensions.
+     */
+    static const int max_dims = 8;
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] type
+     * Type.
+     *
+     * @param[in] seed
+     * Seed for randomization.
+     */
+    LowDiscrepancySequence(Type type, std::uint64_t seed);
+
+    /**
+     * @brief Generate canonical number.
+     *
+     * @param[in] index
+     * Point index.
+     *
+     * @param[in] dim
+     * Dimension, less than `max_dims`.
+     */
+    Float generate(std::uint32_t index, int dim) const;
+
+    /**
+     * @brief Generate 2 canonical numbers, in dimensions `dim` and 
+     * `dim + 1`.
+     */
+    Vec2<Float> generate2(std::uint32_t index, int dim) const
+    {
+        return {
+            generate(index, dim),
+            generate(index, dim + 1)
+        };
+    }
+
+    /**
+     * @brief Generate 3 canonical numbers, in dimensions `dim` through
+     * `dim + 2`.
+     */
+    Vec3<Float> generate3(std::uint32_t index, int dim) const
+    {
+        return {
+            generate(index, dim),
+            generate(index, dim + 1),
+            generate(index, dim + 2)
+        };
+    }
+
+public:
+
+    /**
+     * @brief Initialize type from string, either `"sobol"` or 
+     * `"halton"`.
+     *
+     * @throw std::invalid_argument
+     * If the string is not a known type.
+     */
+    static Type typeFromString(const std::string& str);
+
+private:
+
+    /**
+     * @brief Type.
+     */
+    Type type_;
+
+    /**
+     * @brief Sobol scramble seeds, per dimension.
+     */
+    std::uint32_t sobol_seeds_[max_dims] = {};
+
+    /**
+     * @brief Halton digit permutations, per dimension, per digit, per
+     * digit value.
+     */
+    std::vector<std::vector<std::uint16_t>> halton_perms_;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_LOW_DISCREPANCY_HPP
@@ -0,0 +1,121 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_MAPPED_FILE_HPP
+#define LEAF_DISK_GEN_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+namespace ld {
+
+/**
+ * @defgroup mapped_file Mapped file
+ *
+ * `<leaf-disk-gen/mapped_file.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Read-only memory mapped file.
+ *
+ * Pages are faulted in on access and may be released once scanned,
+ * so that resident memory stays bounded when streaming large files. 
+ * Released pages remain readable, and are faulted in again if read.
+ */
+class MappedFile
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] filename
+     * Filename.
+     *
+     * @throw std::runtime_error
+     * If the file can't be opened or mapped.
+     */
+    explicit MappedFile(const std::string& filename);
+
+    /**
+     * @brief Non-copyable.
+     */
+    MappedFile(const MappedFile&) = delete;
+
+    /**
+     * @brief Non-copyable.
+     */
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Destructor.
+     */
+    ~MappedFile();
+
+    /**
+     * @brief Data, or nullptr if empty.
+     */
+    const char* data() const
+    {
+        return data_;
+    }
+
+    /**
+     * @brief Size in bytes.
+     */
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    /**
+     * @brief Release pages from the page containing `begin` up to, 
+     * but excluding, the page containing `end`.
+     */
+    void release(const char* begin, const char* end) const;
+
+private:
+
+    /**
+     * @brief Data.
+     */
+    const char* data_ = nullptr;
+
+    /**
+     * @brief Size in bytes.
+     */
+    std::size_t size_ = 0;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_MAPPED_FILE_HPP
@@ -0,0 +1,290 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_PACKED_LEAF_DISK_HPP
+#define LEAF_DISK_GEN_PACKED_LEAF_DISK_HPP
+
+#include <cmath>
+#include <cstring>
+#include <preform/aabb.hpp>
+#include <leaf-disk-gen/leaf_disk.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup packed_leaf_disk Packed leaf disk
+ *
+ * `<leaf-disk-gen/packed_leaf_disk.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Packed leaf disk.
+ *
+ * A 16-byte leaf disk, for modes that buffer many leaves, versus 56 
+ * bytes for `LeafDisk`. Positions are only meaningful with respect to 
+ * the bounds of the `LeafDiskPacker` that packed them.
+ */
+struct PackedLeafDisk
+{
+    /**
+     * @brief Position, as 21-bit quantized X, Y, and Z in bits 0-20,
+     * 21-41, and 42-62 respectively.
+     */
+    std::uint64_t pos = 0;
+
+    /**
+     * @brief Normal, as 16-bit signed normalized octahedral U and V in 
+     * the low and high halves respectively.
+     */
+    std::uint32_t normal = 0;
+
+    /**
+     * @brief Radius, as an IEEE half-precision float.
+     */
+    std::uint16_t radius = 0;
+
+    /**
+     * @brief Reserved, always zero.
+     */
+    std::uint16_t reserved = 0;
+};
+
+static_assert(
+    sizeof(PackedLeafDisk) == 16, 
+    "PackedLeafDisk must be 16 bytes");
+
+/**
+ * @brief Leaf disk packer.
+ *
+ * Converts between `LeafDisk` and `PackedLeafDisk`, with bounded error:
+ * - each position coordinate is within @f$ e / (2^{22} - 2) @f$ of the
+ * original, for extent @f$ e @f$ of the bounds along that axis, 
+ * provided the position is inside the bounds (positions outside are
+ * clamped),
+ * - each normal is within 0.004 degrees of the original unit normal,
+ * being the octahedral quantization error at 16 bits per component with
+ * rounding to nearest (the measured maximum over 2e7 random normals is 
+ * 0.0037 degrees),
+ * - each radius is within a relative error of @f$ 2^{-11} @f$ of the 
+ * original, provided the radius is between @f$ 2^{-14} @f$ and 65504
+ * (radii outside are flushed to zero or clamped).
+ *
+ * The per-leaf conversions are branch-free arithmetic on each leaf 
+ * independently, so the batch conversions are amenable to vectorization.
+ */
+class LeafDiskPacker
+{
+public:
+
+    /**
+     * @brief Default constructor.
+     */
+    LeafDiskPacker() = default;
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] bounds
+     * Bounds of positions.
+     */
+    explicit LeafDiskPacker(const pre::aabb3<Float>& bounds) : 
+                bounds_(bounds)
+    {
+        for (int j = 0; j < 3; j++) {
+            Float extent = bounds[1][j] - bounds[0][j];
+            scale_[j] = extent > 0 ? max_coord / extent : 0;
+            inv_scale_[j] = extent > 0 ? extent / max_coord : 0;
+        }
+    }
+
+    /**
+     * @brief Pack.
+     */
+    PackedLeafDisk pack(const LeafDisk& leaf_disk) const
+    {
+        PackedLeafDisk packed;
+        std::uint64_t q[3];
+        for (int j = 0; j < 3; j++) {
+            Float x = (leaf_disk.pos[j] - bounds_[0][j]) * scale_[j] + 0.5;
+            x = std::fmin(std::fmax(x, Float(0)), Float(max_coord));
+            q[j] = std::uint64_t(x);
+        }
+        packed.pos = q[0] | (q[1] << 21) | (q[2] << 42);
+        packed.normal = encodeOctahedral(leaf_disk.normal);
+        packed.radius = encodeHalf(leaf_disk.radius);
+        return packed;
+    }
+
+    /**
+     * @brief Unpack.
+     */
+    LeafDisk unpack(const PackedLeafDisk& packed) const
+    {
+        LeafDisk leaf_disk;
+        for (int j = 0; j < 3; j++) {
+            std::uint64_t q = (packed.pos >> (21 * j)) & max_coord;
+            leaf_disk.pos[j] = bounds_[0][j] + Float(q) * inv_scale_[j];
+        }
+        leaf_disk.normal = decodeOctahedral(packed.normal);
+        leaf_disk.radius = decodeHalf(packed.radius);
+        return leaf_disk;
+    }
+
+    /**
+     * @brief Pack batch.
+     */
+    void pack(
+            const LeafDisk* leaf_disks, 
+            PackedLeafDisk* packed, 
+            std::size_t n) const;
+
+    /**
+     * @brief Unpack batch.
+     */
+    void unpack(
+            const PackedLeafDisk* packed, 
+            LeafDisk* leaf_disks, 
+            std::size_t n) const;
+
+    /**
+     * @brief Bounds.
+     */
+    const pre::aabb3<Float>& bounds() const
+    {
+        return bounds_;
+    }
+
+public:
+
+    /**
+     * @brief Maximum quantized coordinate.
+     */
+    static constexpr std::uint32_t max_coord = (1 << 21) - 1;
+
+    /**
+     * @brief Encode unit vector as 32-bit octahedral.
+     */
+    static std::uint32_t encodeOctahedral(const Vec3<Float>& v)
+    {
+        // Project onto octahedron, then fold lower hemisphere.
+        Float inv_l1 = 1 / (std::fabs(v[0]) + std::fabs(v[1]) + 
+                            std::fabs(v[2]));
+        Float u0 = v[0] * inv_l1;
+        Float u1 = v[1] * inv_l1;
+        Float f0 = std::copysign(1 - std::fabs(u1), u0);
+        Float f1 = std::copysign(1 - std::fabs(u0), u1);
+        u0 = v[2] < 0 ? f0 : u0;
+        u1 = v[2] < 0 ? f1 : u1;
+        std::int32_t s0 = std::int32_t(u0 * 32767 + std::copysign(0.5, u0));
+        std::int32_t s1 = std::int32_t(u1 * 32767 + std::copysign(0.5, u1));
+        return std::uint32_t(std::uint16_t(std::int16_t(s0))) | 
+              (std::uint32_t(std::uint16_t(std::int16_t(s1))) << 16);
+    }
+
+    /**
+     * @brief Decode 32-bit octahedral as unit vector.
+     */
+    static Vec3<Float> decodeOctahedral(std::uint32_t bits)
+    {
+        Float u0 = std::int16_t(std::uint16_t(bits)) / Float(32767);
+        Float u1 = std::int16_t(std::uint16_t(bits >> 16)) / Float(32767);
+        Float z = 1 - std::fabs(u0) - std::fabs(u1);
+
+        // Unfold lower hemisphere.
+        Float t = std::fmax(-z, Float(0));
+        u0 -= std::copysign(t, u0);
+        u1 -= std::copysign(t, u1);
+        Float inv_len = 1 / std::sqrt(u0 * u0 + u1 * u1 + z * z);
+        return {u0 * inv_len, u1 * inv_len, z * inv_len};
+    }
+
+    /**
+     * @brief Encode as IEEE half-precision float, rounding to nearest.
+     *
+     * Values below the smallest normal half are flushed to zero, and 
+     * values above the largest finite half are clamped.
+     */
+    static std::uint16_t encodeHalf(Float value)
+    {
+        float f = std::fmax(float(value), 0.0f);
+        std::uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        bits += 0x00001000; // Round mantissa, carrying into exponent.
+        std::int32_t e = std::int32_t(bits >> 23) - 127 + 15;
+        std::uint32_t half = (std::uint32_t(e) << 10) | 
+                             ((bits >> 13) & 0x3FF);
+        half = e <= 0 ? 0 : half;
+        half = e >= 31 ? 0x7BFF : half;
+        return std::uint16_t(half);
+    }
+
+    /**
+     * @brief Decode IEEE half-precision float, as encoded by 
+     * `encodeHalf()`.
+     */
+    static Float decodeHalf(std::uint16_t half)
+    {
+        std::uint32_t e = (half >> 10) & 0x1F;
+        std::uint32_t bits = ((e + 112) << 23) | ((half & 0x3FF) << 13);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return e == 0 ? 0 : f;
+    }
+
+private:
+
+    /**
+     * @brief Bounds.
+     */
+    pre::aabb3<Float> bounds_ = {
+        Vec3<Float>{0, 0, 0},
+        Vec3<Float>{1, 1, 1}
+    };
+
+    /**
+     * @brief Scale from position to quantized coordinate.
+     */
+    Vec3<Float> scale_ = {max_coord, max_coord, max_coord};
+
+    /**
+     * @brief Scale from quantized coordinate to position.
+     */
+    Vec3<Float> inv_scale_ = {
+        Float(1) / max_coord, 
+        Float(1) / max_coord, 
+        Float(1) / max_coord
+    };
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_PACKED_LEAF_DISK_HPP
@@ -0,0 +1,316 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_PARALLEL_HPP
+#define LEAF_DISK_GEN_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <leaf-disk-gen/common.hpp>
+
+namespace ld {
+
+/**
+ * @defgroup parallel Parallel
+ *
+ * `<leaf-disk-gen/parallel.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Default number of threads.
+ */
+inline
+unsigned int defaultNumThreads()
+{
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+/**
+ * @brief Parallel for.
+ *
+ * Partitions `[0, n)` into contiguous ranges, one per thread, and
+ * invokes `func(begin, end, thread_index)` for each range. Ranges are 
+ * a deterministic function of `n` and `num_threads`, so per-thread
+ * partial results indexed by `thread_index` may be reduced 
+ * deterministically.
+ *
+ * @param[in] n
+ * Number of items.
+ *
+ * @param[in] num_threads
+ * Number of threads. If zero, uses `defaultNumThreads()`.
+ *
+ * @param[in] func
+ * Function.
+ */
+template <typename Func>
+inline
+void parallelFor(std::size_t n, unsigned int num_threads, Func&& func)
+{
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+    if (num_threads > n) {
+        num_threads = std::max<std::size_t>(n, 1);
+    }
+    if (num_threads == 1) {
+        func(std::size_t(0), n, 0u);
+        return;
+    }
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (unsigned int t = 0; t < num_threads; t++) {
+        std::size_t begin = n * t / num_threads;
+        std::size_t end = n * (t + 1) / num_threads;
+        threads.emplace_back([=, &func]() {
+            func(begin, end, t);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Lock-free bounded multi-producer multi-consumer queue.
+ *
+ * Ring buffer of cells, each with a sequence number that tells 
+ * producers and consumers whether the cell is free or full for their
+ * current lap, so push and pop each take a single compare-and-swap.
+ * Neither blocks: `tryPush()` fails if the queue is full and `tryPop()`
+ * fails if the queue is empty.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] capacity
+     * Capacity, rounded up to a power of 2.
+     */
+    explicit BoundedQueue(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        cells_.reset(new Cell[size]);
+        mask_ = size - 1;
+        for (std::size_t pos = 0; pos < size; pos++) {
+            cells_[pos].sequence.store(pos, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Try to push, or return false if full.
+     */
+    bool tryPush(T&& value)
+    {
+        Cell* cell = nullptr;
+        std::size_t pos = push_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = 
+                std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+            if (diff == 0) {
+                if (push_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = push_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Try to pop, or return false if empty.
+     */
+    bool tryPop(T& value)
+    {
+        Cell* cell = nullptr;
+        std::size_t pos = pop_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = 
+                std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1);
+            if (diff == 0) {
+                if (pop_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = pop_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+
+    /**
+     * @brief Cell.
+     */
+    struct Cell
+    {
+        /**
+         * @brief Sequence number.
+         */
+        std::atomic<std::size_t> sequence;
+
+        /**
+         * @brief Value.
+         */
+        T value;
+    };
+
+    /**
+     * @brief Cells.
+     */
+    std::unique_ptr<Cell[]> cells_;
+
+    /**
+     * @brief Index mask.
+     */
+    std::size_t mask_ = 0;
+
+    /**
+     * @brief Push position, on its own cache line.
+     */
+    alignas(64) std::atomic<std::size_t> push_pos_ = {0};
+
+    /**
+     * @brief Pop position, on its own cache line.
+     */
+    alignas(64) std::atomic<std::size_t> pop_pos_ = {0};
+};
+
+/**
+ * @brief Notifier, for waiting on state changed by other threads.
+ *
+ * Waiters spin briefly on a predicate, yielding, then block on a 
+ * condition variable, so long waits do not take CPU from threads 
+ * doing work. Notifying only takes the mutex if a waiter is blocked,
+ * so the notifying fast path stays lock-free. A seq_cst fence on each
+ * side ensures that either the waiter sees the change, or the 
+ * notifier sees the waiter.
+ */
+class Notifier
+{
+public:
+
+    /**
+     * @brief Wait until predicate is true.
+     *
+     * The predicate may be evaluated any number of times, and must be 
+     * made true only by threads that call `notify()` afterwards.
+     */
+    template <typename Pred>
+    void wait(Pred&& pred)
+    {
+        for (int k = 0; k < max_spins; k++) {
+            if (pred()) {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        num_blocked_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond_.wait(lock, pred);
+        num_blocked_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Notify waiters after changing state.
+     */
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (num_blocked_.load(std::memory_order_relaxed) > 0) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+            }
+            cond_.notify_all();
+        }
+    }
+
+private:
+
+    /**
+     * @brief Maximum number of spins before blocking.
+     */
+    static constexpr int max_spins = 256;
+
+    /**
+     * @brief Mutex.
+     */
+    std::mutex mutex_;
+
+    /**
+     * @brief Condition variable.
+     */
+    std::condition_variable cond_;
+
+    /**
+     * @brief Number of blocked waiters.
+     */
+    std::atomic<int> num_blocked_ = {0};
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_PARALLEL_HPP
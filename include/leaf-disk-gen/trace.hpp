@@ -0,0 +1,190 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#pragma once
+#ifndef LEAF_DISK_GEN_TRACE_HPP
+#define LEAF_DISK_GEN_TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace ld {
+
+/**
+ * @defgroup trace Trace
+ *
+ * `<leaf-disk-gen/trace.hpp>`
+ */
+/**@{*/
+
+/**
+ * @brief Trace.
+ *
+ * Records timed spans into per-thread buffers, which only their own
+ * thread appends to, so recording takes no locks. A thread takes a 
+ * buffer on its first span, and returns it on exit for the next 
+ * thread to reuse, so short-lived worker threads map onto a small set
+ * of timeline tracks. At exit, all spans are written in Chrome trace
+ * JSON, which opens in Perfetto or `chrome://tracing`. 
+ *
+ * Until started, spans reduce to one relaxed atomic load each.
+ */
+class Trace
+{
+public:
+
+    /**
+     * @brief Start recording, and write to file at exit.
+     *
+     * @param[in] filename
+     * Filename.
+     */
+    static void start(const std::string& filename);
+
+    /**
+     * @brief Is recording?
+     */
+    static bool isEnabled()
+    {
+        return is_enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Nanoseconds since start.
+     */
+    static std::uint64_t now();
+
+    /**
+     * @brief Record span on calling thread.
+     *
+     * @param[in] name
+     * Name, which must be a string literal.
+     *
+     * @param[in] begin
+     * Begin, in nanoseconds since start.
+     *
+     * @param[in] end
+     * End, in nanoseconds since start.
+     *
+     * @param[in] arg
+     * Index argument, or negative for none.
+     */
+    static void record(
+                const char* name, 
+                std::uint64_t begin, 
+                std::uint64_t end, 
+                std::int64_t arg);
+
+    /**
+     * @brief Write Chrome trace JSON.
+     *
+     * This must only be called once all threads have stopped 
+     * recording.
+     */
+    static void writeJson(std::ostream& ostr);
+
+private:
+
+    /**
+     * @brief Is recording?
+     */
+    static std::atomic<bool> is_enabled_;
+};
+
+/**
+ * @brief Trace span.
+ *
+ * Records from construction to destruction, if the trace is recording.
+ */
+class TraceSpan
+{
+public:
+
+    /**
+     * @brief Constructor.
+     *
+     * @param[in] name
+     * Name, which must be a string literal.
+     *
+     * @param[in] arg
+     * Index argument, e.g., of batch or volume, or negative for none.
+     */
+    explicit TraceSpan(const char* name, std::int64_t arg = -1)
+    {
+        if (Trace::isEnabled()) {
+            name_ = name;
+            arg_ = arg;
+            begin_ = Trace::now();
+        }
+    }
+
+    /**
+     * @brief Non-copyable.
+     */
+    TraceSpan(const TraceSpan&) = delete;
+
+    /**
+     * @brief Non-copyable.
+     */
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    /**
+     * @brief Destructor.
+     */
+    ~TraceSpan()
+    {
+        if (name_) {
+            Trace::record(name_, begin_, Trace::now(), arg_);
+        }
+    }
+
+private:
+
+    /**
+     * @brief Name, or nullptr if not recording.
+     */
+    const char* name_ = nullptr;
+
+    /**
+     * @brief Index argument.
+     */
+    std::int64_t arg_ = -1;
+
+    /**
+     * @brief Begin, in nanoseconds since start.
+     */
+    std::uint64_t begin_ = 0;
+};
+
+/**@}*/
+
+} // namespace ld
+
+#endif // #ifndef LEAF_DISK_GEN_TRACE_HPP
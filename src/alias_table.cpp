@@ -0,0 +1,95 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <leaf-disk-gen/alias_table.hpp>
+
+namespace ld {
+
+// Initialize.
+void AliasTable::init(const Float* weights, std::size_t n)
+{
+    assert(n > 0);
+    entries_.assign(n, Entry());
+
+    // Sum weights.
+    sum_ = 0;
+    for (std::size_t k = 0; k < n; k++) {
+        assert(weights[k] >= 0);
+        sum_ += weights[k];
+    }
+    if (!(sum_ > 0)) {
+        // Uniform fallback, every entry keeps its own index.
+        for (std::size_t k = 0; k < n; k++) {
+            entries_[k].alias = k;
+        }
+        return;
+    }
+
+    // Scaled probabilities, partitioned into small and large.
+    std::vector<Float> probs(n);
+    std::vector<std::uint32_t> small;
+    std::vector<std::uint32_t> large;
+    small.reserve(n);
+    large.reserve(n);
+    for (std::size_t k = 0; k < n; k++) {
+        probs[k] = weights[k] * (n / sum_);
+        if (probs[k] < 1) {
+            small.push_back(k);
+        }
+        else {
+            large.push_back(k);
+        }
+    }
+
+    // Pair each small entry with a large entry.
+    while (!small.empty() && !large.empty()) {
+        std::uint32_t s = small.back(); small.pop_back();
+        std::uint32_t l = large.back(); large.pop_back();
+        entries_[s].prob = probs[s];
+        entries_[s].alias = l;
+        probs[l] = (probs[l] + probs[s]) - 1;
+        if (probs[l] < 1) {
+            small.push_back(l);
+        }
+        else {
+            large.push_back(l);
+        }
+    }
+
+    // Leftovers are 1 up to round-off.
+    for (std::uint32_t k : small) {
+        entries_[k].prob = 1;
+        entries_[k].alias = k;
+    }
+    for (std::uint32_t k : large) {
+        entries_[k].prob = 1;
+        entries_[k].alias = k;
+    }
+}
+
+} // namespace ld
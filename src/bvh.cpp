@@ -0,0 +1,293 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numeric>
+#include <leaf-disk-gen/bvh.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+
+namespace ld {
+
+namespace {
+
+// Round down to float.
+float roundDown(Float x)
+{
+    float y = float(x);
+    return Float(y) > x ? std::nextafter(y, -HUGE_VALF) : y;
+}
+
+// Round up to float.
+float roundUp(Float x)
+{
+    float y = float(x);
+    return Float(y) < x ? std::nextafter(y, +HUGE_VALF) : y;
+}
+
+// Empty box.
+pre::aabb3<Float> emptyBox()
+{
+    Float inf = std::numeric_limits<Float>::infinity();
+    return {
+        Vec3<Float>{+inf, +inf, +inf},
+        Vec3<Float>{-inf, -inf, -inf}
+    };
+}
+
+// Expand box.
+void expandBox(pre::aabb3<Float>& box, const pre::aabb3<Float>& other)
+{
+    box[0] = pre::min(box[0], other[0]);
+    box[1] = pre::max(box[1], other[1]);
+}
+
+// Half surface area.
+Float halfArea(const pre::aabb3<Float>& box)
+{
+    Vec3<Float> d = box[1] - box[0];
+    if (!(d[0] >= 0 && d[1] >= 0 && d[2] >= 0)) {
+        return 0;
+    }
+    return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+}
+
+} // namespace
+
+// Build.
+void Bvh::build(
+            const std::vector<pre::aabb3<Float>>& prim_bounds, 
+            unsigned int num_threads)
+{
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+    nodes_.clear();
+    prim_indices_.clear();
+    if (prim_bounds.empty()) {
+        return;
+    }
+    if (prim_bounds.size() > std::numeric_limits<std::uint32_t>::max()) {
+        throw
+            std::length_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": too many primitives"));
+    }
+
+    // Primitive centers.
+    std::uint32_t n = prim_bounds.size();
+    std::vector<Vec3<Float>> prim_centers(n);
+    for (std::uint32_t k = 0; k < n; k++) {
+        prim_centers[k] = (prim_bounds[k][0] + prim_bounds[k][1]) / Float(2);
+    }
+    prim_indices_.resize(n);
+    std::iota(prim_indices_.begin(), prim_indices_.end(), 0);
+
+    // Split top levels serially, deferring subtrees as tasks.
+    std::vector<BuildTask> tasks;
+    std::size_t task_size = std::max<std::size_t>(n / (8 * num_threads), 4096);
+    nodes_.reserve(2 * std::size_t(n));
+    nodes_.emplace_back();
+    buildNode(
+        nodes_, 0, 0, n, 0, 
+        prim_bounds, prim_centers, task_size, &tasks);
+
+    // Build subtrees in parallel, largest first.
+    std::sort(
+        tasks.begin(), tasks.end(), 
+        [](const BuildTask& task0, const BuildTask& task1) {
+            return task0.end - task0.begin > task1.end - task1.begin;
+        });
+    std::vector<std::vector<Node>> subtrees(tasks.size());
+    std::atomic<std::size_t> next_task(0);
+    parallelFor(num_threads, num_threads,
+    [&](std::size_t, std::size_t, unsigned int) {
+        std::size_t task_index;
+        while ((task_index = next_task++) < tasks.size()) {
+            const BuildTask& task = tasks[task_index];
+            std::vector<Node>& subtree = subtrees[task_index];
+            subtree.reserve(2 * std::size_t(task.end - task.begin));
+            subtree.emplace_back();
+            buildNode(
+                subtree, 0, task.begin, task.end, task.depth,
+                prim_bounds, prim_centers, 0, nullptr);
+        }
+    });
+
+    // Splice subtrees, with roots replacing deferred nodes.
+    for (std::size_t task_index = 0; 
+                     task_index < tasks.size(); task_index++) {
+        std::vector<Node>& subtree = subtrees[task_index];
+        std::uint32_t base = nodes_.size();
+        for (Node& node : subtree) {
+            if (node.count == 0) {
+                node.offset = base + node.offset - 1;
+            }
+        }
+        nodes_[tasks[task_index].node] = subtree[0];
+        nodes_.insert(nodes_.end(), subtree.begin() + 1, subtree.end());
+        std::vector<Node>().swap(subtree);
+    }
+}
+
+// Build node.
+void Bvh::buildNode(
+            std::vector<Node>& nodes,
+            std::uint32_t node_index,
+            std::uint32_t begin,
+            std::uint32_t end,
+            int depth,
+            const std::vector<pre::aabb3<Float>>& prim_bounds,
+            const std::vector<Vec3<Float>>& prim_centers,
+            std::size_t task_size,
+            std::vector<BuildTask>* tasks)
+{
+    std::uint32_t count = end - begin;
+    if (tasks && count <= task_size) {
+        tasks->push_back({node_index, begin, end, depth});
+        return;
+    }
+
+    // Bounds and center bounds.
+    pre::aabb3<Float> box = emptyBox();
+    pre::aabb3<Float> center_box = emptyBox();
+    for (std::uint32_t pos = begin; pos < end; pos++) {
+        std::uint32_t k = prim_indices_[pos];
+        expandBox(box, prim_bounds[k]);
+        expandBox(center_box, {prim_centers[k], prim_centers[k]});
+    }
+    {
+        Node& node = nodes[node_index];
+        for (int j = 0; j < 3; j++) {
+            node.lower[j] = roundDown(box[0][j]);
+            node.upper[j] = roundUp(box[1][j]);
+        }
+        node.offset = begin;
+        node.count = count;
+    }
+
+    // Split axis.
+    int axis = 0;
+    Vec3<Float> center_extent = center_box[1] - center_box[0];
+    if (center_extent[axis] < center_extent[1]) axis = 1;
+    if (center_extent[axis] < center_extent[2]) axis = 2;
+    if (count <= 2 || 
+        depth >= max_depth || 
+        !(center_extent[axis] > 0)) {
+        return;
+    }
+
+    // Bin primitives.
+    constexpr int num_bins = 16;
+    Float bin_fac = num_bins / center_extent[axis] * (1 - 1e-6);
+    auto binIndex = [&](std::uint32_t k) {
+        int bin = int(bin_fac * (prim_centers[k][axis] - center_box[0][axis]));
+        return std::min(std::max(bin, 0), num_bins - 1);
+    };
+    pre::aabb3<Float> bin_boxes[num_bins];
+    std::uint32_t bin_counts[num_bins] = {};
+    for (int bin = 0; bin < num_bins; bin++) {
+        bin_boxes[bin] = emptyBox();
+    }
+    for (std::uint32_t pos = begin; pos < end; pos++) {
+        std::uint32_t k = prim_indices_[pos];
+        int bin = binIndex(k);
+        expandBox(bin_boxes[bin], prim_bounds[k]);
+        bin_counts[bin]++;
+    }
+
+    // Sweep right to left, then left to right, to find the split 
+    // minimizing SAH cost.
+    Float right_costs[num_bins] = {};
+    {
+        pre::aabb3<Float> right_box = emptyBox();
+        std::uint32_t right_count = 0;
+        for (int bin = num_bins - 1; bin > 0; bin--) {
+            expandBox(right_box, bin_boxes[bin]);
+            right_count += bin_counts[bin];
+            right_costs[bin] = halfArea(right_box) * right_count;
+        }
+    }
+    int best_split = 0;
+    Float best_cost = std::numeric_limits<Float>::infinity();
+    {
+        pre::aabb3<Float> left_box = emptyBox();
+        std::uint32_t left_count = 0;
+        for (int bin = 0; bin < num_bins - 1; bin++) {
+            expandBox(left_box, bin_boxes[bin]);
+            left_count += bin_counts[bin];
+            Float cost = halfArea(left_box) * left_count + 
+                         right_costs[bin + 1];
+            if (best_cost > cost) {
+                best_cost = cost;
+                best_split = bin + 1;
+            }
+        }
+    }
+
+    // Make leaf if cheaper, with unit traversal and intersection costs.
+    constexpr std::uint32_t max_leaf_count = 4;
+    if (count <= max_leaf_count && 
+        count * halfArea(box) <= halfArea(box) + best_cost) {
+        return;
+    }
+
+    // Partition.
+    std::uint32_t* first = prim_indices_.data() + begin;
+    std::uint32_t* last = prim_indices_.data() + end;
+    std::uint32_t* middle = 
+        std::partition(first, last, [&](std::uint32_t k) {
+            return binIndex(k) < best_split;
+        });
+    if (middle == first || 
+        middle == last) {
+        middle = first + count / 2;
+        std::nth_element(
+            first, middle, last, 
+            [&](std::uint32_t k0, std::uint32_t k1) {
+                return prim_centers[k0][axis] < prim_centers[k1][axis];
+            });
+    }
+    std::uint32_t split = begin + std::uint32_t(middle - first);
+
+    // Recurse.
+    std::uint32_t child_index = nodes.size();
+    nodes.emplace_back();
+    nodes.emplace_back();
+    nodes[node_index].offset = child_index;
+    nodes[node_index].count = 0;
+    buildNode(
+        nodes, child_index + 0, begin, split, depth + 1,
+        prim_bounds, prim_centers, task_size, tasks);
+    buildNode(
+        nodes, child_index + 1, split, end, depth + 1,
+        prim_bounds, prim_centers, task_size, tasks);
+}
+
+} // namespace ld
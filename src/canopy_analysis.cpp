@@ -0,0 +1,196 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <leaf-disk-gen/canopy_analysis.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+
+namespace ld {
+
+// Total leaf area.
+Float CanopyAnalysis::leafArea() const
+{
+    Float sum = 0;
+    for (Float area : area_) {
+        sum += area;
+    }
+    return sum;
+}
+
+// Set direction grid.
+void CanopyAnalysis::setDirectionGrid(int num_zenith, int num_azimuth)
+{
+    assert(num_zenith > 0 && num_azimuth > 0);
+    directions_.clear();
+    directions_.reserve(num_zenith * num_azimuth);
+    for (int i = 0; i < num_zenith; i++)
+    for (int j = 0; j < num_azimuth; j++) {
+        Direction direction;
+        direction.zenith = 
+            num_zenith == 1 ? 0 : i * Float(90) / (num_zenith - 1);
+        direction.azimuth = j * Float(360) / num_azimuth;
+        directions_.push_back(direction);
+    }
+}
+
+// Compute.
+void CanopyAnalysis::compute(unsigned int num_threads)
+{
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+
+    // Direction vectors.
+    std::size_t num_dirs = directions_.size();
+    std::vector<Vec3<Float>> dirs(num_dirs);
+    for (std::size_t d = 0; d < num_dirs; d++) {
+        Float theta = directions_[d].zenith * 
+                      pre::numeric_constants<Float>::M_pi() / 180;
+        Float phi = directions_[d].azimuth * 
+                      pre::numeric_constants<Float>::M_pi() / 180;
+        dirs[d] = {
+            pre::sin(theta) * pre::cos(phi),
+            pre::sin(theta) * pre::sin(phi),
+            pre::cos(theta)
+        };
+    }
+
+    // Per-thread partial sums.
+    std::vector<std::vector<Float>> partials(
+            num_threads, std::vector<Float>(num_dirs));
+
+    parallelFor(numLeaves(), num_threads,
+    [&](std::size_t begin, std::size_t end, unsigned int thread_index) {
+        const Float* nx = normal_x_.data();
+        const Float* ny = normal_y_.data();
+        const Float* nz = normal_z_.data();
+        const Float* area = area_.data();
+        Float* partial = partials[thread_index].data();
+
+        // Leaf blocks sized to stay resident in L1 across directions.
+        constexpr std::size_t block_size = 1024;
+        for (std::size_t block_begin = begin; 
+                         block_begin < end; block_begin += block_size) {
+            std::size_t block_end = std::min(block_begin + block_size, end);
+            for (std::size_t d = 0; d < num_dirs; d++) {
+                Float dx = dirs[d][0];
+                Float dy = dirs[d][1];
+                Float dz = dirs[d][2];
+
+                // Independent lanes, so the reduction vectorizes 
+                // without reassociation.
+                constexpr std::size_t lanes = 8;
+                Float sums[lanes] = {};
+                std::size_t k = block_begin;
+                for (; k + lanes <= block_end; k += lanes) {
+                    for (std::size_t l = 0; l < lanes; l++) {
+                        sums[l] += area[k + l] * 
+                            pre::fabs(nx[k + l] * dx + 
+                                      ny[k + l] * dy + 
+                                      nz[k + l] * dz);
+                    }
+                }
+                for (; k < block_end; k++) {
+                    sums[0] += area[k] * 
+                        pre::fabs(nx[k] * dx + ny[k] * dy + nz[k] * dz);
+                }
+                Float sum = 0;
+                for (std::size_t l = 0; l < lanes; l++) {
+                    sum += sums[l];
+                }
+                partial[d] += sum;
+            }
+        }
+    });
+
+    // Reduce.
+    Float leaf_area = leafArea();
+    for (std::size_t d = 0; d < num_dirs; d++) {
+        Float projected_area = 0;
+        for (const std::vector<Float>& partial : partials) {
+            projected_area += partial[d];
+        }
+        directions_[d].projected_area = projected_area;
+        directions_[d].g = leaf_area > 0 ? projected_area / leaf_area : 0;
+    }
+}
+
+// Set reference.
+void CanopyAnalysis::setReference(const CanopyAnalysis& other)
+{
+    assert(other.directions_.size() == directions_.size());
+    for (std::size_t d = 0; d < directions_.size(); d++) {
+        directions_[d].g_reference = other.directions_[d].g;
+    }
+}
+
+// Write JSON.
+void CanopyAnalysis::writeJson(std::ostream& ostr) const
+{
+    Float leaf_area = leafArea();
+    ostr << "{\n";
+    ostr << "  \"num_leaves\": " << numLeaves() << ",\n";
+    ostr << "  \"leaf_area\": " << leaf_area << ",\n";
+    ostr << "  \"ground_area\": " << ground_area_ << ",\n";
+    ostr << "  \"lai\": " << 
+            (ground_area_ > 0 ? leaf_area / ground_area_ : 0) << ",\n";
+    ostr << "  \"directions\": [";
+    for (std::size_t d = 0; d < directions_.size(); d++) {
+        const Direction& direction = directions_[d];
+        ostr << (d == 0 ? "\n" : ",\n");
+        ostr << "    {";
+        ostr << "\"zenith\": " << direction.zenith << ", ";
+        ostr << "\"azimuth\": " << direction.azimuth << ", ";
+        ostr << "\"projected_area\": " << direction.projected_area << ", ";
+        ostr << "\"g\": " << direction.g << ", ";
+        ostr << "\"g_reference\": " << direction.g_reference;
+        ostr << "}";
+    }
+    ostr << "\n  ]\n";
+    ostr << "}\n";
+}
+
+// Write CSV.
+void CanopyAnalysis::writeCsv(std::ostream& ostr) const
+{
+    Float leaf_area = leafArea();
+    ostr << "# num_leaves = " << numLeaves() << "\n";
+    ostr << "# leaf_area = " << leaf_area << "\n";
+    ostr << "# ground_area = " << ground_area_ << "\n";
+    ostr << "# lai = " << 
+            (ground_area_ > 0 ? leaf_area / ground_area_ : 0) << "\n";
+    ostr << "zenith,azimuth,projected_area,g,g_reference\n";
+    for (const Direction& direction : directions_) {
+        ostr << direction.zenith << ',';
+        ostr << direction.azimuth << ',';
+        ostr << direction.projected_area << ',';
+        ostr << direction.g << ',';
+        ostr << direction.g_reference << '\n';
+    }
+}
+
+} // namespace ld
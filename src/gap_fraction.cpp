@@ -0,0 +1,247 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <leaf-disk-gen/canopy_analysis.hpp>
+#include <leaf-disk-gen/gap_fraction.hpp>
+#include <leaf-disk-gen/leaf_ray_caster.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+
+namespace ld {
+
+// Compute.
+void GapFractionAnalysis::compute(
+            const std::vector<LeafDisk>& leaf_disks,
+            const std::vector<std::unique_ptr<LeafVolume>>& volumes,
+            const std::vector<Float>& lais,
+            const std::vector<std::size_t>& volume_groups,
+            const std::vector<std::size_t>& volume_leaf_ends,
+            unsigned int num_threads)
+{
+    assert(num_zenith > 0 && num_azimuth > 0);
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+    results_.clear();
+
+    // Directions.
+    auto zenith = [&](int i) {
+        return num_zenith == 1 ? Float(0) : i * Float(80) / (num_zenith - 1);
+    };
+    auto azimuth = [&](int j) {
+        return j * Float(360) / num_azimuth;
+    };
+    auto direction = [&](int i, int j) {
+        Float theta = zenith(i) * pre::numeric_constants<Float>::M_pi() / 180;
+        Float phi = azimuth(j) * pre::numeric_constants<Float>::M_pi() / 180;
+        return Vec3<Float>{
+            pre::sin(theta) * pre::cos(phi),
+            pre::sin(theta) * pre::sin(phi),
+            pre::cos(theta)
+        };
+    };
+
+    // Groups, if more than one.
+    std::vector<std::size_t> groups(volumes.size(), 0);
+    std::size_t num_groups = 1;
+    if (!volume_groups.empty() &&
+            std::any_of(
+                volume_groups.begin(), volume_groups.end(), 
+                [&](std::size_t group) { 
+                    return group != volume_groups[0]; 
+                })) {
+        assert(volume_groups.size() == volumes.size());
+        assert(volume_leaf_ends.size() == volumes.size());
+        groups = volume_groups;
+        num_groups = 
+            *std::max_element(volume_groups.begin(), volume_groups.end()) + 1;
+    }
+
+    // G-function of generated leaves along ray directions, per group.
+    std::vector<CanopyAnalysis> analyses(num_groups);
+    Float margin = 0;
+    if (num_groups == 1) {
+        for (const LeafDisk& leaf_disk : leaf_disks) {
+            analyses[0].addLeaf(leaf_disk);
+            margin = std::max(margin, leaf_disk.radius);
+        }
+    }
+    else {
+        std::size_t leaf_begin = 0;
+        for (std::size_t v = 0; v < volumes.size(); v++) {
+            for (std::size_t k = leaf_begin; k < volume_leaf_ends[v]; k++) {
+                analyses[groups[v]].addLeaf(leaf_disks[k]);
+                margin = std::max(margin, leaf_disks[k].radius);
+            }
+            leaf_begin = volume_leaf_ends[v];
+        }
+    }
+    std::vector<bool> is_group_used(num_groups, false);
+    for (std::size_t group : groups) {
+        is_group_used[group] = true;
+    }
+    for (std::size_t group = 0; group < num_groups; group++) {
+        if (!is_group_used[group]) {
+            continue;
+        }
+        CanopyAnalysis& analysis = analyses[group];
+        for (int i = 0; i < num_zenith; i++)
+        for (int j = 0; j < num_azimuth; j++) {
+            analysis.addDirection(zenith(i), azimuth(j));
+        }
+        analysis.compute(num_threads);
+    }
+
+    // Ray caster.
+    LeafRayCaster ray_caster;
+    ray_caster.build(leaf_disks, num_threads);
+
+    // Tally per chunk of rays, where each chunk has its own generator,
+    // so results do not depend on the number of threads.
+    struct Tally {
+        std::size_t num_rays = 0;
+        std::size_t num_gaps = 0;
+        Float sum_beer_lambert = 0;
+    };
+    constexpr std::size_t chunk_size = 4096;
+    std::size_t num_chunks = (num_rays + chunk_size - 1) / chunk_size;
+    std::vector<Tally> tallies(volumes.size() * num_zenith * num_chunks);
+    std::atomic<std::size_t> next_task(0);
+    parallelFor(num_threads, num_threads,
+    [&](std::size_t, std::size_t, unsigned int) {
+        std::size_t task;
+        while ((task = next_task++) < tallies.size()) {
+            std::size_t v = task / (num_zenith * num_chunks);
+            std::size_t i = (task / num_chunks) % num_zenith;
+            std::size_t c = task % num_chunks;
+            const LeafVolume& volume = *volumes[v];
+            Tally& tally = tallies[task];
+            Pcg32 pcg(hashCombine(hashCombine(hashCombine(seed, v), i), c));
+            std::size_t ray_begin = c * chunk_size;
+            std::size_t ray_end = std::min(ray_begin + chunk_size, num_rays);
+            for (std::size_t r = ray_begin; r < ray_end; r++) {
+                int j = r % num_azimuth;
+                Vec3<Float> dir = direction(i, j);
+                Vec3<Float> org;
+                Float tmin;
+                Float tmax;
+                if (!volume.sampleRayOrigin(
+                            dir, generateCanonical2(pcg), org) ||
+                    !volume.clipRay(org, dir, margin, tmin, tmax)) {
+                    continue;
+                }
+                tally.num_rays++;
+                if (!ray_caster.occluded(org, dir, tmin, tmax)) {
+                    tally.num_gaps++;
+                }
+
+                // Integrate leaf area density by midpoint rule.
+                Float path_lai = 0;
+                if (volume.clipRay(org, dir, 0, tmin, tmax)) {
+                    constexpr int num_steps = 32;
+                    Float dt = (tmax - tmin) / num_steps;
+                    for (int step = 0; step < num_steps; step++) {
+                        path_lai += dt * volume.leafAreaDensity(
+                                org + (tmin + (step + 0.5) * dt) * dir, 
+                                lais[v]);
+                    }
+                }
+                Float g = 
+                    analyses[groups[v]].directions()[i * num_azimuth + j].g;
+                tally.sum_beer_lambert += std::exp(-g * path_lai);
+            }
+        }
+    });
+
+    // Reduce.
+    for (std::size_t v = 0; v < volumes.size(); v++)
+    for (int i = 0; i < num_zenith; i++) {
+        Result result;
+        result.volume = v;
+        result.zenith = zenith(i);
+        std::size_t num_gaps = 0;
+        Float sum_beer_lambert = 0;
+        for (std::size_t c = 0; c < num_chunks; c++) {
+            const Tally& tally = tallies[(v * num_zenith + i) * num_chunks + c];
+            result.num_rays += tally.num_rays;
+            num_gaps += tally.num_gaps;
+            sum_beer_lambert += tally.sum_beer_lambert;
+        }
+        for (int j = 0; j < num_azimuth; j++) {
+            result.g += 
+                analyses[groups[v]].directions()[i * num_azimuth + j].g;
+        }
+        result.g /= num_azimuth;
+        if (result.num_rays > 0) {
+            result.gap_fraction = Float(num_gaps) / result.num_rays;
+            result.gap_fraction_beer_lambert = 
+                    sum_beer_lambert / result.num_rays;
+        }
+        results_.push_back(result);
+    }
+}
+
+// Write JSON.
+void GapFractionAnalysis::writeJson(std::ostream& ostr) const
+{
+    ostr << "{\n";
+    ostr << "  \"results\": [";
+    for (std::size_t k = 0; k < results_.size(); k++) {
+        const Result& result = results_[k];
+        ostr << (k == 0 ? "\n" : ",\n");
+        ostr << "    {";
+        ostr << "\"volume\": " << result.volume << ", ";
+        ostr << "\"zenith\": " << result.zenith << ", ";
+        ostr << "\"num_rays\": " << result.num_rays << ", ";
+        ostr << "\"g\": " << result.g << ", ";
+        ostr << "\"gap_fraction\": " << result.gap_fraction << ", ";
+        ostr << "\"gap_fraction_beer_lambert\": " << 
+                 result.gap_fraction_beer_lambert;
+        ostr << "}";
+    }
+    ostr << "\n  ]\n";
+    ostr << "}\n";
+}
+
+// Write CSV.
+void GapFractionAnalysis::writeCsv(std::ostream& ostr) const
+{
+    ostr << "volume,zenith,num_rays,g,gap_fraction,gap_fraction_beer_lambert\n";
+    for (const Result& result : results_) {
+        ostr << result.volume << ',';
+        ostr << result.zenith << ',';
+        ostr << result.num_rays << ',';
+        ostr << result.g << ',';
+        ostr << result.gap_fraction << ',';
+        ostr << result.gap_fraction_beer_lambert << '\n';
+    }
+}
+
+} // namespace ld
@@ -26,18 +26,150 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 /*+-+*/
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
 #include <sstream>
+#include <type_traits>
 #include <preform/misc_string.hpp>
 #include <leaf-disk-gen/leaf_angle_distribution.hpp>
 
 namespace ld {
 
+namespace {
+
+// Sine and cosine of 2 pi u, for canonical u. This reduces to the 
+// nearest quarter turn, which is exact since 4 u is, then evaluates 
+// Taylor polynomials on [-pi/4, pi/4], where they are accurate to 
+// double precision. Quadrants are selected without branches, so that
+// loops over this vectorize.
+inline void sinCos2Pi(Float u, Float& sin_phi, Float& cos_phi)
+{
+    int q = int(4 * u + Float(0.5));
+    Float x = pre::numeric_constants<Float>::M_pi_2() * (4 * u - q);
+    Float x2 = x * x;
+    Float s = 
+        x * (1 + x2 * (-1 / Float(6) + 
+                 x2 * (1 / Float(120) + 
+                 x2 * (-1 / Float(5040) + 
+                 x2 * (1 / Float(362880) + 
+                 x2 * (-1 / Float(39916800) + 
+                 x2 * (1 / Float(6227020800) + 
+                 x2 * (-1 / Float(1307674368000)))))))));
+    Float c = 
+        1 + x2 * (-1 / Float(2) + 
+            x2 * (1 / Float(24) + 
+            x2 * (-1 / Float(720) + 
+            x2 * (1 / Float(40320) + 
+            x2 * (-1 / Float(3628800) + 
+            x2 * (1 / Float(479001600) + 
+            x2 * (-1 / Float(87178291200) + 
+            x2 * (1 / Float(20922789888000)))))))));
+
+    // Quadrant, where q = 4 is the same as q = 0.
+    int k = q & 3;
+    sin_phi = k & 1 ? c : s;
+    cos_phi = k & 1 ? s : c;
+    sin_phi = k & 2 ? -sin_phi : sin_phi;
+    cos_phi = (k + 1) & 2 ? -cos_phi : cos_phi;
+}
+
+// Natural logarithm of positive normal x. This splits off the 
+// exponent such that the mantissa is in [sqrt(1/2), sqrt(2)), then sums
+// the inverse hyperbolic tangent series, which is accurate to double
+// precision there. Branch-free, as for sinCos2Pi().
+inline Float logPositive(Float x)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    bits += 0x3FF0000000000000ULL - 0x3FE6A09E667F3BCDULL;
+    Float e = Float(std::int64_t(bits >> 52) - 0x3FF);
+    bits = (bits & 0x000FFFFFFFFFFFFFULL) + 0x3FE6A09E667F3BCDULL;
+    Float m;
+    std::memcpy(&m, &bits, sizeof(m));
+    Float s = (m - 1) / (m + 1);
+    Float s2 = s * s;
+    Float t = 
+        s2 * (1 / Float(3) + 
+        s2 * (1 / Float(5) + 
+        s2 * (1 / Float(7) + 
+        s2 * (1 / Float(9) + 
+        s2 * (1 / Float(11) + 
+        s2 * (1 / Float(13) + 
+        s2 * (1 / Float(15) + 
+        s2 * (1 / Float(17) + 
+        s2 * (1 / Float(19) + 
+        s2 * (1 / Float(21)))))))))));
+
+    // Natural logarithm of 2, split such that e times the high part 
+    // is exact.
+    const Float ln2_hi = 6.93147180369123816490e-01;
+    const Float ln2_lo = 1.90821492927058770002e-10;
+    return e * ln2_hi + (e * ln2_lo + 2 * (s + s * t));
+}
+
+// Trowbridge-Reitz normal from canonical numbers. This is the slope
+// u0 / sqrt(1 - u0^2) in azimuth 2 pi u1, scaled by roughness, with
+// the normal scaled through by sqrt(1 - u0^2) to avoid dividing.
+inline Vec3<Float> trowbridgeReitzNormal(
+            Float alphax, Float alphay, const Vec2<Float>& u)
+{
+    Float sin_phi;
+    Float cos_phi;
+    sinCos2Pi(u[1], sin_phi, cos_phi);
+    Float nx = -alphax * cos_phi * u[0];
+    Float ny = -alphay * sin_phi * u[0];
+    Float nz2 = (1 - u[0]) * (1 + u[0]);
+    Float inv_len = 1 / pre::sqrt(nx * nx + ny * ny + nz2);
+    return {
+        nx * inv_len, 
+        ny * inv_len, 
+        pre::sqrt(nz2) * inv_len
+    };
+}
+
+// Beckmann normal from canonical numbers. This is Box-Muller, which 
+// maps both numbers to the standard normal slope pair, scaled by 
+// roughness. The logarithm of w = 1 - u0 is corrected to first order
+// for the rounding of w, whose error -u0 - (w - 1) is exact, as in 
+// log1p().
+inline Vec3<Float> beckmannNormal(
+            Float alphax, Float alphay, const Vec2<Float>& u)
+{
+    Float w = 1 - u[0];
+    Float log_w = logPositive(w) + (-u[0] - (w - 1)) / w;
+    Float r = pre::sqrt(-2 * log_w);
+    Float sin_phi;
+    Float cos_phi;
+    sinCos2Pi(u[1], sin_phi, cos_phi);
+    Float nx = -alphax * r * cos_phi;
+    Float ny = -alphay * r * sin_phi;
+    Float inv_len = 1 / pre::sqrt(nx * nx + ny * ny + 1);
+    return {
+        nx * inv_len, 
+        ny * inv_len, 
+        inv_len
+    };
+}
+
+} // namespace
+
 // Sample normal direction.
 Vec3<Float> UniformLeafAngleDistribution::sampleNormal(Pcg32& pcg) const
 {
     return Vec3<Float>::uniform_hemisphere_pdf_sample(generateCanonical2(pcg));
 }
 
+// Sample normal direction from canonical numbers.
+Vec3<Float> UniformLeafAngleDistribution::sampleNormal(
+            const Vec2<Float>& u) const
+{
+    return Vec3<Float>::uniform_hemisphere_pdf_sample(u);
+}
+
 // CDF initializer.
 void IsotropicLidfLeafAngleDistribution::lidfInit(int n)
 {
@@ -58,6 +190,15 @@ Vec3<Float> IsotropicLidfLeafAngleDistribution::sampleNormal(Pcg32& pcg) const
     // Generate random numbers.
     Float u0 = generateCanonical(pcg);
     Float u1 = generateCanonical(pcg);
+    return sampleNormal(Vec2<Float>{u0, u1});
+}
+
+// Sample normal from canonical numbers.
+Vec3<Float> IsotropicLidfLeafAngleDistribution::sampleNormal(
+            const Vec2<Float>& u) const
+{
+    Float u0 = u[0];
+    Float u1 = u[1];
 
     // Sample zenith.
     Float theta = 0;
@@ -158,39 +299,244 @@ Vec3<Float> TrowbridgeReitzLeafAngleDistribution::sampleNormal(
 {
     Float u0 = generateCanonical(pcg);
     Float u1 = generateCanonical(pcg);
-    Float m = u0 / pre::sqrt(1 - u0 * u0);
-    Float phi = 2 * pre::numeric_constants<Float>::M_pi() * u1;
-    Float cos_phi = pre::cos(phi);
-    Float sin_phi = pre::sin(phi);
-    return 
-        pre::normalize_safe(
-        Vec3<Float>{
-            -alphax_ * cos_phi * m,
-            -alphay_ * sin_phi * m,
-            1
-        });
+    return sampleNormal(Vec2<Float>{u0, u1});
+}
+
+// Sample normal from canonical numbers.
+Vec3<Float> TrowbridgeReitzLeafAngleDistribution::sampleNormal(
+            const Vec2<Float>& u) const
+{
+    return trowbridgeReitzNormal(alphax_, alphay_, u);
+}
+
+// Sample normals from canonical numbers.
+void TrowbridgeReitzLeafAngleDistribution::sampleNormals(
+            const Vec2<Float>* u,
+            Vec3<Float>* normals,
+            std::size_t count) const
+{
+    const Float alphax = alphax_;
+    const Float alphay = alphay_;
+    for (std::size_t k = 0; k < count; k++) {
+        normals[k] = trowbridgeReitzNormal(alphax, alphay, u[k]);
+    }
 }
 
 // Sample normal.
 Vec3<Float> BeckmannLeafAngleDistribution::sampleNormal(
             Pcg32& pcg) const
 {
-    Vec2<Float> m = {
-        pre::normal_distribution<Float>(0, 1)(pcg),
-        pre::normal_distribution<Float>(0, 1)(pcg)
+    Float u0 = generateCanonical(pcg);
+    Float u1 = generateCanonical(pcg);
+    return sampleNormal(Vec2<Float>{u0, u1});
+}
+
+// Sample normal from canonical numbers.
+Vec3<Float> BeckmannLeafAngleDistribution::sampleNormal(
+            const Vec2<Float>& u) const
+{
+    return beckmannNormal(alphax_, alphay_, u);
+}
+
+// Sample normals from canonical numbers.
+void BeckmannLeafAngleDistribution::sampleNormals(
+            const Vec2<Float>* u,
+            Vec3<Float>* normals,
+            std::size_t count) const
+{
+    const Float alphax = alphax_;
+    const Float alphay = alphay_;
+    for (std::size_t k = 0; k < count; k++) {
+        normals[k] = beckmannNormal(alphax, alphay, u[k]);
+    }
+}
+
+// Constructor.
+TabulatedLeafAngleDistribution::TabulatedLeafAngleDistribution(
+            int num_theta, 
+            int num_phi, 
+            const std::vector<Float>& weights) :
+                num_theta_(num_theta),
+                num_phi_(num_phi)
+{
+    if (!(num_theta > 0 && num_phi > 0) ||
+        weights.size() != std::size_t(num_theta) * std::size_t(num_phi)) {
+        throw
+            std::invalid_argument(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": inconsistent table dimensions"));
+    }
+
+    // Conditional tables over azimuth.
+    std::vector<Float> row_sums(num_theta);
+    conditional_.resize(num_theta);
+    for (int i = 0; i < num_theta; i++) {
+        conditional_[i].init(&weights[std::size_t(i) * num_phi], num_phi);
+        row_sums[i] = conditional_[i].sum();
+    }
+
+    // Marginal table over zenith.
+    marginal_.init(row_sums.data(), num_theta);
+    if (!(marginal_.sum() > 0)) {
+        throw
+            std::invalid_argument(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": table weights must not all be zero"));
+    }
+}
+
+// Sample normal.
+Vec3<Float> TabulatedLeafAngleDistribution::sampleNormal(Pcg32& pcg) const
+{
+    // Generate random numbers.
+    Float u0 = generateCanonical(pcg);
+    Float u1 = generateCanonical(pcg);
+    return sampleNormal(Vec2<Float>{u0, u1});
+}
+
+// Sample normal from canonical numbers.
+Vec3<Float> TabulatedLeafAngleDistribution::sampleNormal(
+            const Vec2<Float>& u) const
+{
+    Float u0 = u[0];
+    Float u1 = u[1];
+
+    // Sample bins, recycling leftover bits for jitter.
+    std::size_t i = marginal_.sample(u0);
+    std::size_t j = conditional_[i].sample(u1);
+
+    // Jitter within bins.
+    Float theta = (i + u0) / num_theta_ * 
+                    pre::numeric_constants<Float>::M_pi_2();
+    Float phi = (j + u1) / num_phi_ * 2 *
+                    pre::numeric_constants<Float>::M_pi();
+    Float cos_theta = pre::cos(theta);
+    Float sin_theta = pre::sin(theta);
+    Float cos_phi = pre::cos(phi);
+    Float sin_phi = pre::sin(phi);
+
+    // Construct direction.
+    return {
+        sin_theta * cos_phi,
+        sin_theta * sin_phi,
+        cos_theta
     };
-    return 
-        pre::normalize_safe(
-        Vec3<Float>{
-            -alphax_ * m[0], 
-            -alphay_ * m[1], 
-            1
-        });
+}
+
+// Load from file.
+TabulatedLeafAngleDistribution 
+TabulatedLeafAngleDistribution::loadFromFile(const std::string& filename)
+{
+    // Read entire file, which is much faster than formatted 
+    // extraction from the stream for large tables.
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs.is_open()) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't open ").append(filename));
+    }
+    std::string text;
+    ifs.seekg(0, std::ios::end);
+    std::streamoff size = ifs.tellg();
+    if (!(size >= 0 && 
+          std::uintmax_t(size) <= std::uintmax_t(text.max_size()))) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't read ").append(filename));
+    }
+    text.resize(size);
+    ifs.seekg(0, std::ios::beg);
+    if (!ifs.read(&text[0], text.size())) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't read ").append(filename));
+    }
+
+    // Blank out comments.
+    for (std::size_t pos = 0; pos < text.size(); pos++) {
+        if (text[pos] == '#') {
+            while (pos < text.size() && text[pos] != '\n') {
+                text[pos++] = ' ';
+            }
+        }
+    }
+
+    // Parse numbers.
+    const char* itr = text.c_str();
+    auto parse = [&](Float& value) {
+        char* end = nullptr;
+        value = std::strtod(itr, &end);
+        if (end == itr) {
+            return false;
+        }
+        itr = end;
+        return true;
+    };
+    // Range check before converting to int, which is otherwise undefined.
+    auto isDimension = [](Float value) {
+        return value >= 1 && 
+               value <= std::numeric_limits<int>::max() &&
+               value == std::floor(value);
+    };
+    Float num_theta = 0;
+    Float num_phi = 0;
+    if (!parse(num_theta) ||
+        !parse(num_phi) || 
+        !isDimension(num_theta) ||
+        !isDimension(num_phi)) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": ").append(filename)
+                .append(" must begin with positive integer "
+                        "dimensions NTHETA NPHI"));
+    }
+
+    // Each weight takes at least 2 characters, so check the count 
+    // against the file size before allocating.
+    std::size_t num_weights = std::size_t(num_theta) * std::size_t(num_phi);
+    if (num_weights > text.size() / 2 + 1) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": ").append(filename)
+                .append(" must contain NTHETA x NPHI "
+                        "non-negative weights"));
+    }
+    std::vector<Float> weights(num_weights);
+    for (Float& weight : weights) {
+        if (!parse(weight) || !(weight >= 0)) {
+            throw
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": ").append(filename)
+                    .append(" must contain NTHETA x NPHI "
+                            "non-negative weights"));
+        }
+    }
+    return TabulatedLeafAngleDistribution(
+                int(num_theta), int(num_phi), weights);
 }
 
 // From string.
 LeafAngleDistribution* 
 LeafAngleDistribution::fromString(const std::string& args)
+{
+    return 
+        std::visit(
+        [](auto&& distribution) -> LeafAngleDistribution* {
+            typedef std::decay_t<decltype(distribution)> Distribution;
+            return new Distribution(std::move(distribution));
+        },
+        variantFromString(args));
+}
+
+// Variant from string.
+LeafAngleDistributionVariant 
+LeafAngleDistribution::variantFromString(const std::string& args)
 {
     std::stringstream ss(args);
     std::string name;
@@ -198,7 +544,7 @@ LeafAngleDistribution::fromString(const std::string& args)
 
     pre::ci_string ci_name = name.c_str();
     if (ci_name == "Uniform") {
-        return new UniformLeafAngleDistribution();
+        return UniformLeafAngleDistribution();
     }
     else
     if (ci_name == "Trigonometric") {
@@ -207,27 +553,27 @@ LeafAngleDistribution::fromString(const std::string& args)
 
         pre::ci_string ci_type = type.c_str();
         if (ci_type == "Planophile") {
-            return new TrigonometricLeafAngleDistribution(
+            return TrigonometricLeafAngleDistribution(
                        TrigonometricLeafAngleDistribution::eTypePlanophile);
         }
         else
         if (ci_type == "Erectophile") {
-            return new TrigonometricLeafAngleDistribution(
+            return TrigonometricLeafAngleDistribution(
                        TrigonometricLeafAngleDistribution::eTypeErectophile);
         }
         else
         if (ci_type == "Plagiophile") {
-            return new TrigonometricLeafAngleDistribution(
+            return TrigonometricLeafAngleDistribution(
                        TrigonometricLeafAngleDistribution::eTypePlagiophile);
         }
         else
         if (ci_type == "Extremophile") {
-            return new TrigonometricLeafAngleDistribution(
+            return TrigonometricLeafAngleDistribution(
                        TrigonometricLeafAngleDistribution::eTypeExtremophile);
         }
         else
         if (ci_type == "Spherical") {
-            return new TrigonometricLeafAngleDistribution(
+            return TrigonometricLeafAngleDistribution(
                        TrigonometricLeafAngleDistribution::eTypeSpherical);
         }
         else {
@@ -265,7 +611,7 @@ LeafAngleDistribution::fromString(const std::string& args)
                     ": format is 'VerhoefBimodal A B' where A and B "
                     "are floating point numbers satsifying |A| + |B| <= 1"));
         }
-        return new VerhoefBimodalLeafAngleDistribution(a, b);
+        return VerhoefBimodalLeafAngleDistribution(a, b);
     }
     else
     if (ci_name == "TrowbridgeReitz" ||
@@ -294,11 +640,25 @@ LeafAngleDistribution::fromString(const std::string& args)
                             "are positive floating point numbers"));
         }
         if (ci_name == "TrowbridgeReitz") {
-            return new TrowbridgeReitzLeafAngleDistribution(alphax, alphay);
+            return TrowbridgeReitzLeafAngleDistribution(alphax, alphay);
         }
         else {
-            return new BeckmannLeafAngleDistribution(alphax, alphay);
+            return BeckmannLeafAngleDistribution(alphax, alphay);
+        }
+    }
+    else
+    if (ci_name == "Tabulated") {
+        std::string filename;
+        std::getline(ss >> std::ws, filename);
+        if (filename.empty()) {
+            // Error.
+            throw
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": format is 'Tabulated FILE' where FILE "
+                            "is the filename of the table"));
         }
+        return TabulatedLeafAngleDistribution::loadFromFile(filename);
     }
     else {
         // Error.
@@ -307,7 +667,6 @@ LeafAngleDistribution::fromString(const std::string& args)
             std::string(__PRETTY_FUNCTION__)
                 .append(": unknown name \"").append(name).append("\"")); 
     }
-    return nullptr;
 }
 
 } // namespace ld
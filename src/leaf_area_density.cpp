@@ -0,0 +1,235 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <leaf-disk-gen/leaf_area_density.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+
+namespace ld {
+
+// Compute.
+void LeafAreaDensityGrid::compute(
+            const std::vector<LeafDisk>& leaf_disks,
+            const pre::aabb3<Float>& bounds,
+            unsigned int num_threads)
+{
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+
+    // Largest radius.
+    Float max_radius = 0;
+    for (const LeafDisk& leaf_disk : leaf_disks) {
+        max_radius = std::max(max_radius, leaf_disk.radius);
+    }
+
+    // Grid, padded by whole voxels covering the largest radius, with 
+    // at most 2^26 values over all channels.
+    int num_channels = numChannels();
+    bounds_ = bounds;
+    std::size_t num_voxels = 1;
+    for (int j = 0; j < 3; j++) {
+        Float extent = bounds[1][j] - bounds[0][j];
+        dims_[j] = std::max<int>(std::ceil(extent / voxel_size), 1);
+        spacing_[j] = extent > 0 ? extent / dims_[j] : voxel_size;
+        Float num_pad = std::ceil(max_radius / spacing_[j]);
+        if (!(num_pad * 2 + dims_[j] <= (1 << 26))) {
+            throw
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": too many voxels, increase voxel size"));
+        }
+        dims_[j] += 2 * int(num_pad);
+        bounds_[0][j] -= num_pad * spacing_[j];
+        bounds_[1][j] += num_pad * spacing_[j];
+        num_voxels *= dims_[j];
+        if (num_voxels * num_channels > (std::size_t(1) << 26)) {
+            throw
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": too many voxels, increase voxel size"));
+        }
+    }
+
+    // Unit disk offsets, by concentric mapping of a stratified grid.
+    int num_side = 
+        std::max<int>(std::ceil(pre::sqrt(Float(num_samples))), 1);
+    std::vector<Vec2<Float>> offsets;
+    offsets.reserve(num_side * num_side);
+    for (int i = 0; i < num_side; i++)
+    for (int k = 0; k < num_side; k++) {
+        Float a = 2 * (i + Float(0.5)) / num_side - 1;
+        Float b = 2 * (k + Float(0.5)) / num_side - 1;
+        Float r = 0;
+        Float phi = 0;
+        Float pi = pre::numeric_constants<Float>::M_pi();
+        if (a == 0 && b == 0) {
+            // Center, for odd num_side.
+        }
+        else if (pre::fabs(a) > pre::fabs(b)) {
+            r = a;
+            phi = pi / 4 * (b / a);
+        }
+        else {
+            r = b;
+            phi = pi / 2 - pi / 4 * (a / b);
+        }
+        offsets.push_back({r * pre::cos(phi), r * pre::sin(phi)});
+    }
+    Float sample_weight = Float(1) / offsets.size();
+
+    // Voxel index of position, clamped against rounding.
+    auto voxelIndex = [&](const Vec3<Float>& pos) {
+        std::size_t index = 0;
+        for (int j = 2; j >= 0; j--) {
+            Float x = (pos[j] - bounds_[0][j]) / spacing_[j];
+            int i = x > 0 ? int(std::min<Float>(x, dims_[j] - 1)) : 0;
+            index = index * dims_[j] + i;
+        }
+        return index;
+    };
+
+    // Per-thread grids, with as many threads as fit in 2^27 values, so 
+    // that memory is bounded regardless of the number of threads.
+    unsigned int num_partials = 
+        std::min<std::size_t>(
+            num_threads, 
+            std::max<std::size_t>(
+                (std::size_t(1) << 27) / (num_voxels * num_channels), 1));
+    std::vector<std::vector<Float>> partials(num_partials);
+    parallelFor(leaf_disks.size(), num_partials,
+    [&](std::size_t begin, std::size_t end, unsigned int thread_index) {
+        std::vector<Float>& partial = partials[thread_index];
+        partial.assign(num_voxels * num_channels, 0);
+        for (std::size_t k = begin; k < end; k++) {
+            const LeafDisk& leaf_disk = leaf_disks[k];
+            Mat3<Float> tbn = Mat3<Float>::build_onb(leaf_disk.normal);
+            Vec3<Float> hatu = 
+                leaf_disk.radius * pre::transpose(tbn)[0];
+            Vec3<Float> hatv = 
+                leaf_disk.radius * pre::transpose(tbn)[1];
+            Float weight = leaf_disk.computeArea() * sample_weight;
+
+            // Moments, in the upper hemisphere.
+            Vec3<Float> n = leaf_disk.normal;
+            if (n[2] < 0) {
+                n = -n;
+            }
+            Float m[9] = {
+                n[0], n[1], n[2],
+                n[0] * n[0], n[1] * n[1], n[2] * n[2],
+                n[0] * n[1], n[0] * n[2], n[1] * n[2]
+            };
+            for (const Vec2<Float>& offset : offsets) {
+                Float* value = 
+                    &partial[num_channels * voxelIndex(
+                        leaf_disk.pos + 
+                        offset[0] * hatu + 
+                        offset[1] * hatv)];
+                value[0] += weight;
+                for (int c = 1; c < num_channels; c++) {
+                    value[c] += weight * m[c - 1];
+                }
+            }
+        }
+    });
+
+    // Reduce, then normalize area to density and moments to means.
+    values_.assign(num_voxels * num_channels, 0);
+    Float voxel_volume = spacing_[0] * spacing_[1] * spacing_[2];
+    parallelFor(num_voxels, num_threads,
+    [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (const std::vector<Float>& partial : partials) {
+            if (partial.empty()) {
+                continue;
+            }
+            for (std::size_t k = begin * num_channels; 
+                             k < end * num_channels; k++) {
+                values_[k] += partial[k];
+            }
+        }
+        for (std::size_t v = begin; v < end; v++) {
+            Float* value = &values_[v * num_channels];
+            Float area = value[0];
+            value[0] = area / voxel_volume;
+            for (int c = 1; c < num_channels; c++) {
+                value[c] = area > 0 ? value[c] / area : 0;
+            }
+        }
+    });
+}
+
+// Write NRRD.
+void LeafAreaDensityGrid::writeNrrd(std::ostream& ostr) const
+{
+    ostr.precision(std::numeric_limits<Float>::max_digits10);
+    ostr << "NRRD0004\n";
+    ostr << "# leaf-disk-gen leaf area density grid\n";
+    ostr << "type: float\n";
+    if (numChannels() == 1) {
+        ostr << "dimension: 3\n";
+        ostr << "sizes: ";
+        ostr << dims_[0] << ' ' << dims_[1] << ' ' << dims_[2] << '\n';
+        ostr << "spacings: ";
+        ostr << spacing_[0] << ' ' << spacing_[1] << ' ';
+        ostr << spacing_[2] << '\n';
+        ostr << "axis mins: ";
+        ostr << bounds_[0][0] << ' ' << bounds_[0][1] << ' ';
+        ostr << bounds_[0][2] << '\n';
+        ostr << "centers: cell cell cell\n";
+    }
+    else {
+        ostr << "dimension: 4\n";
+        ostr << "sizes: " << numChannels() << ' ';
+        ostr << dims_[0] << ' ' << dims_[1] << ' ' << dims_[2] << '\n';
+        ostr << "kinds: vector domain domain domain\n";
+        ostr << "spacings: nan ";
+        ostr << spacing_[0] << ' ' << spacing_[1] << ' ';
+        ostr << spacing_[2] << '\n';
+        ostr << "axis mins: nan ";
+        ostr << bounds_[0][0] << ' ' << bounds_[0][1] << ' ';
+        ostr << bounds_[0][2] << '\n';
+        ostr << "centers: none cell cell cell\n";
+        ostr << "channels:=lad nx ny nz nxx nyy nzz nxy nxz nyz\n";
+    }
+    ostr << "endian: little\n";
+    ostr << "encoding: raw\n";
+    ostr << "\n";
+
+    // Write, assuming little endian host.
+    std::vector<float> data(values_.begin(), values_.end());
+    ostr.write(
+        reinterpret_cast<const char*>(data.data()), 
+        data.size() * sizeof(float));
+}
+
+} // namespace ld
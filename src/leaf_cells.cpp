@@ -0,0 +1,94 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <leaf-disk-gen/leaf_cells.hpp>
+
+namespace ld {
+
+// Constructor.
+LeafCellGenerator::LeafCellGenerator(
+            const LeafVolume& volume,
+            Float lai,
+            Float leaf_radius,
+            Float cell_size,
+            std::uint64_t seed) :
+                volume_(&volume),
+                leaf_radius_(leaf_radius),
+                cell_size_(cell_size),
+                seed_(seed)
+{
+    pre::aabb3<Float> bounds = volume.bounds();
+    for (int j = 0; j < 2; j++) {
+        Float num_cells = 
+            std::max<Float>(
+            std::ceil((bounds[1][j] - bounds[0][j]) / cell_size), 1);
+        if (!(num_cells <= (1 << 24))) {
+            throw
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": too many cells, increase cell size"));
+        }
+        num_cells_[j] = num_cells;
+        origin_[j] = bounds[0][j];
+    }
+    leaves_per_cell_ = 
+        lai * cell_size * cell_size / 
+        (pre::numeric_constants<Float>::M_pi() * leaf_radius * leaf_radius);
+}
+
+// Cell range.
+void LeafCellGenerator::cellRange(
+            const pre::aabb3<Float>& bounds,
+            int first[2],
+            int last[2]) const
+{
+    pre::aabb3<Float> volume_bounds = volume_->bounds();
+    for (int j = 0; j < 3; j++) {
+        if (!(bounds[0][j] <= volume_bounds[1][j] && 
+              bounds[1][j] >= volume_bounds[0][j])) {
+            first[0] = last[0] = 0;
+            first[1] = last[1] = 0;
+            return;
+        }
+    }
+
+    // Pad by one cell, since leaves on cell boundaries may round either
+    // way, and queries filter leaves by position anyway.
+    for (int j = 0; j < 2; j++) {
+        Float x0 = (bounds[0][j] - origin_[j]) / cell_size_;
+        Float x1 = (bounds[1][j] - origin_[j]) / cell_size_;
+        first[j] = std::max<Float>(std::floor(x0) - 1, 0);
+        last[j] = std::min<Float>(std::floor(x1) + 2, num_cells_[j]);
+    }
+}
+
+} // namespace ld
@@ -0,0 +1,225 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <leaf-disk-gen/leaf_clumping.hpp>
+
+namespace ld {
+
+// Constructor.
+ThomasLeafClumping::ThomasLeafClumping(
+            const LeafVolume& volume,
+            std::size_t num_leaves,
+            Float leaves_per_cluster,
+            Float cluster_radius,
+            std::uint64_t seed,
+            bool periodic) :
+                volume_(&volume),
+                cluster_radius_(cluster_radius),
+                periodic_(periodic)
+{
+    if (!(leaves_per_cluster >= 1 && cluster_radius > 0)) {
+        throw
+            std::invalid_argument(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": invalid cluster parameters"));
+    }
+    if (num_leaves == 0) {
+        return;
+    }
+    std::size_t num_parents = std::max<std::size_t>(
+                std::llround(num_leaves / leaves_per_cluster), 1);
+    num_parents = std::min<std::size_t>(num_parents, num_leaves);
+    if (num_parents > std::size_t(UINT32_MAX)) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": too many clusters"));
+    }
+
+    // Place parents.
+    Pcg32 pcg(seed);
+    std::vector<Vec3<Float>> parents(num_parents);
+    for (Vec3<Float>& parent : parents) {
+        parent = volume.samplePosition(generateCanonical3(pcg));
+    }
+
+    // Grid, with about one parent per cell.
+    pre::aabb3<Float> bounds = volume.bounds();
+    Vec3<Float> extent = bounds[1] - bounds[0];
+    Float cell_volume = 1;
+    int num_axes = 0;
+    for (int j = 0; j < 3; j++) {
+        if (extent[j] > 0) {
+            cell_volume *= extent[j];
+            num_axes++;
+        }
+    }
+    Float cell_size = 
+        num_axes == 0 ? 1 : 
+        std::pow(cell_volume / num_parents, Float(1) / num_axes);
+    std::size_t dims[3];
+    std::size_t num_cells = 1;
+    for (int j = 0; j < 3; j++) {
+        dims[j] = std::max<std::size_t>(
+                  std::min<Float>(extent[j] / cell_size, 1 << 10), 1);
+        num_cells *= dims[j];
+    }
+    auto cellIndex = [&](const Vec3<Float>& pos) {
+        std::size_t index = 0;
+        for (int j = 0; j < 3; j++) {
+            Float x = extent[j] > 0 ? 
+                (pos[j] - bounds[0][j]) / extent[j] * dims[j] : 0;
+            std::size_t i = x > 0 ? std::size_t(x) : 0;
+            index = index * dims[j] + std::min(i, dims[j] - 1);
+        }
+        return index;
+    };
+
+    // Counting sort parents by cell.
+    std::vector<std::size_t> cell_begin(num_cells + 1);
+    for (const Vec3<Float>& parent : parents) {
+        cell_begin[cellIndex(parent) + 1]++;
+    }
+    for (std::size_t cell = 0; cell < num_cells; cell++) {
+        cell_begin[cell + 1] += cell_begin[cell];
+    }
+    parents_.resize(num_parents);
+    for (const Vec3<Float>& parent : parents) {
+        parents_[cell_begin[cellIndex(parent)]++] = parent;
+    }
+
+    // Assign leaves to uniformly random parents, then order leaves by
+    // parent.
+    std::vector<std::uint64_t> counts(num_parents);
+    for (std::size_t k = 0; k < num_leaves; k++) {
+        std::size_t p = generateCanonical(pcg) * num_parents;
+        counts[std::min(p, num_parents - 1)]++;
+    }
+    leaf_parents_.reserve(num_leaves);
+    for (std::size_t p = 0; p < num_parents; p++) {
+        leaf_parents_.insert(leaf_parents_.end(), counts[p], p);
+    }
+}
+
+// Sample position.
+Vec3<Float> ThomasLeafClumping::samplePosition(
+            std::size_t k, Pcg32& pcg) const
+{
+    const Vec3<Float>& parent = parents_[leaf_parents_[k]];
+    pre::aabb3<Float> bounds = volume_->bounds();
+
+    // Offset only along axes of positive extent, so that clusters in 
+    // flat volumes stay in plane. Wrap offsets around the bounds in X 
+    // and Y if periodic, and otherwise reflect them at the bounds, so 
+    // clusters near the boundary keep all of their leaves instead of 
+    // being truncated. This is exact for boxes. For other volumes, 
+    // reject offsets that still leave the volume, resampling uniformly
+    // in the volume after too many attempts.
+    for (int attempt = 0; attempt < 64; attempt++) {
+        Vec3<Float> pos = parent;
+        for (int j = 0; j < 3; j++) {
+            Float extent = bounds[1][j] - bounds[0][j];
+            if (!(extent > 0)) {
+                continue;
+            }
+            Float x = 
+                pos[j] - bounds[0][j] + 
+                cluster_radius_ * pre::normal_distribution<Float>(0, 1)(pcg);
+            if (periodic_ && j < 2) {
+                x = std::fmod(x, extent);
+                x = x < 0 ? x + extent : x;
+            }
+            else {
+                x = std::fmod(x, 2 * extent);
+                x = x < 0 ? x + 2 * extent : x;
+                x = x > extent ? 2 * extent - x : x;
+            }
+            pos[j] = bounds[0][j] + x;
+        }
+        if (volume_->leafAreaDensity(pos, 1) > 0) {
+            return pos;
+        }
+    }
+    return volume_->samplePosition(generateCanonical3(pcg));
+}
+
+// Leaves per cluster.
+Float ThomasLeafClumping::leavesPerCluster(
+            Float clumping_index,
+            Float cluster_radius,
+            Float leaf_area,
+            Float g)
+{
+    if (!(clumping_index > 0 && clumping_index <= 1)) {
+        throw
+            std::invalid_argument(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": clumping index must be in (0, 1]"));
+    }
+
+    // Clumping index as a function of peak optical depth q, being 
+    // Ein(q)/q. Substituting s = exp(x), Ein(q) is the integral of 
+    // 1 - exp(-exp(x)) up to log(q), which is smooth, so use Simpson's 
+    // rule. The integrand is below exp(-30) past the lower limit.
+    auto omega = [](Float q) {
+        const int n = 2048;
+        Float x0 = -30;
+        Float x1 = std::log(q);
+        auto f = [](Float x) {
+            return -std::expm1(-std::exp(x));
+        };
+        Float h = (x1 - x0) / n;
+        Float sum = f(x0) + f(x1);
+        for (int i = 1; i < n; i++) {
+            sum += (i % 2 == 1 ? 4 : 2) * f(x0 + i * h);
+        }
+        return sum * h / 3 / q;
+    };
+
+    // Bisect over log q, since omega decreases monotonically.
+    Float log_q0 = std::log(Float(1e-6));
+    Float log_q1 = std::log(Float(1e+6));
+    for (int iter = 0; iter < 64; iter++) {
+        Float log_q = (log_q0 + log_q1) / 2;
+        if (omega(std::exp(log_q)) > clumping_index) {
+            log_q0 = log_q;
+        }
+        else {
+            log_q1 = log_q;
+        }
+    }
+    Float q = std::exp((log_q0 + log_q1) / 2);
+    return std::max(
+            q * 2 * pre::numeric_constants<Float>::M_pi() * 
+            cluster_radius * cluster_radius / (g * leaf_area), Float(1));
+}
+
+} // namespace ld
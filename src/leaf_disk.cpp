@@ -56,7 +56,49 @@ void LeafDisk::writeGListInstance(std::ostream& ostr) const
 // Write OBJ.
 void LeafDisk::writeObj(
             std::ostream& ostr, 
-            unsigned int& ver_offset, 
+            std::uint64_t& ver_offset, 
+            unsigned int ver_res) const
+{
+    ver_res = writeObjVertices(ostr, ver_res);
+
+    // Write triangles.
+    for (unsigned int j = 0; j < ver_res; j++) {
+        std::uint64_t v0 = 0 + ver_offset;
+        std::uint64_t v1 = 1 + (j + 0) % ver_res + ver_offset;
+        std::uint64_t v2 = 1 + (j + 1) % ver_res + ver_offset;
+        ostr << "f ";
+        ostr << v0 + 1 << ' ';
+        ostr << v1 + 1 << ' ';
+        ostr << v2 + 1 << '\n';
+    }
+
+    // Bump vertex offset.
+    ver_offset += ver_res + 1;
+}
+
+// Write OBJ, with relative face indices.
+void LeafDisk::writeObjRelative(
+            std::ostream& ostr, 
+            unsigned int ver_res) const
+{
+    ver_res = writeObjVertices(ostr, ver_res);
+
+    // Write triangles, where -1 is the last vertex written.
+    int num_vers = ver_res + 1;
+    for (unsigned int j = 0; j < ver_res; j++) {
+        int v0 = 0;
+        int v1 = 1 + (j + 0) % ver_res;
+        int v2 = 1 + (j + 1) % ver_res;
+        ostr << "f ";
+        ostr << v0 - num_vers << ' ';
+        ostr << v1 - num_vers << ' ';
+        ostr << v2 - num_vers << '\n';
+    }
+}
+
+// Write OBJ vertices.
+unsigned int LeafDisk::writeObjVertices(
+            std::ostream& ostr, 
             unsigned int ver_res) const
 {
     // TBN matrix.
@@ -92,20 +134,7 @@ void LeafDisk::writeObj(
         ostr << ver[1] << ' ';
         ostr << ver[2] << '\n';
     }
-
-    // Write triangles.
-    for (unsigned int j = 0; j < ver_res; j++) {
-        unsigned int v0 = 0 + ver_offset;
-        unsigned int v1 = 1 + (j + 0) % ver_res + ver_offset;
-        unsigned int v2 = 1 + (j + 1) % ver_res + ver_offset;
-        ostr << "f ";
-        ostr << v0 + 1 << ' ';
-        ostr << v1 + 1 << ' ';
-        ostr << v2 + 1 << '\n';
-    }
-
-    // Bump vertex offset.
-    ver_offset += ver_res + 1;
+    return ver_res;
 }
 
 } // namespace ld
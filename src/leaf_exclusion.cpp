@@ -0,0 +1,608 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <leaf-disk-gen/leaf_exclusion.hpp>
+#include <leaf-disk-gen/mapped_file.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+
+namespace ld {
+
+namespace {
+
+// Closed mesh index of triangles of open meshes.
+constexpr std::uint32_t open_mesh = 
+    std::numeric_limits<std::uint32_t>::max();
+
+// Is space or tab?
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// Skip spaces and tabs.
+inline const char* skipBlanks(const char* pos, const char* end)
+{
+    while (pos < end && isBlank(*pos)) {
+        pos++;
+    }
+    return pos;
+}
+
+// Closest point on triangle to point, after Ericson, Real-Time 
+// Collision Detection, Section 5.1.5.
+Vec3<Float> closestPoint(
+            const Vec3<Float>& p,
+            const Vec3<Float>& a,
+            const Vec3<Float>& b,
+            const Vec3<Float>& c)
+{
+    Vec3<Float> ab = b - a;
+    Vec3<Float> ac = c - a;
+    Vec3<Float> ap = p - a;
+    Float d1 = pre::dot(ab, ap);
+    Float d2 = pre::dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0) {
+        return a;
+    }
+    Vec3<Float> bp = p - b;
+    Float d3 = pre::dot(ab, bp);
+    Float d4 = pre::dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3) {
+        return b;
+    }
+    Float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        return a + (d1 / (d1 - d3)) * ab;
+    }
+    Vec3<Float> cp = p - c;
+    Float d5 = pre::dot(ab, cp);
+    Float d6 = pre::dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6) {
+        return c;
+    }
+    Float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        return a + (d2 / (d2 - d6)) * ac;
+    }
+    Float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+        return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+    }
+    Float inv_sum = 1 / (va + vb + vc);
+    return a + (vb * inv_sum) * ab + (vc * inv_sum) * ac;
+}
+
+// Squared distance from point to triangle.
+Float distance2(
+            const Vec3<Float>& p,
+            const Vec3<Float>& a,
+            const Vec3<Float>& b,
+            const Vec3<Float>& c)
+{
+    Vec3<Float> d = p - closestPoint(p, a, b, c);
+    return pre::dot(d, d);
+}
+
+// Squared distance from point to disk, being the squared height over
+// the plane of the disk plus the squared radial distance beyond the
+// rim.
+Float distance2(const Vec3<Float>& p, const LeafDisk& leaf_disk)
+{
+    Vec3<Float> v = p - leaf_disk.pos;
+    Float h = pre::dot(v, leaf_disk.normal);
+    Vec3<Float> w = v - h * leaf_disk.normal;
+    Float e = 
+        std::max(pre::sqrt(pre::dot(w, w)) - leaf_disk.radius, Float(0));
+    return h * h + e * e;
+}
+
+// Squared distance from segment to disk, or any value not exceeding 
+// the target once within it. The squared distance to a convex set is 
+// convex along the segment, so golden section search converges to 
+// the minimum.
+Float distance2(
+            const Vec3<Float>& a,
+            const Vec3<Float>& b,
+            const LeafDisk& leaf_disk,
+            Float target2)
+{
+    const Float g = Float(0.6180339887498949);
+    Vec3<Float> ab = b - a;
+    Float t0 = 0;
+    Float t1 = 1;
+    Float s0 = 1 - g;
+    Float s1 = g;
+    Float f0 = distance2(a + s0 * ab, leaf_disk);
+    Float f1 = distance2(a + s1 * ab, leaf_disk);
+    for (int iter = 0; iter < 48 && std::min(f0, f1) > target2; iter++) {
+        if (f0 < f1) {
+            t1 = s1;
+            s1 = s0;
+            f1 = f0;
+            s0 = t1 - g * (t1 - t0);
+            f0 = distance2(a + s0 * ab, leaf_disk);
+        }
+        else {
+            t0 = s0;
+            s0 = s1;
+            f0 = f1;
+            s1 = t0 + g * (t1 - t0);
+            f1 = distance2(a + s1 * ab, leaf_disk);
+        }
+    }
+    return std::min({
+            f0, f1, 
+            distance2(a, leaf_disk), 
+            distance2(b, leaf_disk)});
+}
+
+// Disk within clearance of triangle? 
+//
+// If the disk and triangle are disjoint, one of the closest points is 
+// on the boundary of its set. On the triangle boundary, that is the
+// distance from an edge to the disk. On the disk boundary, with the 
+// other point inside the triangle, the rim point is the one nearest 
+// the plane of the triangle, which is unique unless the rim crosses 
+// the plane, in which case the disk intersects the triangle or the
+// closest points are on an edge after all.
+bool overlaps(
+            const LeafDisk& leaf_disk, 
+            const Vec3<Float>& a,
+            const Vec3<Float>& b,
+            const Vec3<Float>& c,
+            Float clearance)
+{
+    const Vec3<Float>& pos = leaf_disk.pos;
+    const Vec3<Float>& normal = leaf_disk.normal;
+    Float radius = leaf_disk.radius;
+    Float clearance2 = clearance * clearance;
+
+    // Center bounds, which settle most candidates.
+    Float center_dist2 = distance2(pos, a, b, c);
+    if (center_dist2 > (radius + clearance) * (radius + clearance)) {
+        return false;
+    }
+    if (center_dist2 <= clearance2) {
+        return true;
+    }
+
+    // Triangle beyond clearance of the plane of the disk?
+    Float h[3] = {
+        pre::dot(a - pos, normal),
+        pre::dot(b - pos, normal),
+        pre::dot(c - pos, normal)
+    };
+    Float h_min = std::min({h[0], h[1], h[2]});
+    Float h_max = std::max({h[0], h[1], h[2]});
+    if (h_min > clearance || h_max < -clearance) {
+        return false;
+    }
+
+    // Coplanar, so the distance is that of the center less the radius,
+    // which is within clearance by the center bounds.
+    if (h_min == 0 && h_max == 0) {
+        return true;
+    }
+
+    // Triangle crosses the plane of the disk, so the disk intersects
+    // the triangle if the disk contains any of the crossing segment.
+    if (h_min <= 0 && h_max >= 0) {
+        const Vec3<Float>* v[3] = {&a, &b, &c};
+        Vec3<Float> ends[2];
+        int num_ends = 0;
+        for (int i = 0; i < 3 && num_ends < 2; i++) {
+            int j = (i + 1) % 3;
+            if (h[i] == 0) {
+                ends[num_ends++] = *v[i];
+            }
+            else if ((h[i] < 0 && h[j] > 0) || 
+                     (h[i] > 0 && h[j] < 0)) {
+                ends[num_ends++] = 
+                    *v[i] + (h[i] / (h[i] - h[j])) * (*v[j] - *v[i]);
+            }
+        }
+        if (num_ends == 1) {
+            ends[1] = ends[0];
+        }
+        if (num_ends > 0) {
+            Vec3<Float> d = ends[1] - ends[0];
+            Float dd = pre::dot(d, d);
+            Float t = dd > 0 ? pre::dot(pos - ends[0], d) / dd : 0;
+            t = std::min(std::max(t, Float(0)), Float(1));
+            Vec3<Float> off = ends[0] + t * d - pos;
+            if (pre::dot(off, off) <= radius * radius) {
+                return true;
+            }
+        }
+    }
+    if (!(clearance > 0)) {
+        return false;
+    }
+
+    // Edges.
+    if (distance2(a, b, leaf_disk, clearance2) <= clearance2 ||
+        distance2(b, c, leaf_disk, clearance2) <= clearance2 ||
+        distance2(c, a, leaf_disk, clearance2) <= clearance2) {
+        return true;
+    }
+
+    // Rim point nearest the plane of the triangle, unless the rim 
+    // crosses it.
+    Vec3<Float> tri_normal = pre::cross(b - a, c - a);
+    tri_normal /= pre::sqrt(pre::dot(tri_normal, tri_normal));
+    Float height = pre::dot(pos - a, tri_normal);
+    Vec3<Float> dir = tri_normal - pre::dot(tri_normal, normal) * normal;
+    Float dir_len = pre::sqrt(pre::dot(dir, dir));
+    if (pre::fabs(height) > radius * dir_len) {
+        Vec3<Float> rim = pos;
+        if (dir_len > 0) {
+            rim -= (height > 0 ? radius : -radius) / dir_len * dir;
+        }
+        return distance2(rim, a, b, c) <= clearance2;
+    }
+    return false;
+}
+
+// Ray intersects triangle at positive parameter? After Moller and 
+// Trumbore, Fast, Minimum Storage Ray/Triangle Intersection.
+bool intersects(
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            const Vec3<Float>& a,
+            const Vec3<Float>& b,
+            const Vec3<Float>& c)
+{
+    Vec3<Float> ab = b - a;
+    Vec3<Float> ac = c - a;
+    Vec3<Float> p = pre::cross(dir, ac);
+    Float det = pre::dot(ab, p);
+    if (det == 0) {
+        return false;
+    }
+    Float inv_det = 1 / det;
+    Vec3<Float> ao = org - a;
+    Float u = pre::dot(ao, p) * inv_det;
+    if (!(u >= 0 && u <= 1)) {
+        return false;
+    }
+    Vec3<Float> q = pre::cross(ao, ab);
+    Float v = pre::dot(dir, q) * inv_det;
+    if (!(v >= 0 && u + v <= 1)) {
+        return false;
+    }
+    return pre::dot(ac, q) * inv_det > 0;
+}
+
+} // namespace
+
+// Load OBJ mesh.
+void LeafExclusion::loadObj(const std::string& filename)
+{
+    MappedFile file(filename);
+    std::vector<Vec3<Float>> vers;
+    std::vector<std::size_t> face;
+    std::vector<std::array<std::uint32_t, 3>> faces;
+    const char* pos = file.data();
+    const char* end = pos + file.size();
+    std::size_t line_number = 0;
+    auto fail = [&, function = __PRETTY_FUNCTION__](const char* what) {
+        throw 
+            std::runtime_error(
+            std::string(function).append(": ").append(what)
+                .append(" on line ").append(std::to_string(line_number))
+                .append(" of ").append(filename));
+    };
+    while (pos < end) {
+        const char* line_end = 
+            static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+        if (!line_end) {
+            line_end = end;
+        }
+        line_number++;
+        const char* cur = skipBlanks(pos, line_end);
+        if (line_end - cur >= 2 && cur[0] == 'v' && isBlank(cur[1])) {
+            // Vertex.
+            Vec3<Float> ver;
+            cur += 2;
+            for (int j = 0; j < 3; j++) {
+                cur = skipBlanks(cur, line_end);
+                std::from_chars_result result = 
+                    std::from_chars(cur, line_end, ver[j]);
+                if (result.ec != std::errc()) {
+                    fail("malformed vertex");
+                }
+                cur = result.ptr;
+            }
+            vers.push_back(ver);
+        }
+        else
+        if (line_end - cur >= 2 && cur[0] == 'f' && isBlank(cur[1])) {
+            // Face, with vertex index before any texture or normal index.
+            face.clear();
+            cur += 2;
+            while ((cur = skipBlanks(cur, line_end)) < line_end && 
+                   *cur != '\r') {
+                long long index = 0;
+                std::from_chars_result result = 
+                    std::from_chars(cur, line_end, index);
+                if (result.ec != std::errc()) {
+                    fail("malformed face");
+                }
+                if (index < 0) {
+                    index += vers.size();
+                }
+                else {
+                    index -= 1;
+                }
+                if (index < 0 || index >= (long long)vers.size()) {
+                    fail("face vertex out of range");
+                }
+                if (index >= (long long)open_mesh) {
+                    fail("too many vertices");
+                }
+                face.push_back(index);
+                cur = result.ptr;
+                while (cur < line_end && !isBlank(*cur) && *cur != '\r') {
+                    cur++;
+                }
+            }
+            if (face.size() < 3) {
+                fail("face with fewer than 3 vertices");
+            }
+
+            // Fan triangulate.
+            for (std::size_t k = 2; k < face.size(); k++) {
+                faces.push_back({
+                    std::uint32_t(face[0]),
+                    std::uint32_t(face[k - 1]),
+                    std::uint32_t(face[k])
+                });
+            }
+        }
+        pos = line_end + 1;
+    }
+
+    // Weld vertices by position, so that seams with duplicate 
+    // vertices still connect.
+    std::vector<std::uint32_t> welds(vers.size());
+    {
+        std::vector<std::uint32_t> order(vers.size());
+        std::iota(order.begin(), order.end(), std::uint32_t(0));
+        auto key = [&](std::uint32_t index) {
+            return std::tie(vers[index][0], vers[index][1], vers[index][2]);
+        };
+        std::sort(order.begin(), order.end(), 
+        [&](std::uint32_t index0, std::uint32_t index1) {
+            return key(index0) < key(index1);
+        });
+        for (std::size_t k = 0; k < order.size(); k++) {
+            welds[order[k]] = 
+                k > 0 && key(order[k - 1]) == key(order[k]) ? 
+                    welds[order[k - 1]] : order[k];
+        }
+    }
+    for (std::array<std::uint32_t, 3>& indices : faces) {
+        for (std::uint32_t& index : indices) {
+            index = welds[index];
+        }
+    }
+
+    // Meshes are connected components, by union-find over edges.
+    std::vector<std::uint32_t> parents(vers.size());
+    std::iota(parents.begin(), parents.end(), std::uint32_t(0));
+    auto findRoot = [&](std::uint32_t index) {
+        while (parents[index] != index) {
+            parents[index] = parents[parents[index]];
+            index = parents[index];
+        }
+        return index;
+    };
+    std::vector<std::uint64_t> edges;
+    edges.reserve(3 * faces.size());
+    for (const std::array<std::uint32_t, 3>& indices : faces) {
+        if (indices[0] == indices[1] || 
+            indices[1] == indices[2] || 
+            indices[2] == indices[0]) {
+            continue;
+        }
+        for (int j = 0; j < 3; j++) {
+            std::uint32_t index0 = indices[j];
+            std::uint32_t index1 = indices[(j + 1) % 3];
+            parents[findRoot(index0)] = findRoot(index1);
+            edges.push_back(
+                    std::uint64_t(std::min(index0, index1)) << 32 | 
+                    std::max(index0, index1));
+        }
+    }
+
+    // A mesh is closed if every edge is shared by exactly 2 triangles.
+    std::vector<bool> is_open(vers.size());
+    std::sort(edges.begin(), edges.end());
+    for (std::size_t k = 0; k < edges.size();) {
+        std::size_t count = 1;
+        while (k + count < edges.size() && edges[k + count] == edges[k]) {
+            count++;
+        }
+        if (count != 2) {
+            is_open[findRoot(edges[k] >> 32)] = true;
+        }
+        k += count;
+    }
+
+    // Triangles, skipping degenerate ones.
+    std::vector<std::uint32_t> mesh_indices(vers.size(), open_mesh);
+    for (const std::array<std::uint32_t, 3>& indices : faces) {
+        Triangle triangle = {{
+            vers[indices[0]],
+            vers[indices[1]],
+            vers[indices[2]]
+        }, open_mesh};
+        Vec3<Float> area = 
+            pre::cross(
+                triangle.v[1] - triangle.v[0],
+                triangle.v[2] - triangle.v[0]);
+        if (!(pre::dot(area, area) > 0)) {
+            continue;
+        }
+        std::uint32_t root = findRoot(indices[0]);
+        if (!is_open[root]) {
+            if (mesh_indices[root] == open_mesh) {
+                mesh_indices[root] = num_closed_meshes_++;
+            }
+            triangle.mesh = mesh_indices[root];
+        }
+        triangles_.push_back(triangle);
+    }
+}
+
+// Build.
+void LeafExclusion::build(Float clearance, unsigned int num_threads)
+{
+    clearance_ = clearance;
+    std::vector<pre::aabb3<Float>> prim_bounds(triangles_.size());
+    parallelFor(triangles_.size(), num_threads,
+    [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t k = begin; k < end; k++) {
+            const Vec3<Float>* v = triangles_[k].v;
+            prim_bounds[k] = {
+                pre::min(v[0], pre::min(v[1], v[2])),
+                pre::max(v[0], pre::max(v[1], v[2]))
+            };
+        }
+    });
+    bvh_.build(prim_bounds, num_threads);
+
+    // Reorder triangles for locality.
+    const std::vector<std::uint32_t>& prim_indices = bvh_.primIndices();
+    std::vector<Triangle> triangles(prim_indices.size());
+    parallelFor(prim_indices.size(), num_threads,
+    [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t pos = begin; pos < end; pos++) {
+            triangles[pos] = triangles_[prim_indices[pos]];
+        }
+    });
+    triangles_.swap(triangles);
+}
+
+// Excludes leaf disk?
+bool LeafExclusion::excludes(const LeafDisk& leaf_disk) const
+{
+    // Exact disk bounds, as in LeafRayCaster::build(), extended by 
+    // clearance.
+    Vec3<Float> ext;
+    for (int j = 0; j < 3; j++) {
+        ext[j] = leaf_disk.radius * 
+            pre::sqrt(std::max(Float(0), 
+                1 - leaf_disk.normal[j] * leaf_disk.normal[j])) + 
+            clearance_;
+    }
+    bool excluded = false;
+    bvh_.overlapBox(
+        pre::aabb3<Float>{
+            leaf_disk.pos - ext,
+            leaf_disk.pos + ext
+        },
+        [&](std::uint32_t pos) {
+            const Triangle& triangle = triangles_[pos];
+            excluded = 
+                overlaps(
+                    leaf_disk, 
+                    triangle.v[0], triangle.v[1], triangle.v[2], 
+                    clearance_);
+            return excluded;
+        });
+
+    // Otherwise, the disk is entirely on one side of each mesh, so it 
+    // is inside if its center is.
+    return excluded || contains(leaf_disk.pos);
+}
+
+// Contains point?
+bool LeafExclusion::contains(const Vec3<Float>& pos) const
+{
+    if (num_closed_meshes_ == 0) {
+        return false;
+    }
+
+    // Outside the root bounds?
+    const Bvh::Node& root = bvh_.nodes()[0];
+    for (int j = 0; j < 3; j++) {
+        if (!(pos[j] >= root.lower[j] && pos[j] <= root.upper[j])) {
+            return false;
+        }
+    }
+
+    // Parity of crossings of each closed mesh along a ray, as a bit per
+    // ray, so that overlapping meshes do not cancel. Vote by majority 
+    // over 3 directions with no zero components, so that a ray 
+    // counting a crossing twice on a shared edge does not decide alone.
+    static const Vec3<Float> dirs[3] = {
+        {Float(+0.5773), Float(+0.5774), Float(+0.5775)},
+        {Float(-0.8017), Float(+0.2672), Float(+0.5345)},
+        {Float(+0.2673), Float(-0.5346), Float(-0.8018)}
+    };
+    std::uint8_t local_parities[64] = {};
+    std::vector<std::uint8_t> parities_storage;
+    std::uint8_t* parities = local_parities;
+    if (num_closed_meshes_ > 64) {
+        parities_storage.resize(num_closed_meshes_);
+        parities = parities_storage.data();
+    }
+    for (int r = 0; r < 3; r++) {
+        const Vec3<Float>& dir = dirs[r];
+        Float tmax = std::numeric_limits<Float>::infinity();
+        bvh_.intersectRay(pos, dir, 0, tmax, 
+        [&](std::uint32_t prim_pos, Float&) {
+            const Triangle& triangle = triangles_[prim_pos];
+            if (triangle.mesh != open_mesh &&
+                intersects(
+                    pos, dir, 
+                    triangle.v[0], triangle.v[1], triangle.v[2])) {
+                parities[triangle.mesh] ^= 1 << r;
+            }
+            return false;
+        });
+    }
+    for (std::uint32_t mesh = 0; mesh < num_closed_meshes_; mesh++) {
+        int bits = parities[mesh];
+        if ((bits & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) >= 2) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace ld
@@ -0,0 +1,147 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <leaf-disk-gen/leaf_flutter.hpp>
+#include <leaf-disk-gen/packed_leaf_disk.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+#include <leaf-disk-gen/trace.hpp>
+
+namespace ld {
+
+// Perturb normal.
+Vec3<Float> LeafFlutter::perturbNormal(
+            const Vec3<Float>& normal,
+            std::uint64_t leaf_index,
+            Float time) const
+{
+    // Phases and relative frequencies, 16 bits each.
+    std::uint64_t bits = hashCombine(seed_, leaf_index);
+    Float u[4];
+    for (int j = 0; j < 4; j++) {
+        u[j] = Float((bits >> (16 * j)) & 0xFFFF) / Float(65536);
+    }
+    Float two_pi = 2 * pre::numeric_constants<Float>::M_pi();
+    Float angle0 = amplitude_ * pre::sin(
+            two_pi * (frequency_ * (Float(0.75) + Float(0.5) * u[0]) * time 
+                                 + u[1]));
+    Float angle1 = amplitude_ * pre::sin(
+            two_pi * (frequency_ * (Float(0.75) + Float(0.5) * u[2]) * time
+                                 + u[3]));
+
+    // Tilt about tangential directions.
+    Mat3<Float> tbn = Mat3<Float>::build_onb(normal);
+    Vec3<Float> hatu = pre::transpose(tbn)[0];
+    Vec3<Float> hatv = pre::transpose(tbn)[1];
+    return 
+        pre::normalize_safe(
+            normal + 
+            pre::tan(angle0) * hatu + 
+            pre::tan(angle1) * hatv);
+}
+
+// Constructor.
+FlutterLeafWriter::FlutterLeafWriter(
+            std::unique_ptr<LeafWriter> writer,
+            const std::string& filename,
+            const LeafFlutter& flutter,
+            std::size_t num_frames,
+            Float frame_time,
+            unsigned int num_threads) :
+                writer_(std::move(writer)),
+                flutter_(flutter),
+                num_frames_(num_frames),
+                frame_time_(frame_time),
+                num_threads_(num_threads)
+{
+    ofs_.open(filename, std::ios::out | std::ios::binary);
+    if (!ofs_.is_open()) {
+        throw std::runtime_error(
+              std::string("can't open ").append(filename));
+    }
+}
+
+// Write.
+void FlutterLeafWriter::write(const LeafDisk& leaf_disk)
+{
+    writer_->write(leaf_disk);
+    normals_.push_back(LeafDiskPacker::encodeOctahedral(leaf_disk.normal));
+}
+
+// Finish.
+void FlutterLeafWriter::finish()
+{
+    writer_->finish();
+
+    // Write header, assuming little endian host.
+    std::uint32_t magic = 0x4C46444C; // "LDFL"
+    std::uint32_t version = 1;
+    std::uint64_t num_leaves = normals_.size();
+    std::uint64_t num_frames = num_frames_;
+    double frame_time = frame_time_;
+    ofs_.write(reinterpret_cast<const char*>(&magic), 4);
+    ofs_.write(reinterpret_cast<const char*>(&version), 4);
+    ofs_.write(reinterpret_cast<const char*>(&num_leaves), 8);
+    ofs_.write(reinterpret_cast<const char*>(&num_frames), 8);
+    ofs_.write(reinterpret_cast<const char*>(&frame_time), 8);
+
+    // Write frames.
+    std::vector<std::uint32_t> frame(normals_.size());
+    for (std::size_t f = 0; f < num_frames_; f++) {
+        TraceSpan span("flutter frame", f);
+        Float time = f * frame_time_;
+        parallelFor(normals_.size(), num_threads_,
+        [&](std::size_t begin, std::size_t end, unsigned int) {
+            for (std::size_t k = begin; k < end; k++) {
+                frame[k] = 
+                    LeafDiskPacker::encodeOctahedral(
+                    flutter_.perturbNormal(
+                        LeafDiskPacker::decodeOctahedral(normals_[k]),
+                        k, time));
+            }
+        });
+        ofs_.write(
+            reinterpret_cast<const char*>(frame.data()), 
+            frame.size() * sizeof(std::uint32_t));
+    }
+    ofs_.flush();
+    if (!ofs_) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": failed to write flutter file"));
+    }
+    std::vector<std::uint32_t>().swap(normals_);
+}
+
+// Check capacity.
+void FlutterLeafWriter::checkCapacity(std::uint64_t num_leaf_disks) const
+{
+    writer_->checkCapacity(num_leaf_disks);
+}
+
+} // namespace ld
@@ -0,0 +1,301 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+#include <preform/misc_string.hpp>
+#include <leaf-disk-gen/leaf_inventory.hpp>
+
+namespace ld {
+
+namespace {
+
+// Is blank?
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Split CSV line into fields, trimming blanks around each field, and 
+// unquoting double quoted fields.
+void splitCsv(const std::string& line, std::vector<std::string>& fields)
+{
+    fields.clear();
+    std::size_t pos = 0;
+    while (true) {
+        while (pos < line.size() && isBlank(line[pos])) {
+            pos++;
+        }
+        std::string field;
+        if (pos < line.size() && line[pos] == '"') {
+            // Quoted, where a doubled quote is a literal quote.
+            pos++;
+            while (pos < line.size()) {
+                if (line[pos] == '"') {
+                    if (pos + 1 < line.size() && line[pos + 1] == '"') {
+                        field += '"';
+                        pos += 2;
+                        continue;
+                    }
+                    pos++;
+                    break;
+                }
+                field += line[pos++];
+            }
+            while (pos < line.size() && line[pos] != ',') {
+                pos++;
+            }
+        }
+        else {
+            std::size_t end = line.find(',', pos);
+            if (end == std::string::npos) {
+                end = line.size();
+            }
+            field = line.substr(pos, end - pos);
+            while (!field.empty() && isBlank(field.back())) {
+                field.pop_back();
+            }
+            pos = end;
+        }
+        fields.push_back(std::move(field));
+        if (pos >= line.size()) {
+            break;
+        }
+        pos++; // Skip comma.
+    }
+}
+
+} // namespace
+
+// Load CSV.
+void LeafInventory::loadCsv(
+            const std::string& filename,
+            Float default_lai,
+            Float default_leaf_radius,
+            const std::string& default_angle_distribution)
+{
+    std::ifstream ifs(filename);
+    if (!ifs.is_open()) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't open ").append(filename));
+    }
+    std::size_t line_number = 0;
+    auto fail = [&, function = __PRETTY_FUNCTION__](
+                        const std::string& what) {
+        throw 
+            std::runtime_error(
+            std::string(function).append(": ").append(what)
+                .append(" on line ").append(std::to_string(line_number))
+                .append(" of ").append(filename));
+    };
+
+    // Columns, by index in the header, or -1 if missing.
+    enum Column {
+        eX,
+        eY,
+        eZ,
+        eShape,
+        eRadius,
+        eHeight,
+        eLai,
+        eLeafArea,
+        eLeafRadius,
+        eDistribution,
+        eNumColumns
+    };
+    static const char* column_names[eNumColumns] = {
+        "x", 
+        "y", 
+        "z", 
+        "shape", 
+        "radius", 
+        "height", 
+        "lai", 
+        "leaf_area", 
+        "leaf_radius", 
+        "distribution"
+    };
+    long columns[eNumColumns];
+    std::fill(columns, columns + eNumColumns, -1);
+    bool has_header = false;
+
+    std::string line;
+    std::vector<std::string> fields;
+    while (std::getline(ifs, line)) {
+        line_number++;
+        std::size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        splitCsv(line, fields);
+        if (!has_header) {
+            // Header, ignoring unknown columns, e.g., species.
+            for (std::size_t i = 0; i < fields.size(); i++) {
+                pre::ci_string ci_field = fields[i].c_str();
+                for (int column = 0; column < eNumColumns; column++) {
+                    if (ci_field == column_names[column]) {
+                        if (columns[column] != -1) {
+                            fail(std::string("duplicate column ")
+                                    .append(column_names[column]));
+                        }
+                        columns[column] = i;
+                    }
+                }
+            }
+            for (int column : {eX, eY, eZ, eShape, eRadius}) {
+                if (columns[column] == -1) {
+                    fail(std::string("missing column ")
+                            .append(column_names[column]));
+                }
+            }
+            has_header = true;
+            continue;
+        }
+
+        // Field, or empty if missing.
+        auto field = [&](int column) -> std::string {
+            if (columns[column] == -1 || 
+                columns[column] >= long(fields.size())) {
+                return std::string();
+            }
+            return fields[columns[column]];
+        };
+
+        // Number field, or false if empty.
+        auto number = [&](int column, Float& value) {
+            std::string str = field(column);
+            if (str.empty()) {
+                return false;
+            }
+            std::from_chars_result result = 
+                std::from_chars(str.data(), str.data() + str.size(), value);
+            if (result.ec != std::errc() || 
+                result.ptr != str.data() + str.size()) {
+                fail(std::string("malformed ").append(column_names[column]));
+            }
+            return true;
+        };
+
+        // Volume.
+        Vec3<Float> center;
+        for (int j = 0; j < 3; j++) {
+            if (!number(eX + j, center[j])) {
+                fail(std::string("missing ").append(column_names[eX + j]));
+            }
+        }
+        Float radius = 0;
+        if (!number(eRadius, radius) || !(radius > 0)) {
+            fail("missing or non-positive radius");
+        }
+        Float height = 0;
+        bool has_height = number(eHeight, height);
+        LeafCrown crown;
+        pre::ci_string ci_shape = field(eShape).c_str();
+        if (ci_shape != "sphere" && 
+            ci_shape != "ellipsoid" && 
+            ci_shape != "cone") {
+            fail("shape isn't sphere, ellipsoid, or cone");
+        }
+        if (ci_shape != "sphere" && !(has_height && height > 0)) {
+            fail("missing or non-positive height");
+        }
+        if (ci_shape == "sphere") {
+            crown.volume.reset(new SphereLeafVolume(center, radius));
+        }
+        else
+        if (ci_shape == "ellipsoid") {
+            crown.volume.reset(
+                new EllipsoidLeafVolume(
+                    center, Vec3<Float>{radius, radius, height / 2}));
+        }
+        else {
+            crown.volume.reset(
+                new ConeLeafVolume(
+                    center - Vec3<Float>{0, 0, height / 2}, 
+                    radius, height));
+        }
+
+        // Leaf area index, from leaf area over the crown footprint.
+        Float leaf_area = 0;
+        bool has_lai = number(eLai, crown.lai);
+        bool has_leaf_area = number(eLeafArea, leaf_area);
+        if (has_lai && has_leaf_area) {
+            fail("both lai and leaf_area");
+        }
+        if (has_leaf_area) {
+            crown.lai = leaf_area / crown.volume->groundArea();
+        }
+        else if (!has_lai) {
+            crown.lai = default_lai;
+        }
+        if (!(crown.lai >= 0)) {
+            fail("negative lai or leaf_area");
+        }
+
+        // Leaf radius.
+        if (!number(eLeafRadius, crown.leaf_radius)) {
+            crown.leaf_radius = default_leaf_radius;
+        }
+        if (!(crown.leaf_radius > 0)) {
+            fail("non-positive leaf_radius");
+        }
+
+        // Angle distribution, shared by crowns with the same string.
+        std::string angle_distribution = field(eDistribution);
+        if (angle_distribution.empty()) {
+            angle_distribution = default_angle_distribution;
+        }
+        auto itr = angle_distribution_indices_.find(angle_distribution);
+        if (itr == angle_distribution_indices_.end()) {
+            try {
+                angle_distributions_.push_back(
+                    LeafAngleDistribution::variantFromString(
+                            angle_distribution));
+            }
+            catch (const std::exception& exception) {
+                fail(std::string("malformed distribution (")
+                        .append(exception.what()).append(")"));
+            }
+            itr = 
+                angle_distribution_indices_.emplace(
+                    angle_distribution, 
+                    angle_distributions_.size() - 1).first;
+        }
+        crown.angle_distribution = itr->second;
+        crowns_.push_back(std::move(crown));
+    }
+    if (!has_header) {
+        fail("missing header");
+    }
+}
+
+} // namespace ld
@@ -0,0 +1,513 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <preform/misc_string.hpp>
+#include <leaf-disk-gen/leaf_merge.hpp>
+#include <leaf-disk-gen/leaf_reader.hpp>
+#include <leaf-disk-gen/mapped_file.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+#include <leaf-disk-gen/trace.hpp>
+
+namespace ld {
+
+namespace {
+
+// Bytes per thread per window.
+const std::size_t kChunkSize = std::size_t(16) << 20;
+
+// Is OBJ filename, otherwise GList, or throw.
+bool isObjOrThrow(const std::string& filename)
+{
+    pre::ci_string ci_filename = filename.c_str();
+    if (ci_filename.size() >= 4 &&
+        ci_filename.compare(ci_filename.size() - 4, 4, ".obj") == 0) {
+        return true;
+    }
+    if (ci_filename.size() >= 6 &&
+        ci_filename.compare(ci_filename.size() - 6, 6, ".glist") == 0) {
+        return false;
+    }
+    throw 
+        std::runtime_error(
+        std::string(filename)
+            .append(" must end with either \".glist\" or \".obj\""));
+}
+
+// Is digit?
+inline bool isDigit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+// Skip past next newline, or to end.
+inline const char* skipLine(const char* pos, const char* end)
+{
+    const char* newline = 
+        static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+    return newline ? newline + 1 : end;
+}
+
+// Starts with OBJ keyword, being followed by a space or tab?
+inline bool startsWithKeyword(
+            const char* pos, const char* end, std::string_view keyword)
+{
+    return std::size_t(end - pos) > keyword.size() &&
+           std::memcmp(pos, keyword.data(), keyword.size()) == 0 &&
+           (pos[keyword.size()] == ' ' || pos[keyword.size()] == '\t');
+}
+
+// Copy OBJ lines, offsetting absolute face indices by delta, and 
+// counting vertices. Vertex and other lines are copied in runs. Return
+// false if an offset index is out of range.
+bool rebaseObjLines(
+            const char* begin, 
+            const char* end, 
+            std::int64_t delta, 
+            std::string& bytes,
+            std::uint64_t& num_vers)
+{
+    const char* run = begin;
+    const char* pos = begin;
+    while (pos < end) {
+        const char* next = skipLine(pos, end);
+        if (startsWithKeyword(pos, end, "v")) {
+            num_vers++;
+        }
+        else
+        if (startsWithKeyword(pos, end, "f") && delta != 0) {
+            bytes.append(run, pos);
+            run = pos;
+            for (const char* itr = pos + 1; itr < next;) {
+                if (isDigit(*itr) && (itr[-1] == ' ' || itr[-1] == '\t')) {
+                    bytes.append(run, itr);
+                    std::int64_t index = 0;
+                    for (; itr < next && isDigit(*itr); itr++) {
+                        index = index * 10 + (*itr - '0');
+                    }
+                    index += delta;
+                    if (!(index >= 1)) {
+                        return false;
+                    }
+                    char buffer[24];
+                    bytes.append(
+                        buffer, std::to_chars(buffer, buffer + 24, index).ptr);
+                    run = itr;
+                }
+                else {
+                    itr++;
+                }
+            }
+        }
+        pos = next;
+    }
+    bytes.append(run, end);
+    return true;
+}
+
+// Face index of OBJ record's center, being the first index of its 
+// first face, or zero if relative.
+std::int64_t centerIndex(const char* begin, const char* end)
+{
+    for (const char* pos = begin; pos < end; pos = skipLine(pos, end)) {
+        if (startsWithKeyword(pos, end, "f")) {
+            pos += 1;
+            while (pos < end && (*pos == ' ' || *pos == '\t')) {
+                pos++;
+            }
+            std::int64_t index = 0;
+            for (; pos < end && isDigit(*pos); pos++) {
+                index = index * 10 + (*pos - '0');
+            }
+            return index;
+        }
+    }
+    return 0;
+}
+
+// Update current header from text between records. For GList, this is
+// the last object header, from its object tag through its base 
+// geometry. For OBJ, this is the last material line.
+void updateHeader(
+            const char* begin, 
+            const char* end, 
+            bool is_obj,
+            std::string_view& header)
+{
+    std::string_view text(begin, end - begin);
+    if (is_obj) {
+        for (const char* pos = begin; pos < end; pos = skipLine(pos, end)) {
+            if (startsWithKeyword(pos, end, "usemtl")) {
+                header = std::string_view(pos, skipLine(pos, end) - pos);
+            }
+        }
+    }
+    else {
+        std::size_t object = text.rfind("<object>");
+        if (object != std::string_view::npos) {
+            std::size_t base_end = text.find("</basegeometry>", object);
+            if (base_end == std::string_view::npos) {
+                throw std::runtime_error("malformed GList object header");
+            }
+            const char* header_end = 
+                skipLine(begin + base_end, end);
+            header = std::string_view(
+                     begin + object, header_end - (begin + object));
+        }
+    }
+}
+
+// Part filename, with part name appended before the extension.
+std::string partFilename(
+            const std::string& filename, 
+            const std::string& name,
+            bool is_obj)
+{
+    std::size_t ext_size = is_obj ? 4 : 6;
+    return filename.substr(0, filename.size() - ext_size)
+                .append("_").append(name)
+                .append(filename.substr(filename.size() - ext_size));
+}
+
+// Write bytes, or throw.
+void writeOrThrow(
+            std::ofstream& ofs, 
+            const char* bytes, 
+            std::size_t size,
+            const std::string& filename)
+{
+    if (!ofs.write(bytes, size)) {
+        throw std::runtime_error(
+              std::string("can't write ").append(filename));
+    }
+}
+
+// Merge OBJ input, rewriting face indices in parallel chunks of lines.
+void mergeObj(
+            const MappedFile& file,
+            const std::string& filename,
+            std::uint64_t& num_vers,
+            std::ofstream& ofs,
+            const std::string& ofs_filename,
+            unsigned int num_threads)
+{
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+    std::vector<const char*> chunk_bounds(num_threads + 1);
+    std::vector<std::string> chunks(num_threads);
+    std::vector<std::uint64_t> chunk_num_vers(num_threads);
+    std::vector<char> chunk_failed(num_threads);
+    const std::int64_t delta = num_vers;
+    const char* window_begin = begin;
+    while (window_begin < end) {
+        std::size_t window_size = 
+            std::min<std::size_t>(end - window_begin, 
+                                  kChunkSize * num_threads);
+        const char* window_end = 
+            skipLine(window_begin + window_size - 1, end);
+
+        // Chunks, split at line boundaries.
+        chunk_bounds[0] = window_begin;
+        chunk_bounds[num_threads] = window_end;
+        for (unsigned int t = 1; t < num_threads; t++) {
+            chunk_bounds[t] = 
+                std::max(chunk_bounds[t - 1],
+                skipLine(window_begin + 
+                         (window_end - window_begin) * t / num_threads - 1,
+                         window_end));
+        }
+
+        // Rewrite in parallel.
+        parallelFor(num_threads, num_threads, 
+        [&](std::size_t begin, std::size_t end, unsigned int) {
+            for (std::size_t t = begin; t < end; t++) {
+                TraceSpan span("rewrite chunk", t);
+                chunks[t].clear();
+                chunk_num_vers[t] = 0;
+                chunk_failed[t] = 
+                    !rebaseObjLines(
+                        chunk_bounds[t], chunk_bounds[t + 1], delta, 
+                        chunks[t], chunk_num_vers[t]);
+            }
+        });
+
+        // Write in order.
+        TraceSpan span("write");
+        for (unsigned int t = 0; t < num_threads; t++) {
+            if (chunk_failed[t]) {
+                throw std::runtime_error(
+                      std::string("malformed faces in ").append(filename));
+            }
+            writeOrThrow(
+                ofs, chunks[t].data(), chunks[t].size(), ofs_filename);
+            num_vers += chunk_num_vers[t];
+        }
+        file.release(window_begin, window_end);
+        window_begin = window_end;
+    }
+}
+
+// Merge GList input, streaming its objects.
+void mergeGList(
+            const MappedFile& file,
+            const std::string& filename,
+            std::ofstream& ofs,
+            const std::string& ofs_filename)
+{
+    std::string_view text(file.data(), file.size());
+    if (text.substr(0, 4096).find("<glist>") != std::string_view::npos) {
+        throw 
+            std::runtime_error(
+            std::string("can't merge tiled output ").append(filename)
+                .append(", merge its tile instead"));
+    }
+    std::size_t body_begin = text.find("<geometrylist");
+    std::size_t body_end = text.rfind("</geometrylist>");
+    if (body_begin != std::string_view::npos) {
+        body_begin = text.find('>', body_begin);
+    }
+    if (body_begin == std::string_view::npos ||
+        body_end == std::string_view::npos ||
+        body_end <= body_begin) {
+        throw std::runtime_error(
+              std::string("malformed GList ").append(filename));
+    }
+    body_begin = 
+        skipLine(file.data() + body_begin, file.data() + body_end) - 
+        file.data();
+
+    // Stream in windows, releasing each once written.
+    const std::size_t window_size = std::size_t(64) << 20;
+    for (std::size_t pos = body_begin; pos < body_end; pos += window_size) {
+        std::size_t size = std::min(window_size, body_end - pos);
+        TraceSpan span("stream");
+        writeOrThrow(ofs, file.data() + pos, size, ofs_filename);
+        file.release(file.data() + pos, file.data() + pos + size);
+    }
+}
+
+// Split part.
+struct SplitPart
+{
+    // Filename.
+    std::string filename;
+
+    // Buffered bytes.
+    std::string bytes;
+
+    // Current header.
+    std::string_view header;
+
+    // Has been created?
+    bool is_created = false;
+
+    // Has open object, if GList?
+    bool has_object = false;
+
+    // Number of vertices, if OBJ.
+    std::uint64_t num_vers = 0;
+
+    // Flush, creating file if necessary.
+    void flush()
+    {
+        std::ofstream ofs(
+                filename, 
+                is_created ? 
+                std::ios::out | std::ios::binary | std::ios::app : 
+                std::ios::out | std::ios::binary);
+        if (!ofs.is_open()) {
+            throw std::runtime_error(
+                  std::string("can't open ").append(filename));
+        }
+        writeOrThrow(ofs, bytes.data(), bytes.size(), filename);
+        bytes.clear();
+        is_created = true;
+    }
+};
+
+} // namespace
+
+// Merge leaf outputs.
+void mergeLeafOutputs(
+            const std::vector<std::string>& filenames,
+            const std::string& filename,
+            unsigned int num_threads)
+{
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+    bool is_obj = isObjOrThrow(filename);
+    for (const std::string& input_filename : filenames) {
+        if (isObjOrThrow(input_filename) != is_obj) {
+            throw 
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": inputs must have the same format as ")
+                    .append("the output"));
+        }
+    }
+    std::ofstream ofs(filename, std::ios::out | std::ios::binary);
+    if (!ofs.is_open()) {
+        throw std::runtime_error(
+              std::string("can't open ").append(filename));
+    }
+    if (is_obj) {
+        std::uint64_t num_vers = 0;
+        for (const std::string& input_filename : filenames) {
+            MappedFile file(input_filename);
+            mergeObj(file, input_filename, num_vers, 
+                     ofs, filename, num_threads);
+        }
+    }
+    else {
+        ofs << "<geometrylist enabled=\"true\">\n";
+        for (const std::string& input_filename : filenames) {
+            MappedFile file(input_filename);
+            mergeGList(file, input_filename, ofs, filename);
+        }
+        ofs << "</geometrylist>\n";
+    }
+    ofs.flush();
+    if (!ofs) {
+        throw std::runtime_error(
+              std::string("can't write ").append(filename));
+    }
+}
+
+// Split leaf output.
+std::size_t splitLeafOutput(
+            const std::string& filename,
+            const std::string& part_filename,
+            const LeafSplitOptions& options,
+            unsigned int num_threads)
+{
+    if ((options.count > 0) == (options.cell_size > 0)) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": expects exactly one of count or cell size"));
+    }
+    LeafReader reader(filename);
+    bool is_obj = reader.isObj();
+    if (isObjOrThrow(part_filename) != is_obj) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": parts must have the same format as the input"));
+    }
+
+    // Parts by name, flushed as they fill.
+    const std::size_t flush_size = std::size_t(64) << 10;
+    std::map<std::string, SplitPart> parts;
+    std::string_view header;
+    const char* prev_end = reader.data();
+    std::uint64_t leaf_index = 0;
+    reader.readRecords(
+    [&](const LeafDisk& leaf_disk, const char* begin, const char* end) {
+
+        // Header in effect.
+        if (begin != prev_end) {
+            updateHeader(prev_end, begin, is_obj, header);
+        }
+        prev_end = end;
+
+        // Part.
+        std::string name;
+        if (options.count > 0) {
+            name = std::to_string(leaf_index / options.count);
+        }
+        else {
+            name = std::to_string(
+                   std::llround(
+                   std::floor(leaf_disk.pos[0] / options.cell_size)))
+                       .append("_").append(std::to_string(
+                   std::llround(
+                   std::floor(leaf_disk.pos[1] / options.cell_size))));
+        }
+        leaf_index++;
+        SplitPart& part = parts[name];
+        if (part.filename.empty()) {
+            part.filename = partFilename(part_filename, name, is_obj);
+            if (!is_obj) {
+                part.bytes = "<geometrylist enabled=\"true\">\n";
+            }
+        }
+
+        // Header, if changed.
+        if (part.header != header) {
+            if (part.has_object) {
+                part.bytes += "</object>\n";
+            }
+            part.bytes += header;
+            part.header = header;
+            part.has_object = !is_obj;
+        }
+
+        // Record.
+        if (is_obj) {
+            std::int64_t center_index = centerIndex(begin, end);
+            std::int64_t delta = 
+                center_index > 0 ? 
+                std::int64_t(part.num_vers) + 1 - center_index : 0;
+            if (!rebaseObjLines(
+                    begin, end, delta, part.bytes, part.num_vers)) {
+                throw std::runtime_error(
+                      std::string("malformed faces in ").append(filename));
+            }
+        }
+        else {
+            part.bytes.append(begin, end);
+        }
+        if (part.bytes.size() >= flush_size) {
+            part.flush();
+        }
+    },
+    num_threads);
+
+    // Finish.
+    for (auto& entry : parts) {
+        SplitPart& part = entry.second;
+        if (part.has_object) {
+            part.bytes += "</object>\n";
+        }
+        if (!is_obj) {
+            part.bytes += "</geometrylist>\n";
+        }
+        part.flush();
+    }
+    return parts.size();
+}
+
+} // namespace ld
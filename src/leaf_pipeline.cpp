@@ -0,0 +1,211 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <exception>
+#include <string>
+#include <leaf-disk-gen/leaf_pipeline.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+#include <leaf-disk-gen/trace.hpp>
+
+namespace ld {
+
+namespace {
+
+// Leaf batch.
+struct LeafBatch
+{
+    std::size_t index = 0;
+    std::vector<LeafDisk> leaf_disks;
+    std::string bytes;
+};
+
+} // namespace
+
+// Run leaf pipeline.
+void runLeafPipeline(
+            const std::vector<std::size_t>& batch_sizes,
+            const LeafPipelineSampleFunc& sample,
+            LeafWriter& writer,
+            const LeafPipelineObserveFunc& observe,
+            unsigned int num_threads)
+{
+    std::size_t num_batches = batch_sizes.size();
+    std::vector<std::size_t> batch_first(num_batches + 1, 0);
+    for (std::size_t b = 0; b < num_batches; b++) {
+        batch_first[b + 1] = batch_first[b] + batch_sizes[b];
+    }
+
+    // Workers, leaving the calling thread to write.
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+    unsigned int num_workers = std::max(num_threads, 2u) - 1;
+    num_workers = std::min<std::size_t>(
+                  num_workers, std::max<std::size_t>(num_batches, 1));
+
+    // Window of batches in flight.
+    std::size_t window = 4 * std::size_t(num_workers);
+    bool is_formattable = writer.isFormattable();
+    BoundedQueue<std::unique_ptr<LeafBatch>> queue(window);
+    std::atomic<std::size_t> next_batch = {0};
+    std::atomic<std::size_t> num_written = {0};
+    std::atomic<bool> is_aborted = {false};
+    Notifier notifier;
+    auto abort = [&]() {
+        is_aborted.store(true);
+        notifier.notify();
+    };
+    std::vector<std::exception_ptr> exceptions(num_workers);
+    std::vector<std::thread> workers;
+    workers.reserve(num_workers);
+    for (unsigned int t = 0; t < num_workers; t++) {
+        workers.emplace_back([&, t]() {
+            try {
+                for (;;) {
+                    std::size_t b = next_batch.fetch_add(1);
+                    if (b >= num_batches) {
+                        break;
+                    }
+
+                    // Wait until batch is within window.
+                    if (b >= num_written.load(
+                                std::memory_order_acquire) + window) {
+                        TraceSpan span("wait for window", b);
+                        notifier.wait([&]() {
+                            return is_aborted.load() ||
+                                   b < num_written.load(
+                                       std::memory_order_acquire) + window;
+                        });
+                        if (is_aborted.load()) {
+                            return;
+                        }
+                    }
+
+                    // Sample and format.
+                    std::unique_ptr<LeafBatch> batch(new LeafBatch);
+                    batch->index = b;
+                    batch->leaf_disks.resize(batch_sizes[b]);
+                    {
+                        TraceSpan span("sample", b);
+                        sample(b, 
+                               batch->leaf_disks.data(), 
+                               batch->leaf_disks.size());
+                    }
+                    if (is_formattable) {
+                        TraceSpan span("format", b);
+                        writer.format(
+                            batch->leaf_disks.data(), 
+                            batch->leaf_disks.size(),
+                            batch_first[b], 
+                            batch->bytes);
+                    }
+
+                    // Push.
+                    if (!queue.tryPush(std::move(batch))) {
+                        TraceSpan span("wait for queue", b);
+                        bool is_pushed = false;
+                        notifier.wait([&]() {
+                            return is_aborted.load() ||
+                                   (is_pushed = 
+                                    queue.tryPush(std::move(batch)));
+                        });
+                        if (!is_pushed) {
+                            return;
+                        }
+                    }
+                    notifier.notify();
+                }
+            }
+            catch (...) {
+                exceptions[t] = std::current_exception();
+                abort();
+            }
+        });
+    }
+    auto join = [&]() {
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    };
+
+    // Write in batch order. Batches in flight are always within the 
+    // window past the next batch to write, so each has its own slot.
+    try {
+        std::vector<std::unique_ptr<LeafBatch>> pending(window);
+        std::size_t b = 0;
+        while (b < num_batches && !is_aborted.load()) {
+            std::unique_ptr<LeafBatch> batch;
+            if (!queue.tryPop(batch)) {
+                TraceSpan span("wait for batch", b);
+                notifier.wait([&]() {
+                    return is_aborted.load() || queue.tryPop(batch);
+                });
+                if (!batch) {
+                    continue;
+                }
+            }
+            notifier.notify();
+            pending[batch->index % window] = std::move(batch);
+            while (b < num_batches && pending[b % window]) {
+                std::unique_ptr<LeafBatch> ready = 
+                    std::move(pending[b % window]);
+                TraceSpan span("write", b);
+                if (is_formattable) {
+                    writer.writeFormatted(
+                            ready->bytes, 
+                            ready->leaf_disks.size());
+                }
+                else {
+                    for (const LeafDisk& leaf_disk : ready->leaf_disks) {
+                        writer.write(leaf_disk);
+                    }
+                }
+                if (observe) {
+                    for (const LeafDisk& leaf_disk : ready->leaf_disks) {
+                        observe(leaf_disk);
+                    }
+                }
+                num_written.store(++b, std::memory_order_release);
+                notifier.notify();
+            }
+        }
+    }
+    catch (...) {
+        abort();
+        join();
+        throw;
+    }
+    join();
+    for (const std::exception_ptr& exception : exceptions) {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+}
+
+} // namespace ld
@@ -0,0 +1,74 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <leaf-disk-gen/leaf_ray_caster.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+
+namespace ld {
+
+// Build.
+void LeafRayCaster::build(
+            const std::vector<LeafDisk>& leaf_disks, 
+            unsigned int num_threads)
+{
+    // Exact disk bounds, extending radius * sqrt(1 - n_j^2) along
+    // each axis.
+    std::vector<pre::aabb3<Float>> prim_bounds(leaf_disks.size());
+    parallelFor(leaf_disks.size(), num_threads,
+    [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t k = begin; k < end; k++) {
+            const LeafDisk& leaf_disk = leaf_disks[k];
+            Vec3<Float> ext;
+            for (int j = 0; j < 3; j++) {
+                ext[j] = leaf_disk.radius * 
+                    pre::sqrt(std::max(Float(0), 
+                        1 - leaf_disk.normal[j] * leaf_disk.normal[j]));
+            }
+            prim_bounds[k] = {
+                leaf_disk.pos - ext,
+                leaf_disk.pos + ext
+            };
+        }
+    });
+    bvh_.build(prim_bounds, num_threads);
+
+    // Reorder disks for locality.
+    const std::vector<std::uint32_t>& prim_indices = bvh_.primIndices();
+    disks_.resize(prim_indices.size());
+    parallelFor(prim_indices.size(), num_threads,
+    [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t pos = begin; pos < end; pos++) {
+            const LeafDisk& leaf_disk = leaf_disks[prim_indices[pos]];
+            disks_[pos].pos = leaf_disk.pos;
+            disks_[pos].normal = leaf_disk.normal;
+            disks_[pos].radius2 = leaf_disk.radius * leaf_disk.radius;
+        }
+    });
+}
+
+} // namespace ld
@@ -0,0 +1,523 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string_view>
+#include <preform/misc_string.hpp>
+#include <leaf-disk-gen/leaf_reader.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+#include <leaf-disk-gen/trace.hpp>
+
+namespace ld {
+
+namespace {
+
+// GList record tag.
+const std::string_view kStaticInstance = "<staticinstance>";
+
+// GList matrix tag.
+const std::string_view kMatrix = "<matrix>";
+
+// Powers of 10 exactly representable in double precision.
+const double kPow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+    1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+    1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Powers of 10 up to 8, as integers.
+const std::uint64_t kPow10Int[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+// Is digit?
+inline bool isDigit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+// Skip spaces and tabs.
+inline const char* skipSpace(const char* pos, const char* end)
+{
+    while (pos < end && (*pos == ' ' || *pos == '\t')) {
+        pos++;
+    }
+    return pos;
+}
+
+// Skip past next newline, or to end.
+inline const char* skipLine(const char* pos, const char* end)
+{
+    const char* newline = 
+        static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+    return newline ? newline + 1 : end;
+}
+
+// Is OBJ vertex line?
+inline bool isVertexLine(const char* pos, const char* end)
+{
+    return end - pos >= 2 && pos[0] == 'v' && 
+           (pos[1] == ' ' || pos[1] == '\t');
+}
+
+// Is OBJ face line?
+inline bool isFaceLine(const char* pos, const char* end)
+{
+    return end - pos >= 2 && pos[0] == 'f' && 
+           (pos[1] == ' ' || pos[1] == '\t');
+}
+
+// Count leading digits of 8 bytes, loaded little endian. A byte is a
+// digit if its high nibble is 3 both before and after adding 6. Adding 
+// 6 may carry out of a non-digit byte, but only into bytes after it.
+inline int countDigits8(std::uint64_t chunk)
+{
+    const std::uint64_t high = 0xF0F0F0F0F0F0F0F0ULL;
+    const std::uint64_t threes = 0x3030303030303030ULL;
+    std::uint64_t non_digits = 
+        ((chunk & high) ^ threes) | 
+        (((chunk + 0x0606060606060606ULL) & high) ^ threes);
+    return non_digits == 0 ? 8 : __builtin_ctzll(non_digits) / 8;
+}
+
+// Convert leading digits of 8 bytes, loaded little endian. Shifting 
+// the digits to the top pads them with leading zeros, then pairs, 
+// quads, and octets are combined with multiplies.
+inline std::uint64_t convertDigits8(std::uint64_t chunk, int num_digits)
+{
+    if (num_digits == 0) {
+        return 0;
+    }
+    chunk -= 0x3030303030303030ULL;
+    chunk <<= 8 * (8 - num_digits);
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFULL) * 
+                (100 + (1000000ULL << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FFULL) * 
+                (1 + (10000ULL << 32)))) >> 32;
+    return chunk;
+}
+
+// Load 8 bytes.
+inline std::uint64_t load8(const char* pos)
+{
+    std::uint64_t chunk;
+    std::memcpy(&chunk, pos, 8);
+    return chunk;
+}
+
+// Parse float, or return nullptr. Accumulates up to 19 significant 
+// digits in an integer, then scales by an exact power of 10 where 
+// possible, which is correctly rounded for the short decimals written 
+// by streams, and otherwise falls back to std::pow. Up to 15 digits, 
+// with fewer than 8 before the point and no exponent, take a fast path 
+// converting 8 bytes at a time, with the same result.
+inline const char* parseFloat(
+            const char* pos, const char* end, double& value)
+{
+    bool negative = false;
+    if (pos < end && (*pos == '-' || *pos == '+')) {
+        negative = *pos == '-';
+        pos++;
+    }
+    if (end - pos >= 32) {
+        std::uint64_t chunk = load8(pos);
+        int num_int_digits = countDigits8(chunk);
+        int num_frac_digits = 0;
+        std::uint64_t mantissa = convertDigits8(chunk, num_int_digits);
+        const char* next = pos + num_int_digits;
+        if (*next == '.') {
+            chunk = load8(next + 1);
+            num_frac_digits = countDigits8(chunk);
+            mantissa = mantissa * kPow10Int[num_frac_digits] + 
+                       convertDigits8(chunk, num_frac_digits);
+            if (num_frac_digits == 8) {
+                chunk = load8(next + 9);
+                int num_digits = countDigits8(chunk);
+                mantissa = mantissa * kPow10Int[num_digits] + 
+                           convertDigits8(chunk, num_digits);
+                num_frac_digits += num_digits;
+            }
+            next += 1 + num_frac_digits;
+        }
+        if (num_int_digits < 8 && 
+            num_int_digits + num_frac_digits > 0 && 
+            num_int_digits + num_frac_digits <= 15 && 
+            *next != 'e' && *next != 'E') {
+            double result = double(mantissa) / kPow10[num_frac_digits];
+            value = negative ? -result : result;
+            return next;
+        }
+    }
+    std::uint64_t mantissa = 0;
+    int exponent = 0;
+    int num_digits = 0;
+    bool any_digits = false;
+    for (; pos < end && isDigit(*pos); pos++) {
+        any_digits = true;
+        if (num_digits < 19) {
+            mantissa = mantissa * 10 + (*pos - '0');
+            num_digits += mantissa != 0;
+        }
+        else {
+            exponent++;
+        }
+    }
+    if (pos < end && *pos == '.') {
+        for (pos++; pos < end && isDigit(*pos); pos++) {
+            any_digits = true;
+            if (num_digits < 19) {
+                mantissa = mantissa * 10 + (*pos - '0');
+                num_digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!any_digits) {
+        return nullptr;
+    }
+    if (pos < end && (*pos == 'e' || *pos == 'E')) {
+        pos++;
+        bool exponent_negative = false;
+        if (pos < end && (*pos == '-' || *pos == '+')) {
+            exponent_negative = *pos == '-';
+            pos++;
+        }
+        if (!(pos < end && isDigit(*pos))) {
+            return nullptr;
+        }
+        int exponent_digits = 0;
+        for (; pos < end && isDigit(*pos); pos++) {
+            if (exponent_digits < 10000) {
+                exponent_digits = exponent_digits * 10 + (*pos - '0');
+            }
+        }
+        exponent += exponent_negative ? -exponent_digits : exponent_digits;
+    }
+    double result = double(mantissa);
+    if (mantissa < (std::uint64_t(1) << 53) && 
+            exponent >= -22 && exponent <= 22) {
+        result = exponent < 0 ? 
+                 result / kPow10[-exponent] : 
+                 result * kPow10[exponent];
+    }
+    else if (mantissa != 0) {
+        result *= std::pow(10.0, exponent);
+    }
+    value = negative ? -result : result;
+    return pos;
+}
+
+} // namespace
+
+// Constructor.
+LeafReader::LeafReader(const std::string& filename) : 
+            filename_(filename),
+            file_(filename)
+{
+    pre::ci_string ci_filename = filename.c_str();
+    auto hasExtension = [&](const char* ext) {
+        std::size_t len = std::strlen(ext);
+        return ci_filename.size() >= len &&
+               ci_filename.compare(ci_filename.size() - len, len, ext) == 0;
+    };
+    if (hasExtension(".obj")) {
+        is_obj_ = true;
+    }
+    else
+    if (!hasExtension(".glist")) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": filename must end with either ")
+                .append("\".glist\" or \".obj\""));
+    }
+
+    // Tiled instancing output references its tile by filename, so its
+    // instances are tiles rather than leaves.
+    if (!is_obj_) {
+        std::string_view head(
+                file_.data(), std::min<std::size_t>(file_.size(), 4096));
+        if (head.find("<glist>") != std::string_view::npos) {
+            throw 
+                std::runtime_error(
+                std::string("can't read tiled output ").append(filename)
+                    .append(", read its tile instead"));
+        }
+    }
+}
+
+// Read.
+void LeafReader::read(const LeafReaderFunc& func, unsigned int num_threads)
+{
+    readRecords(
+    [&](const LeafDisk& leaf_disk, const char*, const char*) {
+        func(leaf_disk);
+    },
+    num_threads);
+}
+
+// Read records.
+void LeafReader::readRecords(
+            const LeafReaderRecordFunc& func, 
+            unsigned int num_threads)
+{
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+
+    // Windows of a fixed number of bytes per thread.
+    const std::size_t chunk_size = std::size_t(16) << 20;
+    const char* end = file_.data() + file_.size();
+    const char* window_begin = findRecord(file_.data());
+    std::vector<const char*> chunk_bounds(num_threads + 1);
+    std::vector<std::vector<Record>> chunks(num_threads);
+    std::vector<std::exception_ptr> exceptions(num_threads);
+    while (window_begin < end) {
+        std::size_t window_size = 
+            std::min<std::size_t>(end - window_begin, 
+                                  chunk_size * num_threads);
+        const char* window_end = findRecord(window_begin + window_size);
+
+        // Chunks, split at record boundaries.
+        chunk_bounds[0] = window_begin;
+        chunk_bounds[num_threads] = window_end;
+        for (unsigned int t = 1; t < num_threads; t++) {
+            chunk_bounds[t] = 
+                findRecord(window_begin + 
+                           (window_end - window_begin) * t / num_threads);
+        }
+
+        // Parse in parallel.
+        parallelFor(num_threads, num_threads, 
+        [&](std::size_t begin, std::size_t end, unsigned int) {
+            for (std::size_t t = begin; t < end; t++) {
+                try {
+                    TraceSpan span("parse chunk", t);
+                    chunks[t].clear();
+                    parseRange(chunk_bounds[t], chunk_bounds[t + 1], 
+                               chunks[t]);
+                }
+                catch (...) {
+                    exceptions[t] = std::current_exception();
+                }
+            }
+        });
+        for (const std::exception_ptr& exception : exceptions) {
+            if (exception) {
+                std::rethrow_exception(exception);
+            }
+        }
+
+        // Pass on in file order.
+        TraceSpan span("deliver");
+        for (const std::vector<Record>& chunk : chunks) {
+            for (const Record& record : chunk) {
+                func(record.leaf_disk, record.begin, record.end);
+            }
+        }
+
+        // Release pages of window, except for the last, which the next
+        // window begins in.
+        file_.release(window_begin, window_end);
+        window_begin = window_end;
+    }
+}
+
+// Find first record beginning at or after position.
+const char* LeafReader::findRecord(const char* pos) const
+{
+    const char* begin = file_.data();
+    const char* end = begin + file_.size();
+    if (pos >= end) {
+        return end;
+    }
+    if (!is_obj_) {
+        std::string_view rest(pos, end - pos);
+        std::size_t offset = rest.find(kStaticInstance);
+        return offset == std::string_view::npos ? end : pos + offset;
+    }
+
+    // Records begin with a vertex line not preceded by a vertex line, 
+    // so first move to a line start, then look at the previous line.
+    if (pos != begin && pos[-1] != '\n') {
+        pos = skipLine(pos, end);
+    }
+    bool prev_is_vertex = false;
+    if (pos != begin) {
+        const char* prev = pos - 1;
+        while (prev != begin && prev[-1] != '\n') {
+            prev--;
+        }
+        prev_is_vertex = isVertexLine(prev, pos);
+    }
+    while (pos < end) {
+        bool is_vertex = isVertexLine(pos, end);
+        if (is_vertex && !prev_is_vertex) {
+            return pos;
+        }
+        prev_is_vertex = is_vertex;
+        pos = skipLine(pos, end);
+    }
+    return end;
+}
+
+// Parse records beginning in range.
+void LeafReader::parseRange(
+            const char* begin, 
+            const char* end, 
+            std::vector<Record>& records) const
+{
+    const char* pos = begin;
+    while (pos < end) {
+        Record record;
+        const char* next = 
+            is_obj_ ? 
+            parseObj(pos, record.leaf_disk) : 
+            parseGList(pos, record.leaf_disk);
+        if (!next) {
+            throw 
+                std::runtime_error(
+                std::string("malformed record at byte ")
+                    .append(std::to_string(pos - file_.data()))
+                    .append(" of ").append(filename_));
+        }
+
+        // GList records end with their line.
+        if (!is_obj_) {
+            next = skipLine(next, file_.data() + file_.size());
+        }
+        record.begin = pos;
+        record.end = next;
+        records.push_back(record);
+        pos = findRecord(next);
+    }
+}
+
+// Parse GList record.
+const char* LeafReader::parseGList(
+            const char* pos, LeafDisk& leaf_disk) const
+{
+    const char* end = file_.data() + file_.size();
+    pos += kStaticInstance.size();
+    if (!(std::size_t(end - pos) >= kMatrix.size() &&
+          std::memcmp(pos, kMatrix.data(), kMatrix.size()) == 0)) {
+        return nullptr;
+    }
+    pos += kMatrix.size();
+
+    // First 3 rows, each being the scaled TBN row then the position.
+    double values[12];
+    for (double& value : values) {
+        pos = parseFloat(skipSpace(pos, end), end, value);
+        if (!pos) {
+            return nullptr;
+        }
+        pos = skipSpace(pos, end);
+        if (!(pos < end && *pos == ',')) {
+            return nullptr;
+        }
+        pos++;
+    }
+    Vec3<Float> axis = {values[2], values[6], values[10]};
+    Float radius = pre::sqrt(pre::dot(axis, axis));
+    if (!(radius > 0)) {
+        return nullptr;
+    }
+    leaf_disk.pos = {values[3], values[7], values[11]};
+    leaf_disk.normal = axis / radius;
+    leaf_disk.radius = radius;
+    return pos;
+}
+
+// Parse OBJ record.
+const char* LeafReader::parseObj(
+            const char* pos, LeafDisk& leaf_disk) const
+{
+    const char* end = file_.data() + file_.size();
+
+    // Vertices, the center then the perimeter, accumulating the fan 
+    // area vector relative to the center.
+    int num_vers = 0;
+    Vec3<Float> center = {};
+    Vec3<Float> first = {};
+    Vec3<Float> prev = {};
+    Vec3<Float> area = {};
+    while (isVertexLine(pos, end)) {
+        pos += 2;
+        Vec3<Float> ver;
+        for (int j = 0; j < 3; j++) {
+            pos = parseFloat(skipSpace(pos, end), end, ver[j]);
+            if (!pos) {
+                return nullptr;
+            }
+        }
+        pos = skipLine(pos, end);
+        if (num_vers == 0) {
+            center = ver;
+        }
+        else {
+            ver -= center;
+            if (num_vers == 1) {
+                first = ver;
+            }
+            else {
+                area += pre::cross(prev, ver);
+            }
+            prev = ver;
+        }
+        num_vers++;
+    }
+    area += pre::cross(prev, first);
+
+    // Faces, one per perimeter vertex.
+    int num_faces = 0;
+    while (isFaceLine(pos, end)) {
+        pos = skipLine(pos, end);
+        num_faces++;
+    }
+    if (!(num_vers >= 4 && num_faces == num_vers - 1)) {
+        return nullptr;
+    }
+
+    // The fan preserves area, so its area is that of the disk.
+    Float area_len = pre::sqrt(pre::dot(area, area));
+    if (!(area_len > 0)) {
+        return nullptr;
+    }
+    leaf_disk.pos = center;
+    leaf_disk.normal = area / area_len;
+    leaf_disk.radius = 
+        pre::sqrt(area_len / (2 * pre::numeric_constants<Float>::M_pi()));
+    return pos;
+}
+
+} // namespace ld
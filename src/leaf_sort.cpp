@@ -0,0 +1,420 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <array>
+#include <cstring>
+#include <queue>
+#include <leaf-disk-gen/leaf_sort.hpp>
+#include <leaf-disk-gen/parallel.hpp>
+#include <leaf-disk-gen/trace.hpp>
+
+namespace ld {
+
+// Parallel radix sort.
+void parallelRadixSort(
+            std::vector<SortKey>& keys, 
+            int num_bits,
+            unsigned int num_threads)
+{
+    std::size_t n = keys.size();
+    if (n < 2) {
+        return;
+    }
+    if (num_threads == 0) {
+        num_threads = defaultNumThreads();
+    }
+    num_threads = std::min<std::size_t>(
+                  num_threads, std::max<std::size_t>(n / 65536, 1));
+
+    std::vector<SortKey> temp(n);
+    std::vector<std::array<std::size_t, 256>> counts(num_threads);
+    SortKey* src = keys.data();
+    SortKey* dst = temp.data();
+    for (int shift = 0; shift < num_bits; shift += 8) {
+
+        // Histogram per thread.
+        parallelFor(n, num_threads,
+        [&](std::size_t begin, std::size_t end, unsigned int thread_index) {
+            std::array<std::size_t, 256>& count = counts[thread_index];
+            count.fill(0);
+            for (std::size_t k = begin; k < end; k++) {
+                count[(src[k].key >> shift) & 255]++;
+            }
+        });
+
+        // Skip pass if all keys share this digit.
+        bool is_trivial = false;
+        for (int digit = 0; digit < 256; digit++) {
+            std::size_t total = 0;
+            for (const std::array<std::size_t, 256>& count : counts) {
+                total += count[digit];
+            }
+            if (total == n) {
+                is_trivial = true;
+            }
+        }
+        if (is_trivial) {
+            continue;
+        }
+
+        // Exclusive prefix sum, digit-major then thread-minor, for 
+        // stability.
+        std::size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            for (std::array<std::size_t, 256>& count : counts) {
+                std::size_t tmp = count[digit];
+                count[digit] = offset;
+                offset += tmp;
+            }
+        }
+
+        // Scatter per thread.
+        parallelFor(n, num_threads,
+        [&](std::size_t begin, std::size_t end, unsigned int thread_index) {
+            std::array<std::size_t, 256>& count = counts[thread_index];
+            for (std::size_t k = begin; k < end; k++) {
+                dst[count[(src[k].key >> shift) & 255]++] = src[k];
+            }
+        });
+        std::swap(src, dst);
+    }
+    if (src != keys.data()) {
+        keys.swap(temp);
+    }
+}
+
+namespace {
+
+// Unpacked record, as spilled to runs.
+struct Record
+{
+    double values[8];
+};
+
+// Run reader.
+struct RunReader
+{
+    std::FILE* file = nullptr;
+    std::size_t record_size = 0;
+    std::vector<char> buffer;
+    std::size_t buffer_pos = 0;
+    std::size_t buffer_size = 0;
+
+    // Next record, or null if exhausted.
+    const char* next()
+    {
+        if (buffer_pos == buffer_size) {
+            buffer_pos = 0;
+            buffer_size = 
+                std::fread(buffer.data(), record_size, 
+                           buffer.size() / record_size, file);
+            if (std::ferror(file)) {
+                throw 
+                    std::runtime_error(
+                    std::string(__PRETTY_FUNCTION__)
+                        .append(": can't read temporary file"));
+            }
+            if (buffer_size == 0) {
+                return nullptr;
+            }
+        }
+        return &buffer[record_size * buffer_pos++];
+    }
+};
+
+} // namespace
+
+// Constructor.
+MortonSortLeafWriter::MortonSortLeafWriter(
+            std::unique_ptr<LeafWriter> writer,
+            const pre::aabb3<Float>& bounds,
+            std::size_t max_memory,
+            unsigned int num_threads,
+            bool packed) :
+                writer_(std::move(writer)),
+                bounds_(bounds),
+                num_threads_(num_threads),
+                packed_(packed),
+                packer_(bounds)
+{
+    // Leaf plus key and radix sort scratch.
+    std::size_t leaf_size = 
+        packed_ ? sizeof(PackedLeafDisk) : sizeof(LeafDisk);
+    max_leaves_ = std::max<std::size_t>(
+                  max_memory / (leaf_size + 2 * sizeof(SortKey)), 1024);
+}
+
+// Destructor.
+MortonSortLeafWriter::~MortonSortLeafWriter()
+{
+    for (std::FILE* run : runs_) {
+        std::fclose(run);
+    }
+}
+
+// Write.
+void MortonSortLeafWriter::write(const LeafDisk& leaf_disk)
+{
+    if (packed_) {
+        packed_leaf_disks_.push_back(packer_.pack(leaf_disk));
+    }
+    else {
+        leaf_disks_.push_back(leaf_disk);
+    }
+    if (bufferSize() >= max_leaves_) {
+        spill();
+    }
+}
+
+// Finish.
+void MortonSortLeafWriter::finish()
+{
+    TraceSpan span("sort finish");
+    if (runs_.empty()) {
+        // Sort in memory.
+        std::vector<SortKey> keys = sortBuffer();
+        for (const SortKey& key : keys) {
+            writer_->write(bufferedLeaf(key.index));
+        }
+        std::vector<LeafDisk>().swap(leaf_disks_);
+        std::vector<PackedLeafDisk>().swap(packed_leaf_disks_);
+    }
+    else {
+        if (bufferSize() > 0) {
+            spill();
+        }
+        std::vector<LeafDisk>().swap(leaf_disks_);
+        std::vector<PackedLeafDisk>().swap(packed_leaf_disks_);
+
+        // Merge runs, splitting the memory limit between read buffers.
+        std::size_t record_size = recordSize();
+        std::vector<RunReader> readers(runs_.size());
+        std::size_t buffer_size = 
+            std::max<std::size_t>(max_leaves_ / runs_.size(), 256);
+        for (std::size_t r = 0; r < runs_.size(); r++) {
+            if (std::fflush(runs_[r]) != 0) {
+                throw 
+                    std::runtime_error(
+                    std::string(__PRETTY_FUNCTION__)
+                        .append(": can't write temporary file"));
+            }
+            std::rewind(runs_[r]);
+            readers[r].file = runs_[r];
+            readers[r].record_size = record_size;
+            readers[r].buffer.resize(buffer_size * record_size);
+        }
+        struct Head {
+            std::uint64_t key;
+            std::size_t run;
+            LeafDisk leaf_disk;
+        };
+        auto isAfter = [](const Head& head0, const Head& head1) {
+            // Ties broken by run index, for stability.
+            return head0.key != head1.key ? head0.key > head1.key :
+                                            head0.run > head1.run;
+        };
+        std::priority_queue<
+            Head, std::vector<Head>, decltype(isAfter)> heads(isAfter);
+        auto pushNext = [&](std::size_t r) {
+            if (const char* record = readers[r].next()) {
+                Head head;
+                head.run = r;
+                head.leaf_disk = decodeRecord(record, head.key);
+                heads.push(head);
+            }
+        };
+        for (std::size_t r = 0; r < runs_.size(); r++) {
+            pushNext(r);
+        }
+        while (!heads.empty()) {
+            Head head = heads.top();
+            heads.pop();
+            writer_->write(head.leaf_disk);
+            pushNext(head.run);
+        }
+        for (std::FILE* run : runs_) {
+            std::fclose(run);
+        }
+        runs_.clear();
+    }
+    writer_->finish();
+}
+
+// Check capacity.
+void MortonSortLeafWriter::checkCapacity(std::uint64_t num_leaf_disks) const
+{
+    writer_->checkCapacity(num_leaf_disks);
+}
+
+// Compute Morton code.
+std::uint64_t MortonSortLeafWriter::computeMorton(
+            const Vec3<Float>& pos) const
+{
+    std::uint32_t q[3];
+    for (int j = 0; j < 3; j++) {
+        Float extent = bounds_[1][j] - bounds_[0][j];
+        Float t = extent > 0 ? (pos[j] - bounds_[0][j]) / extent : 0;
+        t *= Float(1 << 21);
+        q[j] = t < 0 ? 0 : 
+               t >= Float((1 << 21) - 1) ? (1 << 21) - 1 : std::uint32_t(t);
+    }
+    return encodeMorton63(q[0], q[1], q[2]);
+}
+
+// Compute Morton code of packed leaf.
+std::uint64_t MortonSortLeafWriter::computeMorton(
+            const PackedLeafDisk& packed) const
+{
+    // Quantized coordinates are already over the bounds.
+    return encodeMorton63(
+            std::uint32_t(packed.pos) & LeafDiskPacker::max_coord,
+            std::uint32_t(packed.pos >> 21) & LeafDiskPacker::max_coord,
+            std::uint32_t(packed.pos >> 42) & LeafDiskPacker::max_coord);
+}
+
+// Buffer size.
+std::size_t MortonSortLeafWriter::bufferSize() const
+{
+    return packed_ ? packed_leaf_disks_.size() : leaf_disks_.size();
+}
+
+// Buffered leaf.
+LeafDisk MortonSortLeafWriter::bufferedLeaf(std::size_t k) const
+{
+    return packed_ ? packer_.unpack(packed_leaf_disks_[k]) : leaf_disks_[k];
+}
+
+// Sort buffer.
+std::vector<SortKey> MortonSortLeafWriter::sortBuffer()
+{
+    std::vector<SortKey> keys(bufferSize());
+    parallelFor(keys.size(), num_threads_,
+    [&](std::size_t begin, std::size_t end, unsigned int) {
+        for (std::size_t k = begin; k < end; k++) {
+            keys[k].key = packed_ ? 
+                          computeMorton(packed_leaf_disks_[k]) : 
+                          computeMorton(leaf_disks_[k].pos);
+            keys[k].index = k;
+        }
+    });
+    parallelRadixSort(keys, 63, num_threads_);
+    return keys;
+}
+
+// Record size.
+std::size_t MortonSortLeafWriter::recordSize() const
+{
+    return packed_ ? sizeof(PackedLeafDisk) : sizeof(Record);
+}
+
+// Encode record.
+void MortonSortLeafWriter::encodeRecord(
+            const SortKey& key, char* record) const
+{
+    if (packed_) {
+        // Key is recomputed on decode.
+        std::memcpy(
+            record, &packed_leaf_disks_[key.index], 
+            sizeof(PackedLeafDisk));
+    }
+    else {
+        const LeafDisk& leaf_disk = leaf_disks_[key.index];
+        Record values;
+        values.values[0] = leaf_disk.pos[0];
+        values.values[1] = leaf_disk.pos[1];
+        values.values[2] = leaf_disk.pos[2];
+        values.values[3] = leaf_disk.normal[0];
+        values.values[4] = leaf_disk.normal[1];
+        values.values[5] = leaf_disk.normal[2];
+        values.values[6] = leaf_disk.radius;
+        std::memcpy(&values.values[7], &key.key, sizeof(key.key));
+        std::memcpy(record, &values, sizeof(Record));
+    }
+}
+
+// Decode record.
+LeafDisk MortonSortLeafWriter::decodeRecord(
+            const char* record, std::uint64_t& key) const
+{
+    if (packed_) {
+        PackedLeafDisk packed;
+        std::memcpy(&packed, record, sizeof(PackedLeafDisk));
+        key = computeMorton(packed);
+        return packer_.unpack(packed);
+    }
+    else {
+        Record values;
+        std::memcpy(&values, record, sizeof(Record));
+        LeafDisk leaf_disk;
+        leaf_disk.pos[0] = values.values[0];
+        leaf_disk.pos[1] = values.values[1];
+        leaf_disk.pos[2] = values.values[2];
+        leaf_disk.normal[0] = values.values[3];
+        leaf_disk.normal[1] = values.values[4];
+        leaf_disk.normal[2] = values.values[5];
+        leaf_disk.radius = values.values[6];
+        std::memcpy(&key, &values.values[7], sizeof(key));
+        return leaf_disk;
+    }
+}
+
+// Spill.
+void MortonSortLeafWriter::spill()
+{
+    TraceSpan span("sort spill", runs_.size());
+    std::FILE* run = std::tmpfile();
+    if (!run) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't create temporary file"));
+    }
+    runs_.push_back(run);
+    std::vector<SortKey> keys = sortBuffer();
+    std::size_t record_size = recordSize();
+    std::vector<char> records(4096 * record_size);
+    std::size_t num_records = 0;
+    for (std::size_t k = 0; k < keys.size(); k++) {
+        encodeRecord(keys[k], &records[record_size * num_records++]);
+        if (num_records == 4096 || k + 1 == keys.size()) {
+            if (std::fwrite(
+                    records.data(), record_size, 
+                    num_records, run) != num_records) {
+                throw 
+                    std::runtime_error(
+                    std::string(__PRETTY_FUNCTION__)
+                        .append(": can't write temporary file"));
+            }
+            num_records = 0;
+        }
+    }
+    leaf_disks_.clear();
+    packed_leaf_disks_.clear();
+}
+
+} // namespace ld
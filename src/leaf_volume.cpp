@@ -0,0 +1,593 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <leaf-disk-gen/leaf_volume.hpp>
+
+namespace ld {
+
+namespace {
+
+// Convert expected number of leaves to count, or throw.
+std::uint64_t toLeafCount(Float num_leaves)
+{
+    // Compare against 2^63, which is exact in floating point.
+    if (!(num_leaves >= 0 && num_leaves < Float(1ULL << 63))) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": invalid or too many leaves"));
+    }
+    return static_cast<std::uint64_t>(num_leaves);
+}
+
+// Clip ray to solid upright cone with apex at the origin, slope of radius
+// per depth k, and height h, as the intersection of the double cone with
+// the slab between the base and the apex. The solid cone is convex, so
+// the result is one interval.
+bool clipCone(
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            Float k,
+            Float h,
+            Float& tmin,
+            Float& tmax)
+{
+    const Float inf = std::numeric_limits<Float>::infinity();
+
+    // Slab.
+    Float slab0 = -inf;
+    Float slab1 = +inf;
+    if (dir[2] == 0) {
+        if (!(org[2] >= -h && org[2] <= 0)) {
+            return false;
+        }
+    }
+    else {
+        slab0 = (-h - org[2]) / dir[2];
+        slab1 = -org[2] / dir[2];
+        if (slab0 > slab1) {
+            std::swap(slab0, slab1);
+        }
+    }
+
+    // Double cone, as up to 2 intervals where the quadratic is 
+    // non-positive.
+    Float a = dir[0] * dir[0] + dir[1] * dir[1] - k * k * dir[2] * dir[2];
+    Float b = org[0] * dir[0] + org[1] * dir[1] - k * k * org[2] * dir[2];
+    Float c = org[0] * org[0] + org[1] * org[1] - k * k * org[2] * org[2];
+    Float t0[2] = {-inf, +inf};
+    Float t1[2] = {+inf, -inf};
+    if (a == 0) {
+        if (b > 0) {
+            t1[0] = -c / (2 * b);
+        }
+        else if (b < 0) {
+            t0[0] = -c / (2 * b);
+        }
+        else if (!(c <= 0)) {
+            return false;
+        }
+    }
+    else {
+        Float disc = b * b - a * c;
+        if (!(disc >= 0)) {
+            if (a > 0) {
+                return false;
+            }
+        }
+        else {
+            Float sqrt_disc = pre::sqrt(disc);
+            Float r0 = (-b - sqrt_disc) / a;
+            Float r1 = (-b + sqrt_disc) / a;
+            if (r0 > r1) {
+                std::swap(r0, r1);
+            }
+            if (a > 0) {
+                t0[0] = r0;
+                t1[0] = r1;
+            }
+            else {
+                t1[0] = r0;
+                t0[1] = r1;
+                t1[1] = +inf;
+            }
+        }
+    }
+
+    // Intersect with slab.
+    tmin = +inf;
+    tmax = -inf;
+    for (int i = 0; i < 2; i++) {
+        Float lower = std::max(t0[i], slab0);
+        Float upper = std::min(t1[i], slab1);
+        if (lower <= upper) {
+            tmin = std::min(tmin, lower);
+            tmax = std::max(tmax, upper);
+        }
+    }
+    return tmin <= tmax;
+}
+
+} // namespace
+
+// Number of leaves.
+std::uint64_t BoxLeafVolume::numLeaves(Float lai, Float leaf_radius) const
+{
+    return 
+        toLeafCount(
+            lai * 
+            (box_[1][0] - box_[0][0]) *
+            (box_[1][1] - box_[0][1]) /
+            (pre::numeric_constants<Float>::M_pi() * 
+                leaf_radius * leaf_radius));
+}
+
+// Ground area.
+Float BoxLeafVolume::groundArea() const
+{
+    return 
+        (box_[1][0] - box_[0][0]) *
+        (box_[1][1] - box_[0][1]);
+}
+
+// Sample position above ground position.
+bool BoxLeafVolume::samplePositionAbove(
+            const Vec2<Float>& xy,
+            Float u,
+            Vec3<Float>& pos) const
+{
+    for (int j = 0; j < 2; j++) {
+        if (!(xy[j] >= box_[0][j] && 
+              xy[j] < box_[1][j])) {
+            return false;
+        }
+    }
+    pos = {xy[0], xy[1], box_[0][2] + u * (box_[1][2] - box_[0][2])};
+    return true;
+}
+
+// Leaf area density.
+Float BoxLeafVolume::leafAreaDensity(const Vec3<Float>& pos, Float lai) const
+{
+    for (int j = 0; j < 3; j++) {
+        if (!(pos[j] >= box_[0][j] && 
+              pos[j] <= box_[1][j])) {
+            return 0;
+        }
+    }
+    return lai / (box_[1][2] - box_[0][2]);
+}
+
+// Sample ray origin.
+bool BoxLeafVolume::sampleRayOrigin(
+            const Vec3<Float>& dir, 
+            const Vec2<Float>& u, 
+            Vec3<Float>& org) const
+{
+    if (!(dir[2] > 0)) {
+        return false;
+    }
+
+    // Origin on bottom face.
+    org = box_.lerp(Vec3<Float>{u[0], u[1], 0});
+
+    // Reject if the ray leaves through the sides, as this would 
+    // bias transmittance relative to an infinite horizontal layer.
+    Float t = (box_[1][2] - box_[0][2]) / dir[2];
+    for (int j = 0; j < 2; j++) {
+        Float x = org[j] + t * dir[j];
+        if (!(x >= box_[0][j] && 
+              x <= box_[1][j])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Clip ray.
+bool BoxLeafVolume::clipRay(
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            Float margin,
+            Float& tmin,
+            Float& tmax) const
+{
+    tmin = -std::numeric_limits<Float>::infinity();
+    tmax = +std::numeric_limits<Float>::infinity();
+    for (int j = 0; j < 3; j++) {
+        Float lower = box_[0][j] - margin;
+        Float upper = box_[1][j] + margin;
+        if (dir[j] == 0) {
+            if (!(org[j] >= lower && 
+                  org[j] <= upper)) {
+                return false;
+            }
+            continue;
+        }
+        Float t0 = (lower - org[j]) / dir[j];
+        Float t1 = (upper - org[j]) / dir[j];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+    }
+    return tmin <= tmax;
+}
+
+// Number of leaves.
+std::uint64_t SphereLeafVolume::numLeaves(
+            Float lai, Float leaf_radius) const
+{
+    return 
+        toLeafCount(
+            lai * 
+            radius_ * 
+            radius_ / 
+            (leaf_radius * leaf_radius));
+}
+
+// Ground area.
+Float SphereLeafVolume::groundArea() const
+{
+    return pre::numeric_constants<Float>::M_pi() * radius_ * radius_;
+}
+
+// Sample position.
+Vec3<Float> SphereLeafVolume::samplePosition(const Vec3<Float>& u) const
+{
+    Vec2<Float> pos = 
+    Vec2<Float>::uniform_disk_pdf_sample(Vec2<Float>{u[0], u[1]});
+    Vec3<Float> res = {
+        pos[0],
+        pos[1],
+        pre::sqrt(1 - pre::dot(pos, pos)) * (2 * u[2] - 1)
+    };
+    res *= radius_;
+    res += center_;
+    return res;
+}
+
+// Sample position above ground position.
+bool SphereLeafVolume::samplePositionAbove(
+            const Vec2<Float>& xy,
+            Float u,
+            Vec3<Float>& pos) const
+{
+    Vec2<Float> off = {
+        (xy[0] - center_[0]) / radius_,
+        (xy[1] - center_[1]) / radius_
+    };
+    Float off_len2 = pre::dot(off, off);
+    if (!(off_len2 < 1)) {
+        return false;
+    }
+    pos = {
+        xy[0],
+        xy[1],
+        center_[2] + radius_ * pre::sqrt(1 - off_len2) * (2 * u - 1)
+    };
+    return true;
+}
+
+// Leaf area density.
+Float SphereLeafVolume::leafAreaDensity(
+            const Vec3<Float>& pos, Float lai) const
+{
+    Vec3<Float> off = pos - center_;
+    if (!(pre::dot(off, off) < radius_ * radius_)) {
+        return 0;
+    }
+
+    // Uniform LAI over the projected disk, spread over the
+    // vertical chord.
+    Float chord = 
+        2 * pre::sqrt(radius_ * radius_ - 
+                      off[0] * off[0] - 
+                      off[1] * off[1]);
+    return lai / chord;
+}
+
+// Sample ray origin.
+bool SphereLeafVolume::sampleRayOrigin(
+            const Vec3<Float>& dir, 
+            const Vec2<Float>& u, 
+            Vec3<Float>& org) const
+{
+    // Origin on projected disk through center, perpendicular to 
+    // direction.
+    Mat3<Float> tbn = Mat3<Float>::build_onb(dir);
+    Vec3<Float> hatu = pre::transpose(tbn)[0];
+    Vec3<Float> hatv = pre::transpose(tbn)[1];
+    Vec2<Float> pos = Vec2<Float>::uniform_disk_pdf_sample(u);
+    org = center_ + 
+            (radius_ * pos[0]) * hatu + 
+            (radius_ * pos[1]) * hatv;
+    return true;
+}
+
+// Clip ray.
+bool SphereLeafVolume::clipRay(
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            Float margin,
+            Float& tmin,
+            Float& tmax) const
+{
+    // Solve quadratic, assuming unit direction.
+    Vec3<Float> off = org - center_;
+    Float b = pre::dot(off, dir);
+    Float c = pre::dot(off, off) - 
+                (radius_ + margin) * (radius_ + margin);
+    Float disc = b * b - c;
+    if (!(disc >= 0)) {
+        return false;
+    }
+    Float sqrt_disc = pre::sqrt(disc);
+    tmin = -b - sqrt_disc;
+    tmax = -b + sqrt_disc;
+    return true;
+}
+
+// Number of leaves.
+std::uint64_t EllipsoidLeafVolume::numLeaves(
+            Float lai, Float leaf_radius) const
+{
+    return 
+        toLeafCount(
+            lai * 
+            radii_[0] * 
+            radii_[1] / 
+            (leaf_radius * leaf_radius));
+}
+
+// Ground area.
+Float EllipsoidLeafVolume::groundArea() const
+{
+    return pre::numeric_constants<Float>::M_pi() * radii_[0] * radii_[1];
+}
+
+// Sample position.
+Vec3<Float> EllipsoidLeafVolume::samplePosition(const Vec3<Float>& u) const
+{
+    Vec2<Float> pos = 
+    Vec2<Float>::uniform_disk_pdf_sample(Vec2<Float>{u[0], u[1]});
+    Vec3<Float> res = {
+        pos[0],
+        pos[1],
+        pre::sqrt(1 - pre::dot(pos, pos)) * (2 * u[2] - 1)
+    };
+    res *= radii_;
+    res += center_;
+    return res;
+}
+
+// Sample position above ground position.
+bool EllipsoidLeafVolume::samplePositionAbove(
+            const Vec2<Float>& xy,
+            Float u,
+            Vec3<Float>& pos) const
+{
+    Vec2<Float> off = {
+        (xy[0] - center_[0]) / radii_[0],
+        (xy[1] - center_[1]) / radii_[1]
+    };
+    Float off_len2 = pre::dot(off, off);
+    if (!(off_len2 < 1)) {
+        return false;
+    }
+    pos = {
+        xy[0],
+        xy[1],
+        center_[2] + radii_[2] * pre::sqrt(1 - off_len2) * (2 * u - 1)
+    };
+    return true;
+}
+
+// Leaf area density.
+Float EllipsoidLeafVolume::leafAreaDensity(
+            const Vec3<Float>& pos, Float lai) const
+{
+    Vec3<Float> off = (pos - center_) / radii_;
+    if (!(pre::dot(off, off) < 1)) {
+        return 0;
+    }
+
+    // Uniform LAI over the projected ellipse, spread over the
+    // vertical chord.
+    Float chord = 
+        2 * radii_[2] * pre::sqrt(1 - off[0] * off[0] - off[1] * off[1]);
+    return lai / chord;
+}
+
+// Sample ray origin.
+bool EllipsoidLeafVolume::sampleRayOrigin(
+            const Vec3<Float>& dir, 
+            const Vec2<Float>& u, 
+            Vec3<Float>& org) const
+{
+    // Origin on projected disk through center of the unit sphere, 
+    // perpendicular to direction in unit sphere space. Scaling to the 
+    // ellipsoid is affine, so origins remain uniform over the rays
+    // through the ellipsoid.
+    Mat3<Float> tbn = 
+        Mat3<Float>::build_onb(pre::normalize_safe(dir / radii_));
+    Vec3<Float> hatu = pre::transpose(tbn)[0];
+    Vec3<Float> hatv = pre::transpose(tbn)[1];
+    Vec2<Float> pos = Vec2<Float>::uniform_disk_pdf_sample(u);
+    org = center_ + radii_ * (pos[0] * hatu + pos[1] * hatv);
+    return true;
+}
+
+// Clip ray.
+bool EllipsoidLeafVolume::clipRay(
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            Float margin,
+            Float& tmin,
+            Float& tmax) const
+{
+    // Scale, rather than offset, by the margin, such that the scaled 
+    // ellipsoid contains every point within the margin.
+    Float min_radius = std::min({radii_[0], radii_[1], radii_[2]});
+    Vec3<Float> radii = radii_ * (1 + margin / min_radius);
+
+    // Solve quadratic in unit sphere space, where ray parameters are 
+    // the same.
+    Vec3<Float> off = (org - center_) / radii;
+    Vec3<Float> vec = dir / radii;
+    Float a = pre::dot(vec, vec);
+    Float b = pre::dot(off, vec);
+    Float c = pre::dot(off, off) - 1;
+    Float disc = b * b - a * c;
+    if (!(disc >= 0)) {
+        return false;
+    }
+    Float sqrt_disc = pre::sqrt(disc);
+    tmin = (-b - sqrt_disc) / a;
+    tmax = (-b + sqrt_disc) / a;
+    return true;
+}
+
+// Number of leaves.
+std::uint64_t ConeLeafVolume::numLeaves(Float lai, Float leaf_radius) const
+{
+    return 
+        toLeafCount(
+            lai * 
+            radius_ * 
+            radius_ / 
+            (leaf_radius * leaf_radius));
+}
+
+// Ground area.
+Float ConeLeafVolume::groundArea() const
+{
+    return pre::numeric_constants<Float>::M_pi() * radius_ * radius_;
+}
+
+// Sample position.
+Vec3<Float> ConeLeafVolume::samplePosition(const Vec3<Float>& u) const
+{
+    Vec2<Float> pos = 
+    Vec2<Float>::uniform_disk_pdf_sample(Vec2<Float>{u[0], u[1]});
+    return {
+        base_[0] + radius_ * pos[0],
+        base_[1] + radius_ * pos[1],
+        base_[2] + height_ * (1 - pre::sqrt(pre::dot(pos, pos))) * u[2]
+    };
+}
+
+// Sample position above ground position.
+bool ConeLeafVolume::samplePositionAbove(
+            const Vec2<Float>& xy,
+            Float u,
+            Vec3<Float>& pos) const
+{
+    Vec2<Float> off = {
+        (xy[0] - base_[0]) / radius_,
+        (xy[1] - base_[1]) / radius_
+    };
+    Float off_len2 = pre::dot(off, off);
+    if (!(off_len2 < 1)) {
+        return false;
+    }
+    pos = {
+        xy[0],
+        xy[1],
+        base_[2] + height_ * (1 - pre::sqrt(off_len2)) * u
+    };
+    return true;
+}
+
+// Leaf area density.
+Float ConeLeafVolume::leafAreaDensity(
+            const Vec3<Float>& pos, Float lai) const
+{
+    Vec3<Float> off = pos - base_;
+    Float chord = 
+        height_ * 
+        (1 - pre::sqrt(off[0] * off[0] + off[1] * off[1]) / radius_);
+    if (!(off[2] >= 0 && off[2] < chord)) {
+        return 0;
+    }
+
+    // Uniform LAI over the projected disk, spread over the
+    // vertical chord.
+    return lai / chord;
+}
+
+// Sample ray origin.
+bool ConeLeafVolume::sampleRayOrigin(
+            const Vec3<Float>& dir, 
+            const Vec2<Float>& u, 
+            Vec3<Float>& org) const
+{
+    // Origin on projected disk of bounding sphere through its center,
+    // perpendicular to direction, rejecting rays that miss the cone.
+    Vec3<Float> center = base_ + Vec3<Float>{0, 0, height_ / 2};
+    Float radius = pre::sqrt(radius_ * radius_ + height_ * height_ / 4);
+    Mat3<Float> tbn = Mat3<Float>::build_onb(dir);
+    Vec3<Float> hatu = pre::transpose(tbn)[0];
+    Vec3<Float> hatv = pre::transpose(tbn)[1];
+    Vec2<Float> pos = Vec2<Float>::uniform_disk_pdf_sample(u);
+    org = center + 
+            (radius * pos[0]) * hatu + 
+            (radius * pos[1]) * hatv;
+    Float tmin;
+    Float tmax;
+    return clipRay(org, dir, 0, tmin, tmax);
+}
+
+// Clip ray.
+bool ConeLeafVolume::clipRay(
+            const Vec3<Float>& org,
+            const Vec3<Float>& dir,
+            Float margin,
+            Float& tmin,
+            Float& tmax) const
+{
+    // Scale, rather than offset, by the margin about the center of the
+    // inscribed sphere, such that the scaled cone contains every point 
+    // within the margin.
+    Float inradius = 
+        radius_ * height_ / 
+        (radius_ + pre::sqrt(radius_ * radius_ + height_ * height_));
+    Float scale = 1 + margin / inradius;
+    Vec3<Float> apex = base_ + Vec3<Float>{0, 0, inradius + 
+                                           scale * (height_ - inradius)};
+    return clipCone(
+            org - apex, dir, 
+            radius_ / height_, scale * height_, tmin, tmax);
+}
+
+} // namespace ld
@@ -0,0 +1,1083 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <sys/types.h>
+#include <preform/misc_string.hpp>
+#include <leaf-disk-gen/leaf_writer.hpp>
+
+namespace ld {
+
+// From filename.
+std::unique_ptr<LeafWriter> LeafWriter::fromFilename(
+            const std::string& filename,
+            const LeafWriterOptions& options)
+{
+    pre::ci_string ci_filename = filename.c_str();
+    auto hasExtension = [&](const char* ext) {
+        std::size_t len = std::strlen(ext);
+        return ci_filename.size() >= len &&
+               ci_filename.compare(ci_filename.size() - len, len, ext) == 0;
+    };
+    if (hasExtension(".glist")) {
+        return std::unique_ptr<LeafWriter>(
+               new GListLeafWriter(filename, options));
+    }
+    else
+    if (hasExtension(".obj")) {
+        return std::unique_ptr<LeafWriter>(
+               new ObjLeafWriter(filename, options));
+    }
+    else
+    if (hasExtension(".glb")) {
+        return std::unique_ptr<LeafWriter>(
+               new GlbLeafWriter(filename, options));
+    }
+    else {
+        throw std::runtime_error(
+              "-o/--output filename must end "
+              "with either \".glist\", \".obj\", or \".glb\"");
+    }
+}
+
+// Format.
+void LeafWriter::format(
+            const LeafDisk*,
+            std::size_t,
+            std::size_t,
+            std::string&) const
+{
+    throw 
+        std::runtime_error(
+        std::string(__PRETTY_FUNCTION__)
+            .append(": not formattable"));
+}
+
+// Write formatted.
+void LeafWriter::writeFormatted(const std::string&, std::size_t)
+{
+    throw 
+        std::runtime_error(
+        std::string(__PRETTY_FUNCTION__)
+            .append(": not formattable"));
+}
+
+namespace {
+
+// Open output file stream, or throw.
+void openOrThrow(
+        std::ofstream& ofs, 
+        const std::string& filename, 
+        std::ios::openmode mode = std::ios::out)
+{
+    ofs.open(filename, mode);
+    if (!ofs.is_open()) {
+        throw std::runtime_error(
+              std::string("can't open ").append(filename));
+    }
+}
+
+// Open output file stream positioned to overwrite the footer of an 
+// existing file, or throw.
+void openBeforeFooterOrThrow(
+        std::ofstream& ofs,
+        const std::string& filename,
+        const std::string& footer)
+{
+    std::ifstream ifs(filename, std::ios::in | std::ios::binary);
+    std::streamoff size = -1;
+    if (ifs.is_open() && ifs.seekg(0, std::ios::end)) {
+        size = ifs.tellg();
+    }
+    std::string tail(footer.size(), '\0');
+    if (!(size >= std::streamoff(footer.size()) &&
+          ifs.seekg(size - footer.size()) &&
+          ifs.read(&tail[0], tail.size()) && tail == footer)) {
+        throw std::runtime_error(
+              std::string("can't append to ").append(filename));
+    }
+    ifs.close();
+    openOrThrow(ofs, filename, 
+                std::ios::in | std::ios::out | std::ios::binary);
+    ofs.seekp(size - footer.size());
+}
+
+// Spilled leaf record.
+struct SpillRecord
+{
+    double values[7];
+};
+
+// Number of leaves to buffer before spilling.
+constexpr std::size_t num_spill_batch = 4096;
+
+// Spill record of leaf disk.
+SpillRecord toSpillRecord(const LeafDisk& leaf_disk)
+{
+    return {{
+        leaf_disk.pos[0], leaf_disk.pos[1], leaf_disk.pos[2],
+        leaf_disk.normal[0], leaf_disk.normal[1], leaf_disk.normal[2],
+        leaf_disk.radius
+    }};
+}
+
+// Leaf disk of spill record.
+LeafDisk fromSpillRecord(const SpillRecord& record)
+{
+    const double* values = record.values;
+    LeafDisk leaf_disk;
+    leaf_disk.pos = {values[0], values[1], values[2]};
+    leaf_disk.normal = {values[3], values[4], values[5]};
+    leaf_disk.radius = values[6];
+    return leaf_disk;
+}
+
+// Seek to spill record.
+void seekSpillRecord(std::FILE* file, std::uint64_t index)
+{
+    if (::fseeko(file, off_t(index * sizeof(SpillRecord)), SEEK_SET) != 0) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't seek temporary file"));
+    }
+}
+
+// Read range of spilled leaves in order, in batches.
+template <typename Func>
+void readSpillRecords(
+            std::FILE* file, 
+            std::uint64_t first, 
+            std::uint64_t count, 
+            Func&& func)
+{
+    seekSpillRecord(file, first);
+    std::vector<SpillRecord> records(
+            std::min<std::uint64_t>(count, num_spill_batch));
+    while (count > 0) {
+        std::size_t num_records = 
+            std::min<std::uint64_t>(count, records.size());
+        if (std::fread(records.data(), sizeof(SpillRecord), 
+                       num_records, file) != num_records) {
+            throw 
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": can't read temporary file"));
+        }
+        for (std::size_t k = 0; k < num_records; k++) {
+            func(fromSpillRecord(records[k]));
+        }
+        count -= num_records;
+    }
+}
+
+// Write spilled leaves at index.
+void writeSpillRecords(
+            std::FILE* file,
+            std::uint64_t first,
+            const SpillRecord* records,
+            std::size_t num_records)
+{
+    seekSpillRecord(file, first);
+    if (std::fwrite(
+            records, sizeof(SpillRecord), 
+            num_records, file) != num_records) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't write temporary file"));
+    }
+}
+
+// Expand bounds by tight bounds of disk.
+void expandDiskBounds(
+            const LeafDisk& leaf_disk, 
+            Vec3<Float>& lower, 
+            Vec3<Float>& upper)
+{
+    Vec3<Float> ext;
+    for (int j = 0; j < 3; j++) {
+        ext[j] = leaf_disk.radius * 
+            pre::sqrt(std::max(Float(0), 
+                1 - leaf_disk.normal[j] * leaf_disk.normal[j]));
+    }
+    lower = pre::min(lower, leaf_disk.pos - ext);
+    upper = pre::max(upper, leaf_disk.pos + ext);
+}
+
+} // namespace
+
+// Constructor.
+GListLeafWriter::GListLeafWriter(
+            const std::string& filename,
+            const LeafWriterOptions& options) :
+                options_(options)
+{
+    if (options_.append) {
+        if (options_.cell_size > 0) {
+            throw
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": can't append to bucketed output"));
+        }
+        openBeforeFooterOrThrow(
+                ofs_, filename, "</object>\n</geometrylist>\n");
+        return;
+    }
+    openOrThrow(ofs_, filename);
+    ofs_ << "<geometrylist enabled=\"true\">\n";
+    if (options_.cell_size > 0) {
+        Float inf = std::numeric_limits<Float>::infinity();
+        bounds_ = {
+            Vec3<Float>{+inf, +inf, +inf},
+            Vec3<Float>{-inf, -inf, -inf}
+        };
+        openOrThrow(cells_ofs_, cellsFilename(filename));
+        cells_ofs_.precision(std::numeric_limits<Float>::digits10);
+        cells_ofs_ << "object,cell,num_leaves,";
+        cells_ofs_ << "min_x,min_y,min_z,max_x,max_y,max_z\n";
+    }
+    else {
+        writeObjectHeader();
+    }
+}
+
+// Destructor.
+GListLeafWriter::~GListLeafWriter()
+{
+    if (spill_) {
+        std::fclose(spill_);
+    }
+}
+
+// Write.
+void GListLeafWriter::write(const LeafDisk& leaf_disk)
+{
+    if (options_.cell_size > 0) {
+        leaf_disks_.push_back(leaf_disk);
+        bounds_[0] = pre::min(bounds_[0], leaf_disk.pos);
+        bounds_[1] = pre::max(bounds_[1], leaf_disk.pos);
+        if (leaf_disks_.size() >= num_spill_batch) {
+            spill();
+        }
+    }
+    else {
+        leaf_disk.writeGListInstance(ofs_);
+    }
+}
+
+// Finish.
+void GListLeafWriter::finish()
+{
+    if (!(options_.cell_size > 0)) {
+        ofs_ << "</object>\n";
+    }
+    else {
+        spill();
+        std::vector<LeafDisk>().swap(leaf_disks_);
+        if (num_spilled_ > 0) {
+            writeCells();
+        }
+        if (spill_) {
+            std::fclose(spill_);
+            spill_ = nullptr;
+        }
+        cells_ofs_.flush();
+    }
+    ofs_ << "</geometrylist>\n";
+    ofs_.flush();
+}
+
+// Write cells.
+void GListLeafWriter::writeCells()
+{
+    // Grid.
+    std::size_t dims[3];
+    std::size_t num_cells = 1;
+    for (int j = 0; j < 3; j++) {
+        Float extent = bounds_[1][j] - bounds_[0][j];
+        dims[j] = std::max<std::size_t>(
+                    std::ceil(extent / options_.cell_size), 1);
+        num_cells *= dims[j];
+        if (num_cells > (std::size_t(1) << 24)) {
+            throw
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": too many cells, increase cell size"));
+        }
+    }
+    auto cellIndex = [&](const LeafDisk& leaf_disk) {
+        std::size_t index = 0;
+        for (int j = 0; j < 3; j++) {
+            Float x = (leaf_disk.pos[j] - bounds_[0][j]) / 
+                            options_.cell_size;
+            std::size_t i = x > 0 ? std::size_t(x) : 0;
+            index = index * dims[j] + std::min(i, dims[j] - 1);
+        }
+        return index;
+    };
+
+    // First pass, count and prefix sum.
+    std::vector<std::uint64_t> cell_begin(num_cells + 1);
+    readSpillRecords(spill_, 0, num_spilled_, 
+    [&](const LeafDisk& leaf_disk) {
+        cell_begin[cellIndex(leaf_disk) + 1]++;
+    });
+    for (std::size_t cell = 0; cell < num_cells; cell++) {
+        cell_begin[cell + 1] += cell_begin[cell];
+    }
+
+    // Runs of consecutive cells that fit in the buffer together, or 
+    // single cells too large for it alone.
+    std::uint64_t max_leaves = 
+        std::max<std::uint64_t>(options_.cell_memory / sizeof(LeafDisk), 1);
+    std::vector<std::size_t> run_cell = {0};
+    while (run_cell.back() < num_cells) {
+        std::size_t cell0 = run_cell.back();
+        std::size_t cell1 = cell0 + 1;
+        while (cell1 < num_cells &&
+               cell_begin[cell1 + 1] - cell_begin[cell0] <= max_leaves) {
+            cell1++;
+        }
+        run_cell.push_back(cell1);
+    }
+    std::size_t num_runs = run_cell.size() - 1;
+
+    // Second pass, scatter into a temporary file ordered by run, in 
+    // write order within each run, through small per-run buffers 
+    // that together fit in the buffer.
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> 
+                sorted(std::tmpfile(), &std::fclose);
+    if (!sorted) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't create temporary file"));
+    }
+    {
+        std::size_t run_batch = 
+            std::min<std::uint64_t>(
+            std::max<std::uint64_t>(
+                options_.cell_memory / sizeof(SpillRecord) / num_runs, 1), 
+                num_spill_batch);
+        std::vector<SpillRecord> run_records(num_runs * run_batch);
+        std::vector<std::size_t> run_size(num_runs);
+        std::vector<std::uint64_t> run_next(num_runs);
+        for (std::size_t run = 0; run < num_runs; run++) {
+            run_next[run] = cell_begin[run_cell[run]];
+        }
+        auto flushRun = [&](std::size_t run) {
+            writeSpillRecords(
+                    sorted.get(), run_next[run], 
+                    &run_records[run * run_batch], run_size[run]);
+            run_next[run] += run_size[run];
+            run_size[run] = 0;
+        };
+        readSpillRecords(spill_, 0, num_spilled_, 
+        [&](const LeafDisk& leaf_disk) {
+            std::size_t run = 
+                std::upper_bound(
+                        run_cell.begin(), run_cell.end(), 
+                        cellIndex(leaf_disk)) - run_cell.begin() - 1;
+            run_records[run * run_batch + run_size[run]++] = 
+                toSpillRecord(leaf_disk);
+            if (run_size[run] == run_batch) {
+                flushRun(run);
+            }
+        });
+        for (std::size_t run = 0; run < num_runs; run++) {
+            if (run_size[run] > 0) {
+                flushRun(run);
+            }
+        }
+    }
+
+    // Write cell bounds, and open its object.
+    std::size_t num_objects = 0;
+    auto beginCell = [&](
+            std::size_t cell, 
+            const Vec3<Float>& lower, 
+            const Vec3<Float>& upper) {
+        std::uint64_t count = cell_begin[cell + 1] - cell_begin[cell];
+        ofs_ << "<!-- cell " << cell << ", ";
+        ofs_ << count << " leaves, ";
+        ofs_ << "bounds " << lower << " to " << upper << " -->\n";
+        cells_ofs_ << num_objects++ << "," << cell << "," << count;
+        for (int j = 0; j < 3; j++) {
+            cells_ofs_ << "," << lower[j];
+        }
+        for (int j = 0; j < 3; j++) {
+            cells_ofs_ << "," << upper[j];
+        }
+        cells_ofs_ << "\n";
+        writeObjectHeader();
+    };
+
+    // Third pass, reading each run in order, and gathering its cells 
+    // in the buffer.
+    Float inf = std::numeric_limits<Float>::infinity();
+    std::vector<LeafDisk> buffer;
+    std::vector<std::uint64_t> cell_next;
+    for (std::size_t run = 0; run < num_runs; run++) {
+        std::size_t cell0 = run_cell[run];
+        std::size_t cell1 = run_cell[run + 1];
+        std::uint64_t base = cell_begin[cell0];
+        std::uint64_t num_leaves = cell_begin[cell1] - base;
+        if (num_leaves == 0) {
+            // Nothing.
+        }
+        else if (num_leaves <= max_leaves) {
+            buffer.resize(num_leaves);
+            cell_next.assign(
+                    cell_begin.begin() + cell0, 
+                    cell_begin.begin() + cell1);
+            readSpillRecords(sorted.get(), base, num_leaves, 
+            [&](const LeafDisk& leaf_disk) {
+                std::size_t cell = cellIndex(leaf_disk);
+                buffer[cell_next[cell - cell0]++ - base] = leaf_disk;
+            });
+            for (std::size_t cell = cell0; cell < cell1; cell++) {
+                std::uint64_t begin = cell_begin[cell] - base;
+                std::uint64_t end = cell_begin[cell + 1] - base;
+                if (begin == end) {
+                    continue;
+                }
+                Vec3<Float> lower = {+inf, +inf, +inf};
+                Vec3<Float> upper = {-inf, -inf, -inf};
+                for (std::uint64_t k = begin; k < end; k++) {
+                    expandDiskBounds(buffer[k], lower, upper);
+                }
+                beginCell(cell, lower, upper);
+                for (std::uint64_t k = begin; k < end; k++) {
+                    buffer[k].writeGListInstance(ofs_);
+                }
+                ofs_ << "</object>\n";
+            }
+        }
+        else {
+            // Cell too large for the buffer alone, so stream it, with 
+            // one read for bounds and another for instances.
+            Vec3<Float> lower = {+inf, +inf, +inf};
+            Vec3<Float> upper = {-inf, -inf, -inf};
+            readSpillRecords(sorted.get(), base, num_leaves, 
+            [&](const LeafDisk& leaf_disk) {
+                expandDiskBounds(leaf_disk, lower, upper);
+            });
+            beginCell(cell0, lower, upper);
+            readSpillRecords(sorted.get(), base, num_leaves, 
+            [&](const LeafDisk& leaf_disk) {
+                leaf_disk.writeGListInstance(ofs_);
+            });
+            ofs_ << "</object>\n";
+        }
+    }
+}
+
+// Spill.
+void GListLeafWriter::spill()
+{
+    if (leaf_disks_.empty()) {
+        return;
+    }
+    if (!spill_) {
+        spill_ = std::tmpfile();
+        if (!spill_) {
+            throw 
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": can't create temporary file"));
+        }
+    }
+    std::vector<SpillRecord> records(leaf_disks_.size());
+    for (std::size_t k = 0; k < leaf_disks_.size(); k++) {
+        records[k] = toSpillRecord(leaf_disks_[k]);
+    }
+    writeSpillRecords(spill_, num_spilled_, records.data(), records.size());
+    num_spilled_ += records.size();
+    leaf_disks_.clear();
+}
+
+// Cells filename.
+std::string GListLeafWriter::cellsFilename(const std::string& filename)
+{
+    std::string stem = filename;
+    pre::ci_string ci_filename = filename.c_str();
+    if (ci_filename.size() >= 6 &&
+        ci_filename.compare(ci_filename.size() - 6, 6, ".glist") == 0) {
+        stem.resize(stem.size() - 6);
+    }
+    return stem + "_cells.csv";
+}
+
+// Is formattable?
+bool GListLeafWriter::isFormattable() const
+{
+    // Not if bucketing, which needs all leaves.
+    return !(options_.cell_size > 0);
+}
+
+// Format.
+void GListLeafWriter::format(
+            const LeafDisk* leaf_disks,
+            std::size_t num_leaf_disks,
+            std::size_t,
+            std::string& bytes) const
+{
+    std::ostringstream oss;
+    for (std::size_t k = 0; k < num_leaf_disks; k++) {
+        leaf_disks[k].writeGListInstance(oss);
+    }
+    bytes = oss.str();
+}
+
+// Write formatted.
+void GListLeafWriter::writeFormatted(
+            const std::string& bytes,
+            std::size_t)
+{
+    ofs_.write(bytes.data(), bytes.size());
+}
+
+// Write object header.
+void GListLeafWriter::writeObjectHeader()
+{
+    ofs_ << 
+        "<object>\n"
+        "<basegeometry>\n"
+        "<disk><matid>";
+    ofs_ << options_.matid;
+    ofs_ << 
+        "</matid></disk>\n"
+        "</basegeometry>\n";
+}
+
+// Constructor.
+TiledGListLeafWriter::TiledGListLeafWriter(
+            const std::string& filename,
+            const LeafWriterOptions& options,
+            const GListTiling& tiling) :
+                tile_filename_(tileFilename(filename)),
+                tile_writer_(tile_filename_, options),
+                tiling_(tiling)
+{
+    openOrThrow(ofs_, filename);
+
+    // Full precision, so tiles meet without seams far from the origin.
+    ofs_.precision(std::numeric_limits<Float>::digits10);
+}
+
+// Write.
+void TiledGListLeafWriter::write(const LeafDisk& leaf_disk)
+{
+    tile_writer_.write(leaf_disk);
+}
+
+// Finish.
+void TiledGListLeafWriter::finish()
+{
+    tile_writer_.finish();
+
+    // Reference tile by its name relative to the output, since they 
+    // are written side by side.
+    std::string tile_name = tile_filename_;
+    std::size_t slash = tile_name.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        tile_name = tile_name.substr(slash + 1);
+    }
+    ofs_ << "<geometrylist enabled=\"true\">\n";
+    ofs_ << 
+        "<object>\n"
+        "<basegeometry>\n"
+        "<glist><filename>";
+    ofs_ << tile_name;
+    ofs_ << 
+        "</filename></glist>\n"
+        "</basegeometry>\n";
+    for (int j = 0; j < tiling_.num_tiles[1]; j++)
+    for (int i = 0; i < tiling_.num_tiles[0]; i++) {
+
+        // Flips, with both being a rotation by 180 degrees.
+        std::uint64_t hash = 
+            hashCombine(tiling_.seed, 
+                        std::uint64_t(j) * tiling_.num_tiles[0] + i);
+        bool flip_x = hash & 1;
+        bool flip_y = hash & 2;
+
+        // Reflect about the tile center, then translate.
+        Float sx = flip_x ? -1 : 1;
+        Float sy = flip_y ? -1 : 1;
+        Float tx = tiling_.origin[0] + i * tiling_.tile_size[0] + 
+                        (flip_x ? tiling_.tile_size[0] : 0);
+        Float ty = tiling_.origin[1] + j * tiling_.tile_size[1] + 
+                        (flip_y ? tiling_.tile_size[1] : 0);
+        ofs_ << 
+            "<staticinstance>"
+            "<matrix>";
+        ofs_ << sx << ", 0, 0, " << tx << ", ";
+        ofs_ << "0, " << sy << ", 0, " << ty << ", ";
+        ofs_ << 
+            "0, 0, 1, 0, "
+            "0, 0, 0, 1"
+            "</matrix>"
+            "</staticinstance>\n";
+    }
+    ofs_ << "</object>\n";
+    ofs_ << "</geometrylist>\n";
+    ofs_.flush();
+}
+
+// Is formattable?
+bool TiledGListLeafWriter::isFormattable() const
+{
+    return tile_writer_.isFormattable();
+}
+
+// Format.
+void TiledGListLeafWriter::format(
+            const LeafDisk* leaf_disks,
+            std::size_t num_leaf_disks,
+            std::size_t first_index,
+            std::string& bytes) const
+{
+    tile_writer_.format(leaf_disks, num_leaf_disks, first_index, bytes);
+}
+
+// Write formatted.
+void TiledGListLeafWriter::writeFormatted(
+            const std::string& bytes,
+            std::size_t num_leaf_disks)
+{
+    tile_writer_.writeFormatted(bytes, num_leaf_disks);
+}
+
+// Tile filename.
+std::string TiledGListLeafWriter::tileFilename(const std::string& filename)
+{
+    std::string stem = filename;
+    pre::ci_string ci_filename = filename.c_str();
+    if (ci_filename.size() >= 6 &&
+        ci_filename.compare(ci_filename.size() - 6, 6, ".glist") == 0) {
+        stem.resize(stem.size() - 6);
+    }
+    return stem + "_tile.glist";
+}
+
+// Constructor.
+ObjLeafWriter::ObjLeafWriter(
+            const std::string& filename,
+            const LeafWriterOptions& options) :
+                ver_res_(options.ver_res),
+                relative_indices_(options.relative_indices),
+                lod_viewpoints_(options.lod_viewpoints),
+                lod_error_(options.lod_error)
+{
+    if (options.append) {
+        if (!lod_viewpoints_.empty() && !relative_indices_) {
+            throw
+                std::runtime_error(
+                std::string(__PRETTY_FUNCTION__)
+                    .append(": can't append with level of detail, "
+                            "except with relative indices"));
+        }
+        if (!std::ifstream(filename).is_open()) {
+            throw std::runtime_error(
+                  std::string("can't append to ").append(filename));
+        }
+        openOrThrow(ofs_, filename, std::ios::out | std::ios::app);
+        std::uint64_t vers_per_leaf = std::max(ver_res_, 4u) + 1;
+        ver_offset_ = options.append_num_leaves * vers_per_leaf;
+        ver_offset_begin_ = ver_offset_;
+    }
+    else {
+        openOrThrow(ofs_, filename);
+        ofs_ << "usemtl " << options.matid << "\n";
+    }
+
+    // Outline error of the area-preserving polygon, being the larger 
+    // of its vertices outside the disk and its edge midpoints inside.
+    if (!lod_viewpoints_.empty()) {
+        lod_errors_.resize(std::max(ver_res_, 4u) + 1);
+        for (unsigned int n = 4; n < lod_errors_.size(); n++) {
+            Float dphi = 2 * pre::numeric_constants<Float>::M_pi() / n;
+            Float area_fac = pre::sqrt(dphi / pre::sin(dphi));
+            lod_errors_[n] = 
+                std::max(area_fac - 1, 1 - area_fac * pre::cos(dphi / 2));
+        }
+    }
+}
+
+// Write.
+void ObjLeafWriter::write(const LeafDisk& leaf_disk)
+{
+    unsigned int ver_res = verRes(leaf_disk);
+    if (relative_indices_) {
+        leaf_disk.writeObjRelative(ofs_, ver_res);
+    }
+    else {
+        leaf_disk.writeObj(ofs_, ver_offset_, ver_res);
+    }
+    num_leaves_++;
+    num_triangles_ += std::max(ver_res, 4u);
+}
+
+// Finish.
+void ObjLeafWriter::finish()
+{
+    ofs_.flush();
+}
+
+// Check capacity.
+void ObjLeafWriter::checkCapacity(std::uint64_t num_leaf_disks) const
+{
+    // Indices are written in decimal, so the only limit is the 64-bit
+    // vertex offset, and relative indices have none.
+    if (relative_indices_) {
+        return;
+    }
+    std::uint64_t vers_per_leaf = std::max(ver_res_, 4u) + 1;
+    if (num_leaf_disks > (UINT64_MAX - ver_offset_) / vers_per_leaf) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": too many vertices for OBJ"));
+    }
+}
+
+// Is formattable?
+bool ObjLeafWriter::isFormattable() const
+{
+    return lod_viewpoints_.empty() || relative_indices_;
+}
+
+// Format.
+void ObjLeafWriter::format(
+            const LeafDisk* leaf_disks,
+            std::size_t num_leaf_disks,
+            std::size_t first_index,
+            std::string& bytes) const
+{
+    // Each leaf writes its center vertex and perimeter vertices, with 
+    // at least 4 perimeter vertices, after any existing vertices.
+    std::uint64_t vers_per_leaf = std::max(ver_res_, 4u) + 1;
+    std::uint64_t ver_offset = 
+        ver_offset_begin_ + first_index * vers_per_leaf;
+    std::ostringstream oss;
+    for (std::size_t k = 0; k < num_leaf_disks; k++) {
+        if (relative_indices_) {
+            leaf_disks[k].writeObjRelative(oss, verRes(leaf_disks[k]));
+        }
+        else {
+            leaf_disks[k].writeObj(oss, ver_offset, ver_res_);
+        }
+    }
+    bytes = oss.str();
+}
+
+// Write formatted.
+void ObjLeafWriter::writeFormatted(
+            const std::string& bytes,
+            std::size_t num_leaf_disks)
+{
+    ofs_.write(bytes.data(), bytes.size());
+    std::uint64_t vers_per_leaf = std::max(ver_res_, 4u) + 1;
+    ver_offset_ += num_leaf_disks * vers_per_leaf;
+    num_leaves_ += num_leaf_disks;
+    if (lod_viewpoints_.empty()) {
+        num_triangles_ += num_leaf_disks * (vers_per_leaf - 1);
+    }
+    else {
+        // Each leaf writes 2 lines per triangle and 1 more, at any
+        // vertex resolution.
+        std::size_t num_lines = std::count(bytes.begin(), bytes.end(), '\n');
+        num_triangles_ += (num_lines - num_leaf_disks) / 2;
+    }
+}
+
+// Vertex resolution for leaf.
+unsigned int ObjLeafWriter::verRes(const LeafDisk& leaf_disk) const
+{
+    if (lod_viewpoints_.empty()) {
+        return ver_res_;
+    }
+
+    // Angular radius from the nearest viewpoint.
+    Float dist2 = std::numeric_limits<Float>::infinity();
+    for (const Vec3<Float>& viewpoint : lod_viewpoints_) {
+        dist2 = std::min(dist2, pre::dot(
+                    leaf_disk.pos - viewpoint, 
+                    leaf_disk.pos - viewpoint));
+    }
+    Float max_error = lod_error_ * pre::sqrt(dist2) / leaf_disk.radius;
+
+    // Least vertex resolution within the error.
+    unsigned int ver_res = 4;
+    while (ver_res + 1 < lod_errors_.size() && 
+           lod_errors_[ver_res] > max_error) {
+        ver_res++;
+    }
+    return ver_res;
+}
+
+// Constructor.
+GlbLeafWriter::GlbLeafWriter(
+            const std::string& filename,
+            const LeafWriterOptions& options) :
+                options_(options)
+{
+    if (options_.append) {
+        throw
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": can't append to GLB output"));
+    }
+    openOrThrow(ofs_, filename, std::ios::out | std::ios::binary);
+    if (options_.ver_res < 4) {
+        options_.ver_res = 4;
+    }
+}
+
+// Write.
+void GlbLeafWriter::write(const LeafDisk& leaf_disk)
+{
+    // Shortest arc rotation from +Z to the normal, which suffices 
+    // since the disk is rotationally symmetric.
+    const Vec3<Float>& n = leaf_disk.normal;
+    Float q[4] = {-n[1], n[0], 0, 1 + n[2]};
+    Float q_len = pre::sqrt(q[0] * q[0] + q[1] * q[1] + q[3] * q[3]);
+    if (!(q_len > 1e-12)) {
+        // Antiparallel, rotate by pi about X.
+        q[0] = 1;
+        q[1] = 0;
+        q[3] = 0;
+        q_len = 1;
+    }
+    translations_.push_back(leaf_disk.pos[0]);
+    translations_.push_back(leaf_disk.pos[1]);
+    translations_.push_back(leaf_disk.pos[2]);
+    rotations_.push_back(q[0] / q_len);
+    rotations_.push_back(q[1] / q_len);
+    rotations_.push_back(q[2] / q_len);
+    rotations_.push_back(q[3] / q_len);
+    scales_.push_back(leaf_disk.radius);
+    scales_.push_back(leaf_disk.radius);
+    scales_.push_back(leaf_disk.radius);
+}
+
+// Check capacity.
+void GlbLeafWriter::checkCapacity(std::uint64_t num_leaf_disks) const
+{
+    // Instances take 10 floats each, and sizes are 32-bit in GLB. The
+    // mesh and JSON take well under 64KiB, so reserve that much.
+    std::uint64_t instance_size = 10 * sizeof(float);
+    std::uint64_t max_instances = 
+        (0xFFFFFFFFULL - 0x10000ULL) / instance_size;
+    std::uint64_t num_instances = scales_.size() / 3;
+    if (num_instances > max_instances ||
+        num_leaf_disks > max_instances - num_instances) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": too many leaves for GLB, which is limited "
+                        "to 4GiB"));
+    }
+}
+
+// Finish.
+void GlbLeafWriter::finish()
+{
+    // Unit disk mesh, tessellated as in LeafDisk::writeObj().
+    unsigned int ver_res = options_.ver_res;
+    Float dphi = 2 * pre::numeric_constants<Float>::M_pi() / ver_res;
+    Float area_fac = pre::sqrt(dphi / pre::sin(dphi)); // Preserve area.
+    std::vector<float> positions = {0, 0, 0};
+    std::vector<float> normals = {0, 0, 1};
+    std::vector<std::uint16_t> indices;
+    for (unsigned int j = 0; j < ver_res; j++) {
+        Float phi = j * dphi;
+        positions.push_back(area_fac * pre::cos(phi));
+        positions.push_back(area_fac * pre::sin(phi));
+        positions.push_back(0);
+        normals.push_back(0);
+        normals.push_back(0);
+        normals.push_back(1);
+        indices.push_back(0);
+        indices.push_back(1 + (j + 0) % ver_res);
+        indices.push_back(1 + (j + 1) % ver_res);
+    }
+    std::size_t num_vers = ver_res + 1;
+    std::size_t num_instances = scales_.size() / 3;
+
+    // Position bounds, from the written floats, as glTF requires.
+    float position_min[3] = {
+        +std::numeric_limits<float>::infinity(),
+        +std::numeric_limits<float>::infinity(),
+        +std::numeric_limits<float>::infinity()
+    };
+    float position_max[3] = {
+        -std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity()
+    };
+    for (std::size_t k = 0; k < positions.size(); k++) {
+        position_min[k % 3] = std::min(position_min[k % 3], positions[k]);
+        position_max[k % 3] = std::max(position_max[k % 3], positions[k]);
+    }
+
+    // Buffer views, aligned to 4 bytes.
+    struct View {
+        const void* data;
+        std::size_t size;
+        std::size_t offset;
+    };
+    View views[6] = {
+        {positions.data(), positions.size() * sizeof(float), 0},
+        {normals.data(), normals.size() * sizeof(float), 0},
+        {indices.data(), indices.size() * sizeof(std::uint16_t), 0},
+        {translations_.data(), translations_.size() * sizeof(float), 0},
+        {rotations_.data(), rotations_.size() * sizeof(float), 0},
+        {scales_.data(), scales_.size() * sizeof(float), 0}
+    };
+    // Without instances, write the mesh only, since glTF requires 
+    // nonzero accessor counts and buffer view lengths.
+    int num_views = num_instances > 0 ? 6 : 3;
+    std::size_t bin_size = 0;
+    for (int k = 0; k < num_views; k++) {
+        views[k].offset = bin_size;
+        bin_size += (views[k].size + 3) & ~std::size_t(3);
+    }
+
+    // JSON.
+    std::ostringstream json;
+    json << "{";
+    json << "\"asset\":{\"version\":\"2.0\",\"generator\":\"leaf-disk-gen\"},";
+    if (num_instances > 0) {
+        json << "\"extensionsUsed\":[\"EXT_mesh_gpu_instancing\"],";
+        json << "\"extensionsRequired\":[\"EXT_mesh_gpu_instancing\"],";
+        json << "\"scene\":0,";
+        json << "\"scenes\":[{\"nodes\":[0]}],";
+        json << "\"nodes\":[{";
+        json << "\"mesh\":0,";
+        json << "\"rotation\":[-0.70710678,0,0,0.70710678],";
+        json << "\"extensions\":{";
+        json << "\"EXT_mesh_gpu_instancing\":{\"attributes\":{";
+        json << "\"TRANSLATION\":3,\"ROTATION\":4,\"SCALE\":5}}}";
+        json << "}],";
+    }
+    else {
+        json << "\"scene\":0,";
+        json << "\"scenes\":[{}],";
+    }
+    json << "\"meshes\":[{\"primitives\":[{";
+    json << "\"attributes\":{\"POSITION\":0,\"NORMAL\":1},";
+    json << "\"indices\":2,\"material\":0";
+    json << "}]}],";
+    json << "\"materials\":[{";
+    json << "\"name\":\"" << options_.matid << "\",";
+    json << "\"doubleSided\":true,";
+    json << "\"pbrMetallicRoughness\":{";
+    json << "\"baseColorFactor\":[0.2,0.5,0.1,1],";
+    json << "\"metallicFactor\":0,\"roughnessFactor\":1}";
+    json << "}],";
+    json << "\"buffers\":[{\"byteLength\":" << bin_size << "}],";
+    json << "\"bufferViews\":[";
+    for (int k = 0; k < num_views; k++) {
+        json << (k == 0 ? "" : ",");
+        json << "{\"buffer\":0,";
+        json << "\"byteOffset\":" << views[k].offset << ",";
+        json << "\"byteLength\":" << views[k].size;
+        json << (k == 2 ? ",\"target\":34963}" : 
+                 k < 2 ? ",\"target\":34962}" : "}");
+    }
+    json << "],";
+    json << "\"accessors\":[";
+    json << "{\"bufferView\":0,\"componentType\":5126,";
+    json << "\"count\":" << num_vers << ",\"type\":\"VEC3\",";
+    json.precision(std::numeric_limits<float>::max_digits10);
+    json << "\"min\":[" << position_min[0] << "," 
+                       << position_min[1] << "," 
+                       << position_min[2] << "],";
+    json << "\"max\":[" << position_max[0] << "," 
+                       << position_max[1] << "," 
+                       << position_max[2] << "]},";
+    json.precision(6);
+    json << "{\"bufferView\":1,\"componentType\":5126,";
+    json << "\"count\":" << num_vers << ",\"type\":\"VEC3\"},";
+    json << "{\"bufferView\":2,\"componentType\":5123,";
+    json << "\"count\":" << indices.size() << ",\"type\":\"SCALAR\"}";
+    if (num_instances > 0) {
+        json << ",{\"bufferView\":3,\"componentType\":5126,";
+        json << "\"count\":" << num_instances << ",\"type\":\"VEC3\"},";
+        json << "{\"bufferView\":4,\"componentType\":5126,";
+        json << "\"count\":" << num_instances << ",\"type\":\"VEC4\"},";
+        json << "{\"bufferView\":5,\"componentType\":5126,";
+        json << "\"count\":" << num_instances << ",\"type\":\"VEC3\"}";
+    }
+    json << "]";
+    json << "}";
+    std::string json_str = json.str();
+    while (json_str.size() % 4 != 0) {
+        json_str.push_back(' ');
+    }
+
+    // Sizes are 32-bit in GLB.
+    std::size_t total_size = 12 + 8 + json_str.size() + 8 + bin_size;
+    if (total_size > 0xFFFFFFFFULL) {
+        throw 
+            std::runtime_error(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": too many leaves for GLB, which is limited "
+                        "to 4GiB"));
+    }
+
+    // Write, assuming little endian host.
+    auto writeU32 = [&](std::uint32_t value) {
+        ofs_.write(reinterpret_cast<const char*>(&value), 4);
+    };
+    writeU32(0x46546C67); // "glTF"
+    writeU32(2);
+    writeU32(total_size);
+    writeU32(json_str.size());
+    writeU32(0x4E4F534A); // "JSON"
+    ofs_.write(json_str.data(), json_str.size());
+    writeU32(bin_size);
+    writeU32(0x004E4942); // "BIN"
+    for (int k = 0; k < num_views; k++) {
+        static const char zeros[4] = {};
+        const View& view = views[k];
+        ofs_.write(static_cast<const char*>(view.data), view.size);
+        ofs_.write(zeros, ((view.size + 3) & ~std::size_t(3)) - view.size);
+    }
+    ofs_.flush();
+}
+
+} // namespace ld
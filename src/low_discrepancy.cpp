@@ -0,0 +1,219 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <preform/misc_string.hpp>
+#include <leaf-disk-gen/low_discrepancy.hpp>
+
+namespace ld {
+
+namespace {
+
+// Halton bases, being the first primes.
+const int halton_bases[LowDiscrepancySequence::max_dims] = {
+    2, 3, 5, 7, 11, 13, 17, 19
+};
+
+// Number of digits in base to resolve double precision.
+int haltonNumDigits(int base)
+{
+    return int(std::ceil(53 / std::log2(Float(base))));
+}
+
+// Sobol generator matrices, from Joe-Kuo direction numbers.
+struct SobolMatrices
+{
+    std::uint32_t columns[LowDiscrepancySequence::max_dims][32];
+
+    SobolMatrices()
+    {
+        // Degree, coefficients, and initial direction numbers of 
+        // primitive polynomials, for dimensions after the first.
+        struct Poly {
+            int s;
+            std::uint32_t a;
+            std::uint32_t m[5];
+        };
+        const Poly polys[LowDiscrepancySequence::max_dims - 1] = {
+            {1, 0, {1}},
+            {2, 1, {1, 3}},
+            {3, 1, {1, 3, 1}},
+            {3, 2, {1, 1, 1}},
+            {4, 1, {1, 1, 3, 3}},
+            {4, 4, {1, 3, 5, 13}},
+            {5, 2, {1, 1, 5, 5, 17}}
+        };
+
+        // First dimension is van der Corput.
+        for (int k = 0; k < 32; k++) {
+            columns[0][k] = std::uint32_t(1) << (31 - k);
+        }
+        for (int dim = 1; dim < LowDiscrepancySequence::max_dims; dim++) {
+            const Poly& poly = polys[dim - 1];
+            std::uint32_t m[32];
+            for (int k = 0; k < 32; k++) {
+                if (k < poly.s) {
+                    m[k] = poly.m[k];
+                }
+                else {
+                    // Recurrence m_k = 2^s m_{k-s} ^ m_{k-s} ^ 
+                    // sum_j 2^j a_j m_{k-j}.
+                    m[k] = (m[k - poly.s] << poly.s) ^ m[k - poly.s];
+                    for (int j = 1; j < poly.s; j++) {
+                        if ((poly.a >> (poly.s - 1 - j)) & 1) {
+                            m[k] ^= m[k - j] << j;
+                        }
+                    }
+                }
+                columns[dim][k] = m[k] << (31 - k);
+            }
+        }
+    }
+};
+
+// Sobol generator matrices, initialized once.
+const SobolMatrices& sobolMatrices()
+{
+    static const SobolMatrices matrices;
+    return matrices;
+}
+
+// Reverse bits.
+std::uint32_t reverseBits(std::uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+    x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+    x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Nested uniform scramble, by a Laine-Karras style hash on reversed 
+// bits, such that each bit is flipped depending only on higher bits.
+std::uint32_t nestedUniformScramble(std::uint32_t x, std::uint32_t seed)
+{
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6C50B47CU;
+    x ^= x * 0xB82F1E52U;
+    x ^= x * 0xC7AFE638U;
+    x ^= x * 0x8D22F6E6U;
+    return reverseBits(x);
+}
+
+} // namespace
+
+// Constructor.
+LowDiscrepancySequence::LowDiscrepancySequence(
+            Type type, std::uint64_t seed) : type_(type)
+{
+    for (int dim = 0; dim < max_dims; dim++) {
+        std::uint64_t dim_seed = hashCombine(seed, dim);
+        sobol_seeds_[dim] = std::uint32_t(dim_seed);
+        if (type_ == eTypeHalton) {
+            int base = halton_bases[dim];
+            int num_digits = haltonNumDigits(base);
+            Pcg32 pcg(dim_seed);
+            for (int digit = 0; digit < num_digits; digit++) {
+                // Fisher-Yates shuffle.
+                std::vector<std::uint16_t> perm(base);
+                for (int k = 0; k < base; k++) {
+                    perm[k] = k;
+                }
+                for (int k = base - 1; k > 0; k--) {
+                    int l = std::min(int(generateCanonical(pcg) * (k + 1)), k);
+                    std::swap(perm[k], perm[l]);
+                }
+                halton_perms_.push_back(perm);
+            }
+        }
+    }
+}
+
+// Generate canonical number.
+Float LowDiscrepancySequence::generate(std::uint32_t index, int dim) const
+{
+    assert(dim >= 0 && dim < max_dims);
+    if (type_ == eTypeSobol) {
+        std::uint32_t x = 0;
+        for (int k = 0; index != 0; index >>= 1, k++) {
+            if (index & 1) {
+                x ^= sobolMatrices().columns[dim][k];
+            }
+        }
+        return nestedUniformScramble(x, sobol_seeds_[dim]) * 0x1p-32;
+    }
+    else {
+        // Permutations for earlier dimensions come first.
+        std::size_t perm_offset = 0;
+        for (int d = 0; d < dim; d++) {
+            perm_offset += haltonNumDigits(halton_bases[d]);
+        }
+
+        // Scrambled radical inverse, over all digits including the
+        // trailing zeros, since permuted zeros need not be zero.
+        int base = halton_bases[dim];
+        int num_digits = haltonNumDigits(base);
+        Float inv_base = Float(1) / base;
+        Float inv_base_k = inv_base;
+        Float x = 0;
+        for (int digit = 0; digit < num_digits; digit++) {
+            int value = index % base;
+            index /= base;
+            x += halton_perms_[perm_offset + digit][value] * inv_base_k;
+            inv_base_k *= inv_base;
+        }
+        return std::min(x, Float(1) - 
+                           std::numeric_limits<Float>::epsilon() / 2);
+    }
+}
+
+// Type from string.
+LowDiscrepancySequence::Type 
+LowDiscrepancySequence::typeFromString(const std::string& str)
+{
+    pre::ci_string ci_str = str.c_str();
+    if (ci_str == "sobol") {
+        return eTypeSobol;
+    }
+    else 
+    if (ci_str == "halton") {
+        return eTypeHalton;
+    }
+    else {
+        throw
+            std::invalid_argument(
+            std::string(__PRETTY_FUNCTION__)
+                .append(": unknown type ").append(str));
+    }
+}
+
+} // namespace ld
@@ -26,32 +26,103 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 /*+-+*/
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <memory>
+#include <type_traits>
+#include <variant>
 #include <preform/aabb.hpp>
 #include <preform/misc_string.hpp>
 #include <preform/option_parser.hpp>
 #include <preform/medium.hpp>
 #include <leaf-disk-gen/common.hpp>
+#include <leaf-disk-gen/canopy_analysis.hpp>
+#include <leaf-disk-gen/gap_fraction.hpp>
 #include <leaf-disk-gen/leaf_angle_distribution.hpp>
+#include <leaf-disk-gen/leaf_area_density.hpp>
+#include <leaf-disk-gen/leaf_cells.hpp>
+#include <leaf-disk-gen/leaf_clumping.hpp>
 #include <leaf-disk-gen/leaf_disk.hpp>
+#include <leaf-disk-gen/leaf_exclusion.hpp>
+#include <leaf-disk-gen/leaf_flutter.hpp>
+#include <leaf-disk-gen/leaf_inventory.hpp>
+#include <leaf-disk-gen/leaf_merge.hpp>
+#include <leaf-disk-gen/leaf_pipeline.hpp>
+#include <leaf-disk-gen/leaf_reader.hpp>
+#include <leaf-disk-gen/leaf_sort.hpp>
+#include <leaf-disk-gen/leaf_volume.hpp>
+#include <leaf-disk-gen/leaf_writer.hpp>
+#include <leaf-disk-gen/low_discrepancy.hpp>
+#include <leaf-disk-gen/trace.hpp>
 
 int main(int argc, char** argv)
 {
     using namespace ld;
 
+    // Has extension, case-insensitively?
+    auto hasExtension = [](const pre::ci_string& filename, const char* ext) {
+        std::size_t len = std::strlen(ext);
+        return filename.size() >= len &&
+               filename.compare(filename.size() - len, len, ext) == 0;
+    };
+
     pre::option_parser opt_parser(
-        "desc [OPTIONS] [<box> [BOX-OPTIONS]|<sphere> [SPHERE-OPTIONS]]...");
+        "desc [OPTIONS] [<box> [BOX-OPTIONS]|<sphere> [SPHERE-OPTIONS]|"
+        "<forest> [FOREST-OPTIONS]]... [<query> [QUERY-OPTIONS]]");
 
     int seed = 0;
     int matid = 100;
     Float lai = 1;
     Float radius = 0.05;
+    std::string ifs_filename;
+    std::vector<std::string> merge_filenames;
+    std::string split_filename;
+    LeafSplitOptions split_options;
     std::string ofs_filename = "leaf.glist";
     std::string angle_distribution_args = "Uniform";
+    bool sampler_random = true;
+    LowDiscrepancySequence::Type sampler_type = 
+        LowDiscrepancySequence::eTypeSobol;
+    Float clumping_index = 1;
+    Float cluster_radius = 0.25;
+    std::vector<std::string> exclusion_filenames;
+    Float exclusion_clearance = 0;
+    std::vector<std::string> inventory_filenames;
 
-    unsigned int obj_ver_offset = 0;
     unsigned int obj_ver_res = 6;
-    bool is_glist = true;
+    Float output_cell_size = 0;
+    std::vector<Vec3<Float>> output_lod_viewpoints;
+    Float output_lod_error = 0.01;
+    bool output_relative = false;
+    Float tile_size = 0;
+    bool output_sort = false;
+    std::size_t output_sort_memory = 1024;
+    bool output_sort_packed = false;
+    std::string flutter_filename;
+    std::size_t flutter_num_frames = 100;
+    Float flutter_frame_time = 1 / Float(30);
+    Float flutter_amplitude = 10;
+    Float flutter_frequency = 2;
+
+    unsigned int num_threads = 0;
+    bool pipeline = false;
+    bool progressive = false;
+    Float progressive_from = -1;
+    Float procedural_cell_size = 0;
+    bool query = false;
+    pre::aabb3<Float> query_bounds = {
+        Vec3<Float>{0, 0, 0},
+        Vec3<Float>{1, 1, 1}
+    };
+    std::string analysis_filename;
+    int analysis_num_zenith = 10;
+    int analysis_num_azimuth = 12;
+    std::string gap_fraction_filename;
+    GapFractionAnalysis gap_fraction;
+    std::string voxel_filename;
+    LeafAreaDensityGrid voxel_grid;
+    std::string trace_filename;
 
     // -s/--seed
     opt_parser.on_option("-s", "--seed", 1,
@@ -108,49 +179,770 @@ int main(int argc, char** argv)
     opt_parser.on_option("-r", "--radius", 1,
     [&](char** argv) {
         try {
-            radius = std::stod(argv[0]);
-            if (!(radius > 0)) {
+            radius = std::stod(argv[0]);
+            if (!(radius > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw 
+                std::runtime_error(
+                std::string("-r/--radius expects 1 positive float ")
+                    .append("(can't parse ").append(argv[0]).append(")")); 
+        }
+    })
+    << "Specify leaf radius in meters. By default, 0.05.\n";
+
+    // -sa/--sampler
+    opt_parser.on_option("-sa", "--sampler", 1,
+    [&](char** argv) {
+        try {
+            pre::ci_string ci_name = argv[0];
+            if (ci_name == "random") {
+                sampler_random = true;
+            }
+            else {
+                sampler_random = false;
+                sampler_type = 
+                    LowDiscrepancySequence::typeFromString(argv[0]);
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-sa/--sampler expects either \"random\", ")
+                    .append("\"sobol\", or \"halton\" (can't parse ")
+                    .append(argv[0]).append(")"));
+        }
+    })
+    << "Specify sampler for leaf positions and normals, either \"random\"\n"
+       "for pseudo-random numbers, or \"sobol\" or \"halton\" for a\n"
+       "scrambled low-discrepancy sequence, which stratifies leaves\n"
+       "over space and angle for lower variance at a fixed number of\n"
+       "leaves, up to 2^32 leaves per volume. By default, \"random\".\n";
+
+    // -ci/--clumping-index
+    opt_parser.on_option("-ci", "--clumping-index", 1,
+    [&](char** argv) {
+        try {
+            clumping_index = std::stod(argv[0]);
+            if (!(clumping_index > 0 && clumping_index <= 1)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-ci/--clumping-index expects 1 float in ")
+                    .append("(0, 1] (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify target clumping index. If less than 1, leaves are placed\n"
+       "in Gaussian clusters (a Thomas process) instead of uniformly,\n"
+       "with the number of leaves per cluster calibrated such that the\n"
+       "nadir gap fraction is exp(-G * clumping index * LAI). LAI is\n"
+       "unchanged. By default, 1.\n";
+
+    // -cr/--cluster-radius
+    opt_parser.on_option("-cr", "--cluster-radius", 1,
+    [&](char** argv) {
+        try {
+            cluster_radius = std::stod(argv[0]);
+            if (!(cluster_radius > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-cr/--cluster-radius expects 1 positive ")
+                    .append("float (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify cluster radius in meters, being the standard deviation\n"
+       "of leaf offsets from cluster centers. This only has an effect\n"
+       "if the clumping index is less than 1. By default, 0.25.\n";
+
+    // -x/--exclude
+    opt_parser.on_option("-x", "--exclude", 1,
+    [&](char** argv) {
+        pre::ci_string ci_exclusion_filename = argv[0];
+        if (!hasExtension(ci_exclusion_filename, ".obj")) {
+            throw std::runtime_error(
+                  "-x/--exclude filename must end with \".obj\"");
+        }
+        exclusion_filenames.push_back(argv[0]);
+    })
+    << "Specify exclusion mesh filename, such as of a trunk and branches.\n"
+       "Leaves intersecting the mesh, within the exclusion clearance of\n"
+       "it, or inside it if closed, are resampled. This may be repeated.\n"
+       "Not compatible with -t/--tile. By default, no exclusion.\n";
+
+    // -xc/--exclude-clearance
+    opt_parser.on_option("-xc", "--exclude-clearance", 1,
+    [&](char** argv) {
+        try {
+            exclusion_clearance = std::stod(argv[0]);
+            if (!(exclusion_clearance >= 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-xc/--exclude-clearance expects 1 ")
+                    .append("non-negative float (can't parse ")
+                    .append(argv[0]).append(")"));
+        }
+    })
+    << "Specify exclusion clearance in meters, being the least distance\n"
+       "from leaves to exclusion meshes. By default, 0.\n";
+
+    // -i/--input
+    opt_parser.on_option("-i", "--input", 1,
+    [&](char** argv) {
+        ifs_filename = argv[0];
+        pre::ci_string ci_ifs_filename = argv[0];
+        if (!hasExtension(ci_ifs_filename, ".glist") &&
+            !hasExtension(ci_ifs_filename, ".obj")) {
+            throw std::runtime_error(
+                  "-i/--input filename must end "
+                  "with either \".glist\" or \".obj\"");
+        }
+    })
+    << "Specify input filename, to read leaves from existing output\n"
+       "instead of generating them, e.g., to convert formats or to\n"
+       "analyze. This must end in either \".glist\" or \".obj\", and\n"
+       "differ from the output filename. Volumes, if any, then only\n"
+       "determine ground area and bounds. This requires no tiling,\n"
+       "pipeline, progressive generation, or procedural cells. By\n"
+       "default, no input.\n";
+
+    // -mg/--merge
+    opt_parser.on_option("-mg", "--merge", 1,
+    [&](char** argv) {
+        merge_filenames.push_back(argv[0]);
+    })
+    << "Specify filename of existing output to merge into the output,\n"
+       "instead of generating. This may be repeated, and inputs must be\n"
+       "of the same format as the output, either GList or OBJ. GList\n"
+       "objects are streamed as they are, and OBJ face indices are\n"
+       "offset by the vertices of preceding inputs. By default, no\n"
+       "merge.\n";
+
+    // -sp/--split
+    opt_parser.on_option("-sp", "--split", 1,
+    [&](char** argv) {
+        split_filename = argv[0];
+    })
+    << "Specify filename of existing output to split into parts,\n"
+       "instead of generating. Parts are named by appending their names\n"
+       "to the output filename before the extension, and must be of the\n"
+       "same format as the input, either GList or OBJ. This requires\n"
+       "exactly one of -sn/--split-count and -sc/--split-cell-size. By\n"
+       "default, no split.\n";
+
+    // -sn/--split-count
+    opt_parser.on_option("-sn", "--split-count", 1,
+    [&](char** argv) {
+        try {
+            split_options.count = std::stoull(argv[0]);
+            if (!(split_options.count > 0) || argv[0][0] == '-') {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-sn/--split-count expects 1 positive ")
+                    .append("integer (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify number of leaves per part, to split into consecutive\n"
+       "runs of leaves named by index. By default, none.\n";
+
+    // -sc/--split-cell-size
+    opt_parser.on_option("-sc", "--split-cell-size", 1,
+    [&](char** argv) {
+        try {
+            split_options.cell_size = std::stod(argv[0]);
+            if (!(split_options.cell_size > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-sc/--split-cell-size expects 1 positive ")
+                    .append("float (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify cell size in meters, to split into square cells in XY\n"
+       "of a grid anchored at the origin, named by cell indices, e.g.,\n"
+       "\"_-1_2\". By default, none.\n";
+
+    // -o/--output
+    opt_parser.on_option("-o", "--output", 1,
+    [&](char** argv) {
+        ofs_filename = argv[0];
+    })
+    << "Specify output filename. This must end in either \".glist\",\n"
+       "\".obj\", or \".glb\". By default, \"leaf.glist\".\n";
+
+    // -ov/--output-ver-res
+    opt_parser.on_option("-ov", "--output-ver-res", 1,
+    [&](char** argv) {
+        try {
+            obj_ver_res = std::stoi(argv[0]);
+            if (obj_ver_res < 4 || 
+                obj_ver_res > 32) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-ov/--output-ver-res expects 1 integer in ")
+                    .append("[4, 32] (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify output vertex resolution, being the number of vertices\n"
+       "generated on the perimeter of each disk. This only affects OBJ\n"
+       "and GLB output, since GList output has a proper disk primitive.\n"
+       "By default, 6.\n";
+
+    // -oc/--output-cell-size
+    opt_parser.on_option("-oc", "--output-cell-size", 1,
+    [&](char** argv) {
+        try {
+            output_cell_size = std::stod(argv[0]);
+            if (!(output_cell_size > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-oc/--output-cell-size expects 1 positive ")
+                    .append("float (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify output cell size in meters. If present, leaves are\n"
+       "bucketed into a grid of cells of this size, and each cell is\n"
+       "written as its own object. This only affects GList output.\n"
+       "By default, no bucketing.\n";
+
+    // -ol/--output-lod
+    opt_parser.on_option("-ol", "--output-lod", 1,
+    [&](char** argv) {
+        Vec3<Float> viewpoint;
+        std::stringstream sstr(argv[0]);
+        sstr >> viewpoint;
+        if (!sstr.good()) {
+            throw std::runtime_error(
+                    "-ol/--output-lod expects a 3-dimensional coordinate "
+                    "as a string, e.g., \"[1, 2, 3]\"");
+        }
+        output_lod_viewpoints.push_back(viewpoint);
+    })
+    << "Specify output level-of-detail viewpoint, which may be given\n"
+       "more than once. If present, each leaf is tessellated with the\n"
+       "least vertex resolution, up to the output vertex resolution,\n"
+       "whose outline error from the nearest viewpoint is within the\n"
+       "output level-of-detail error, and the triangle count is\n"
+       "reported. This only affects OBJ output. By default, none.\n";
+
+    // -oe/--output-lod-error
+    opt_parser.on_option("-oe", "--output-lod-error", 1,
+    [&](char** argv) {
+        try {
+            output_lod_error = std::stod(argv[0]);
+            if (!(output_lod_error > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-oe/--output-lod-error expects 1 positive ")
+                    .append("float (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify output level-of-detail angular error in degrees, e.g.,\n"
+       "a fraction of the sensor pixel field of view. By default, 0.01.\n";
+
+    // -or/--output-relative
+    opt_parser.on_option("-or", "--output-relative", 0,
+    [&](char**) {
+        output_relative = true;
+    })
+    << "Write OBJ faces with relative (negative) vertex indices, such\n"
+       "that each leaf's text doesn't depend on the leaves before it.\n"
+       "This lets -p/--pipeline format output with level of detail in\n"
+       "parallel, and lets -pf/--progressive-from append to it.\n";
+
+    // -t/--tile
+    opt_parser.on_option("-t", "--tile", 1,
+    [&](char** argv) {
+        try {
+            tile_size = std::stod(argv[0]);
+            if (!(tile_size > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-t/--tile expects 1 positive float ")
+                    .append("(can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify tile size in meters. If present, generate leaves for one\n"
+       "periodic tile only, and instance it across the box with random\n"
+       "flips per tile. The tile size is adjusted to divide the box\n"
+       "evenly in X and Y. This requires exactly one box and GList\n"
+       "output, and writes the tile next to the output, with the suffix\n"
+       "\"_tile.glist\". By default, no tiling.\n";
+
+    // -os/--output-sort
+    opt_parser.on_option("-os", "--output-sort", 1,
+    [&](char** argv) {
+        pre::ci_string ci_name = argv[0];
+        if (ci_name == "none") {
+            output_sort = false;
+        }
+        else if (ci_name == "morton") {
+            output_sort = true;
+        }
+        else {
+            throw std::runtime_error(
+                  "-os/--output-sort expects either \"none\" or \"morton\"");
+        }
+    })
+    << "Specify output sort order, either \"none\" to write leaves in\n"
+       "generation order, or \"morton\" to write leaves in Morton order\n"
+       "of their positions, such that nearby leaves are nearby in the\n"
+       "output. By default, \"none\".\n";
+
+    // -om/--output-sort-memory
+    opt_parser.on_option("-om", "--output-sort-memory", 1,
+    [&](char** argv) {
+        try {
+            long long value = std::stoll(argv[0]);
+            if (!(value > 0)) {
+                throw std::exception();
+            }
+            output_sort_memory = value;
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-om/--output-sort-memory expects 1 positive ")
+                    .append("integer (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify output sort memory limit in megabytes. If sorting would\n"
+       "exceed this, sorted runs are spilled to temporary files and\n"
+       "merged. This also limits the buffer for bucketing with -oc, over\n"
+       "which cells are gathered in passes. By default, 1024.\n";
+
+    // -op/--output-sort-packed
+    opt_parser.on_option("-op", "--output-sort-packed", 0,
+    [&](char**) {
+        output_sort_packed = true;
+    })
+    << "Buffer leaves for output sorting in a packed 16-byte form instead\n"
+       "of 56 bytes, fitting several times more leaves in memory before\n"
+       "spilling. This quantizes positions to 21 bits per axis over the\n"
+       "bounds of all volumes, normals to 32-bit octahedral (within\n"
+       "0.004 degrees), and radii to half precision (within a relative\n"
+       "2^-11).\n";
+
+    // -f/--flutter
+    opt_parser.on_option("-f", "--flutter", 1,
+    [&](char** argv) {
+        flutter_filename = argv[0];
+    })
+    << "Specify flutter filename. If present, leaves are written once as\n"
+       "usual, and their normals are perturbed over time by a per-leaf\n"
+       "oscillation and written for each frame to this binary file, at\n"
+       "4 bytes per leaf per frame, in the order leaves are written. See\n"
+       "FlutterLeafWriter for the format. This is incompatible with -oc.\n"
+       "By default, no flutter.\n";
+
+    // -fn/--flutter-frames
+    opt_parser.on_option("-fn", "--flutter-frames", 1,
+    [&](char** argv) {
+        try {
+            long long value = std::stoll(argv[0]);
+            if (!(value > 0)) {
+                throw std::exception();
+            }
+            flutter_num_frames = value;
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-fn/--flutter-frames expects 1 positive ")
+                    .append("integer (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify number of flutter frames. By default, 100.\n";
+
+    // -ft/--flutter-frame-time
+    opt_parser.on_option("-ft", "--flutter-frame-time", 1,
+    [&](char** argv) {
+        try {
+            flutter_frame_time = std::stod(argv[0]);
+            if (!(flutter_frame_time > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-ft/--flutter-frame-time expects 1 positive ")
+                    .append("float (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify flutter frame time in seconds. By default, 1/30.\n";
+
+    // -fa/--flutter-amplitude
+    opt_parser.on_option("-fa", "--flutter-amplitude", 1,
+    [&](char** argv) {
+        try {
+            flutter_amplitude = std::stod(argv[0]);
+            if (!(flutter_amplitude >= 0 && flutter_amplitude < 90)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-fa/--flutter-amplitude expects 1 float ")
+                    .append("in [0, 90) (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify flutter tilt amplitude in degrees, about each tangent\n"
+       "axis of the leaf. By default, 10.\n";
+
+    // -ff/--flutter-frequency
+    opt_parser.on_option("-ff", "--flutter-frequency", 1,
+    [&](char** argv) {
+        try {
+            flutter_frequency = std::stod(argv[0]);
+            if (!(flutter_frequency >= 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-ff/--flutter-frequency expects 1 ")
+                    .append("non-negative float (can't parse ")
+                    .append(argv[0]).append(")"));
+        }
+    })
+    << "Specify mean flutter frequency in hertz. Each leaf oscillates\n"
+       "at a random frequency within 25 percent of this, with random\n"
+       "phase. By default, 2.\n";
+
+    // -j/--threads
+    opt_parser.on_option("-j", "--threads", 1,
+    [&](char** argv) {
+        try {
+            int value = std::stoi(argv[0]);
+            if (!(value >= 0)) {
+                throw std::exception();
+            }
+            num_threads = value;
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-j/--threads expects 1 non-negative integer ")
+                    .append("(can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify number of worker threads, or 0 to use all hardware\n"
+       "threads. By default, 0.\n";
+
+    // -p/--pipeline
+    opt_parser.on_option("-p", "--pipeline", 0,
+    [&](char**) {
+        pipeline = true;
+    })
+    << "Generate leaves in batches on worker threads, formatting output\n"
+       "while the main thread writes, instead of alternating between\n"
+       "generating and writing. Each batch is seeded independently, so\n"
+       "output does not depend on the number of threads, but differs\n"
+       "from output without this option.\n";
+
+    // -pg/--progressive
+    opt_parser.on_option("-pg", "--progressive", 0,
+    [&](char**) {
+        progressive = true;
+    })
+    << "Seed each leaf from its index in its volume, so that leaf k is\n"
+       "identical regardless of LAI, and lower LAI canopies are nested\n"
+       "in higher LAI canopies. This requires no clumping, and output\n"
+       "differs from output without this option.\n";
+
+    // -pf/--progressive-from
+    opt_parser.on_option("-pf", "--progressive-from", 1,
+    [&](char** argv) {
+        try {
+            progressive_from = std::stod(argv[0]);
+            if (!(progressive_from >= 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-pf/--progressive-from expects 1 ")
+                    .append("non-negative float (can't parse ")
+                    .append(argv[0]).append(")"));
+        }
+    })
+    << "Specify LAI of existing progressive output to append to. If\n"
+       "present, only leaves beyond those at this LAI are generated,\n"
+       "and appended to the output, which must have been written by\n"
+       "the same command at this LAI. This requires -pg/--progressive,\n"
+       "and GList output without bucketing, or OBJ output without level\n"
+       "of detail. Analyses then cover only the appended leaves. By\n"
+       "default, no appending.\n";
+
+    // -pc/--procedural-cell-size
+    opt_parser.on_option("-pc", "--procedural-cell-size", 1,
+    [&](char** argv) {
+        try {
+            procedural_cell_size = std::stod(argv[0]);
+            if (!(procedural_cell_size > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-pc/--procedural-cell-size expects 1 ")
+                    .append("positive float (can't parse ")
+                    .append(argv[0]).append(")"));
+        }
+    })
+    << "Specify procedural cell size in meters. If present, leaves are\n"
+       "generated per cell of a square grid over each volume in XY,\n"
+       "seeded by cell, so that a query generates only the cells it\n"
+       "overlaps. This requires the random sampler without clumping,\n"
+       "and output differs from output without this option. By\n"
+       "default, no procedural cells.\n";
+
+    // -a/--analyze
+    opt_parser.on_option("-a", "--analyze", 1,
+    [&](char** argv) {
+        analysis_filename = argv[0];
+        pre::ci_string ci_analysis_filename = argv[0];
+        if (!hasExtension(ci_analysis_filename, ".json") &&
+            !hasExtension(ci_analysis_filename, ".csv")) {
+            throw std::runtime_error(
+                  "-a/--analyze filename must end "
+                  "with either \".json\" or \".csv\"");
+        }
+    })
+    << "Specify analysis filename, to compute the G-function and\n"
+       "projected leaf area of the generated leaves over a grid of\n"
+       "directions, along with the achieved LAI. This must end in\n"
+       "either \".json\" or \".csv\". By default, no analysis.\n";
+
+    // -az/--analyze-zenith
+    opt_parser.on_option("-az", "--analyze-zenith", 1,
+    [&](char** argv) {
+        try {
+            analysis_num_zenith = std::stoi(argv[0]);
+            if (!(analysis_num_zenith > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-az/--analyze-zenith expects 1 positive ")
+                    .append("integer (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify number of analysis zenith angles, evenly spaced from\n"
+       "0 to 90 degrees inclusive. By default, 10.\n";
+
+    // -aa/--analyze-azimuth
+    opt_parser.on_option("-aa", "--analyze-azimuth", 1,
+    [&](char** argv) {
+        try {
+            analysis_num_azimuth = std::stoi(argv[0]);
+            if (!(analysis_num_azimuth > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-aa/--analyze-azimuth expects 1 positive ")
+                    .append("integer (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify number of analysis azimuth angles, evenly spaced from\n"
+       "0 to 360 degrees exclusive. By default, 12.\n";
+
+    // -g/--gap-fraction
+    opt_parser.on_option("-g", "--gap-fraction", 1,
+    [&](char** argv) {
+        gap_fraction_filename = argv[0];
+        pre::ci_string ci_gap_fraction_filename = argv[0];
+        if (!hasExtension(ci_gap_fraction_filename, ".json") &&
+            !hasExtension(ci_gap_fraction_filename, ".csv")) {
+            throw std::runtime_error(
+                  "-g/--gap-fraction filename must end "
+                  "with either \".json\" or \".csv\"");
+        }
+    })
+    << "Specify gap fraction filename, to ray cast the generated leaves\n"
+       "and compare the directional gap fraction of each volume against\n"
+       "the Beer-Lambert prediction. This must end in either \".json\"\n"
+       "or \".csv\". By default, no gap fraction analysis.\n";
+
+    // -gz/--gap-zenith
+    opt_parser.on_option("-gz", "--gap-zenith", 1,
+    [&](char** argv) {
+        try {
+            gap_fraction.num_zenith = std::stoi(argv[0]);
+            if (!(gap_fraction.num_zenith > 0)) {
+                throw std::exception();
+            }
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-gz/--gap-zenith expects 1 positive ")
+                    .append("integer (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify number of gap fraction zenith angles, evenly spaced\n"
+       "from 0 to 80 degrees inclusive. By default, 9.\n";
+
+    // -gr/--gap-rays
+    opt_parser.on_option("-gr", "--gap-rays", 1,
+    [&](char** argv) {
+        try {
+            long long value = std::stoll(argv[0]);
+            if (!(value > 0)) {
+                throw std::exception();
+            }
+            gap_fraction.num_rays = value;
+        }
+        catch (const std::exception&) {
+            throw
+                std::runtime_error(
+                std::string("-gr/--gap-rays expects 1 positive ")
+                    .append("integer (can't parse ").append(argv[0])
+                    .append(")"));
+        }
+    })
+    << "Specify number of gap fraction rays per volume per zenith\n"
+       "angle. By default, 100000.\n";
+
+    // -v/--voxel
+    opt_parser.on_option("-v", "--voxel", 1,
+    [&](char** argv) {
+        voxel_filename = argv[0];
+        pre::ci_string ci_voxel_filename = argv[0];
+        if (!hasExtension(ci_voxel_filename, ".nrrd")) {
+            throw std::runtime_error(
+                  "-v/--voxel filename must end with \".nrrd\"");
+        }
+    })
+    << "Specify voxel filename, to write the leaf area density of the\n"
+       "generated leaves on a voxel grid over the volumes, padded by\n"
+       "whole voxels covering the largest leaf radius, for turbid\n"
+       "medium models. This must end in \".nrrd\". By default, no\n"
+       "voxel grid.\n";
+
+    // -vs/--voxel-size
+    opt_parser.on_option("-vs", "--voxel-size", 1,
+    [&](char** argv) {
+        try {
+            voxel_grid.voxel_size = std::stod(argv[0]);
+            if (!(voxel_grid.voxel_size > 0)) {
                 throw std::exception();
             }
         }
         catch (const std::exception&) {
-            throw 
+            throw
                 std::runtime_error(
-                std::string("-r/--radius expects 1 positive float ")
-                    .append("(can't parse ").append(argv[0]).append(")")); 
+                std::string("-vs/--voxel-size expects 1 positive float ")
+                    .append("(can't parse ").append(argv[0])
+                    .append(")"));
         }
     })
-    << "Specify leaf radius in meters. By default, 0.05.\n";
-
-    // -o/--output
-    opt_parser.on_option("-o", "--output", 1,
-    [&](char** argv) {
-        ofs_filename = argv[0];
-    })
-    << "Specify output filename. By default, \"leaf.glist\".\n";
+    << "Specify voxel size in meters, adjusted to divide the volumes\n"
+       "evenly. By default, 0.1.\n";
 
-    // -ov/--output-ver-res
-    opt_parser.on_option("-ov", "--output-ver-res", 1,
+    // -vn/--voxel-samples
+    opt_parser.on_option("-vn", "--voxel-samples", 1,
     [&](char** argv) {
         try {
-            obj_ver_res = std::stoi(argv[0]);
-            if (obj_ver_res < 4 || 
-                obj_ver_res > 32) {
+            voxel_grid.num_samples = std::stoi(argv[0]);
+            if (!(voxel_grid.num_samples > 0)) {
                 throw std::exception();
             }
         }
         catch (const std::exception&) {
             throw
                 std::runtime_error(
-                std::string("-ov/--output-ver-res expects 1 integer in ")
-                    .append("[4, 32] (can't parse ").append(argv[0])
+                std::string("-vn/--voxel-samples expects 1 positive ")
+                    .append("integer (can't parse ").append(argv[0])
                     .append(")"));
         }
     })
-    << "Specify output vertex resolution, being the number of vertices\n"
-       "generated on the perimeter of each disk. This only affects OBJ\n"
-       "output, since GList output has a proper disk primitive.\n"
-       "By default, 6.\n";
+    << "Specify number of samples per leaf for voxelization, rounded up\n"
+       "to a square. By default, 64.\n";
+
+    // -vm/--voxel-moments
+    opt_parser.on_option("-vm", "--voxel-moments", 0,
+    [&](char**) {
+        voxel_grid.moments = true;
+    })
+    << "Also write the area-weighted mean leaf normal and mean normal\n"
+       "outer product per voxel, with normals flipped to the upper\n"
+       "hemisphere, for 10 channels instead of 1.\n";
+
+    // -tr/--trace
+    opt_parser.on_option("-tr", "--trace", 1,
+    [&](char** argv) {
+        trace_filename = argv[0];
+        pre::ci_string ci_trace_filename = argv[0];
+        if (!hasExtension(ci_trace_filename, ".json")) {
+            throw std::runtime_error(
+                  "-tr/--trace filename must end with \".json\"");
+        }
+    })
+    << "Specify trace filename, to record a timeline of sampling,\n"
+       "formatting, writing, and waiting per thread, in Chrome trace\n"
+       "JSON for Perfetto or chrome://tracing. By default, no trace.\n";
 
     // -h/--help
     opt_parser.on_option("-h", "--help", 0,
@@ -166,58 +958,86 @@ int main(int argc, char** argv)
         angle_distribution_args = argv;
     });
 
-    std::ofstream ofs;
+    LeafWriterOptions writer_options;
+    std::unique_ptr<LeafWriter> writer;
+    ObjLeafWriter* obj_writer = nullptr;
     Pcg32 pcg;
-    LeafAngleDistribution* angle_distribution = nullptr;
+    std::vector<LeafAngleDistributionVariant> angle_distributions;
+    std::vector<std::unique_ptr<LeafVolume>> volumes;
+    std::vector<Float> volume_lais;
+    std::vector<Float> volume_radii;
+    std::vector<std::size_t> volume_angle_distributions;
+    std::vector<LeafDisk> leaf_disks;
+    std::vector<std::size_t> volume_leaf_ends;
+    CanopyAnalysis analysis;
+
+    // Add volume, with its LAI, leaf radius, and angle distribution index.
+    auto addVolume = [&](
+            LeafVolume* volume, 
+            Float volume_lai, 
+            Float volume_radius, 
+            std::size_t angle_distribution) {
+        volumes.emplace_back(volume);
+        volume_lais.push_back(volume_lai);
+        volume_radii.push_back(volume_radius);
+        volume_angle_distributions.push_back(angle_distribution);
+    };
+
+    // Observe leaf disk, after output.
+    auto observe = [&](const LeafDisk& leaf_disk) {
+        if (!analysis_filename.empty()) {
+            analysis.addLeaf(leaf_disk);
+        }
+        if (!gap_fraction_filename.empty() || 
+            !voxel_filename.empty()) {
+            leaf_disks.push_back(leaf_disk);
+        }
+    };
+
+    // Emit leaf disk.
+    auto emit = [&](const LeafDisk& leaf_disk) {
+        writer->write(leaf_disk);
+        observe(leaf_disk);
+    };
 
     // End global
     opt_parser.on_end(
     [&]() {
 
-        // Does not have GList extension?
-        pre::ci_string ci_ofs_filename = ofs_filename.c_str();
-        if (ci_ofs_filename.rfind(".glist") + 6 != 
-            ci_ofs_filename.size()) {
-            is_glist = false;
-
-            // Does not have OBJ extension?
-            if (ci_ofs_filename.rfind(".obj") + 4 !=
-                ci_ofs_filename.size()) {
+        // Writer, deferred until volumes are known if tiling or
+        // appending, and not needed if merging or splitting.
+        writer_options.matid = matid;
+        writer_options.ver_res = obj_ver_res;
+        writer_options.cell_size = output_cell_size;
+        writer_options.cell_memory = output_sort_memory << 20;
+        writer_options.lod_viewpoints = output_lod_viewpoints;
+        writer_options.lod_error = 
+            pre::numeric_constants<Float>::M_pi() / 180 * output_lod_error;
+        writer_options.relative_indices = output_relative;
+        if (tile_size > 0) {
+            pre::ci_string ci_filename = ofs_filename.c_str();
+            if (!hasExtension(ci_filename, ".glist")) {
                 throw std::runtime_error(
-                      "-o/--output filename must end "
-                      "with either \".glist\" or \".obj\"");
+                      "-t/--tile requires output filename ending "
+                      "with \".glist\"");
             }
-            
         }
-
-        // Try to open output file stream.
-        ofs.open(ofs_filename);
-        if (!ofs.is_open()) {
-            throw std::runtime_error(
-                  std::string("can't open ").append(ofs_filename));
-        }
-
-        if (is_glist) {
-            ofs << 
-                "<geometrylist enabled=\"true\">\n"
-                "<object>\n"
-                "<basegeometry>\n"
-                "<disk><matid>";
-            ofs << matid;
-            ofs << 
-                "</matid></disk>\n"
-                "</basegeometry>\n";
+        if (progressive_from >= 0) {
+            writer_options.append = true;
         }
-        else {
-            ofs << "usemtl " << matid << "\n";
+        else if (!(tile_size > 0) && 
+                 merge_filenames.empty() && split_filename.empty()) {
+            writer = LeafWriter::fromFilename(ofs_filename, writer_options);
+            obj_writer = dynamic_cast<ObjLeafWriter*>(writer.get());
         }
 
         // Seed.
         pcg = Pcg32(seed);
 
-        // Angle distribution.
-        angle_distribution = 
-            LeafAngleDistribution::fromString(angle_distribution_args);
+        // Angle distribution, first for volumes other than crowns.
+        angle_distributions.push_back(
+            LeafAngleDistribution::variantFromString(
+                    angle_distribution_args));
     });
 
     // Box options.
@@ -261,28 +1081,7 @@ int main(int argc, char** argv)
             pre::min(box_from, box_to),
             pre::max(box_from, box_to)
         };
-        int num_leaves = 
-            static_cast<int>(
-                lai * 
-                (box[1][0] - box[0][0]) *
-                (box[1][1] - box[0][1]) /
-                (pre::numeric_constants<Float>::M_pi() * radius * radius));
-
-        for (int k = 0; k < num_leaves; k++) {
-            LeafDisk leaf_disk;
-            leaf_disk.pos = box.lerp(generateCanonical3(pcg));
-            leaf_disk.normal = angle_distribution->sampleNormal(pcg);
-            leaf_disk.radius = radius;
-            if (is_glist) {
-                leaf_disk.writeGListInstance(ofs);
-            }
-            else {
-                leaf_disk.writeObj(
-                        ofs, 
-                        obj_ver_offset, 
-                        obj_ver_res);
-            }
-        }
+        addVolume(new BoxLeafVolume(box), lai, radius, 0);
     });
 
     Vec3<Float> sphere_center = {0, 0, 0};
@@ -324,37 +1123,83 @@ int main(int argc, char** argv)
     // End <sphere>
     opt_parser.on_end(
     [&]() {
-        int num_leaves = 
-            static_cast<int>(
-                lai * 
-                sphere_radius * 
-                sphere_radius / 
-                (radius * radius));
-
-        for (int k = 0; k < num_leaves; k++) {
-            LeafDisk leaf_disk;
-            Vec2<Float> pos = 
-            Vec2<Float>::uniform_disk_pdf_sample(generateCanonical2(pcg));
-            leaf_disk.pos = {
-                pos[0],
-                pos[1],
-                pre::sqrt(1 - pre::dot(pos, pos)) *
-                         (2 * generateCanonical(pcg) - 1)
-            };
-            leaf_disk.pos *= sphere_radius;
-            leaf_disk.pos += sphere_center;
-            leaf_disk.normal = angle_distribution->sampleNormal(pcg);
-            leaf_disk.radius = radius;
-            if (is_glist) {
-                leaf_disk.writeGListInstance(ofs);
-            }
-            else {
-                leaf_disk.writeObj(
-                        ofs, 
-                        obj_ver_offset, 
-                        obj_ver_res);
-            }
+        addVolume(
+                new SphereLeafVolume(sphere_center, sphere_radius), 
+                lai, radius, 0);
+    });
+
+    std::string forest_inventory;
+
+    // <forest>
+    opt_parser.in_group("forest") 
+    << "Forest stand, with one volume per crown from an inventory, each\n"
+       "with its own LAI, leaf radius, and angle distribution. Crowns are\n"
+       "generated after all other volumes. Use -p/--pipeline to generate\n"
+       "crowns in parallel.\n";
+
+    // --inventory
+    opt_parser.on_option(nullptr, "--inventory", 1,
+    [&](char** argv) {
+        forest_inventory = argv[0];
+    })
+    << "Specify inventory CSV filename, with a header naming the columns\n"
+       "x, y, z (crown center), shape (sphere, ellipsoid, or cone),\n"
+       "radius, height, lai or leaf_area, leaf_radius, and distribution,\n"
+       "then one crown per line. Missing LAI, leaf radius, and\n"
+       "distribution default to -l/--lai, -r/--radius, and the\n"
+       "positional angle distribution.\n";
+
+    // End <forest>
+    opt_parser.on_end(
+    [&]() {
+        if (forest_inventory.empty()) {
+            throw std::runtime_error("forest expects --inventory");
+        }
+        inventory_filenames.push_back(forest_inventory);
+        forest_inventory.clear();
+    });
+
+    // <query>
+    opt_parser.in_group("query") 
+    << "Query, to write only leaves positioned within a box, exactly as\n"
+       "they would be generated over the whole scene. This requires\n"
+       "-pc/--procedural-cell-size, and generates only the cells the\n"
+       "box overlaps.\n";
+
+    // --from
+    opt_parser.on_option(nullptr, "--from", 1, 
+    [&](char** argv) {
+        std::stringstream sstr(argv[0]);
+        sstr >> query_bounds[0];
+        if (!sstr.good()) {
+            throw std::runtime_error(
+                    "--from expects a 3-dimensional coordinate "
+                    "as a string, e.g., \"[1, 2, 3]\"");
+        }
+    })
+    << "Specify query box corner position. By default, \"[0, 0, 0]\".\n";
+
+    // --to
+    opt_parser.on_option(nullptr, "--to", 1,
+    [&](char** argv) {
+        std::stringstream sstr(argv[0]);
+        sstr >> query_bounds[1];
+        if (!sstr.good()) {
+            throw std::runtime_error(
+                    "--to expects a 3-dimensional coordinate "
+                    "as a string, e.g., \"[1, 2, 3]\"");
         }
+    })
+    << "Specify query box corner position. By default, \"[1, 1, 1]\".\n";
+
+    // End <query>
+    opt_parser.on_end(
+    [&]() {
+        Vec3<Float> from = query_bounds[0];
+        Vec3<Float> to = query_bounds[1];
+        query_bounds[0] = pre::min(from, to);
+        query_bounds[1] = pre::max(from, to);
+        query = true;
     });
 
     try {
@@ -367,13 +1212,762 @@ int main(int argc, char** argv)
         std::exit(EXIT_FAILURE);
     }
 
-    if (is_glist) {
-        ofs << 
-            "</object>\n"
-            "</geometrylist>\n";
+    // Trace.
+    if (!trace_filename.empty()) {
+        Trace::start(trace_filename);
+    }
+
+    // Flutter.
+    if (!flutter_filename.empty() && output_cell_size > 0) {
+        std::cerr << "Unhandled exception in command line arguments!\n";
+        std::cerr << "exception.what(): -f/--flutter requires no ";
+        std::cerr << "-oc/--output-cell-size\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Progressive.
+    if (progressive_from >= 0 && 
+            (!progressive || !(progressive_from < lai) || 
+             output_sort || !flutter_filename.empty() || 
+             !inventory_filenames.empty())) {
+        std::cerr << "Unhandled exception in command line arguments!\n";
+        std::cerr << "exception.what(): -pf/--progressive-from requires ";
+        std::cerr << "-pg/--progressive, LAI less than -l/--lai, no output ";
+        std::cerr << "sort, no flutter, and no forest\n";
+        std::exit(EXIT_FAILURE);
+    }
+    if (progressive && 
+            (clumping_index < 1 || procedural_cell_size > 0)) {
+        std::cerr << "Unhandled exception in command line arguments!\n";
+        std::cerr << "exception.what(): -pg/--progressive requires no ";
+        std::cerr << "clumping and no -pc/--procedural-cell-size\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Merge or split, instead of generating.
+    if (!merge_filenames.empty() || !split_filename.empty()) {
+        bool is_output_input = 
+            split_filename == ofs_filename ||
+            std::find(
+                merge_filenames.begin(), 
+                merge_filenames.end(), ofs_filename) != 
+                merge_filenames.end();
+        if (is_output_input || !volumes.empty() || 
+                !inventory_filenames.empty() || !ifs_filename.empty() ||
+                (!merge_filenames.empty() && !split_filename.empty()) ||
+                (!split_filename.empty() && 
+                 (split_options.count > 0) == 
+                 (split_options.cell_size > 0))) {
+            std::cerr << "Unhandled exception in command line arguments!\n";
+            std::cerr << "exception.what(): -mg/--merge and -sp/--split ";
+            std::cerr << "are exclusive, and require a different output ";
+            std::cerr << "filename, no volumes, and no -i/--input, and ";
+            std::cerr << "-sp/--split requires exactly one of ";
+            std::cerr << "-sn/--split-count and -sc/--split-cell-size\n";
+            std::exit(EXIT_FAILURE);
+        }
+        try {
+            if (!merge_filenames.empty()) {
+                TraceSpan span("merge");
+                mergeLeafOutputs(merge_filenames, ofs_filename, num_threads);
+            }
+            else {
+                TraceSpan span("split");
+                std::size_t num_parts = 
+                    splitLeafOutput(
+                        split_filename, ofs_filename, 
+                        split_options, num_threads);
+                std::cout << "Split into " << num_parts << " parts\n";
+            }
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in output!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // Input.
+    if (!ifs_filename.empty() && 
+            (ifs_filename == ofs_filename || tile_size > 0 || pipeline || 
+             progressive || procedural_cell_size > 0)) {
+        std::cerr << "Unhandled exception in command line arguments!\n";
+        std::cerr << "exception.what(): -i/--input requires a different ";
+        std::cerr << "output filename, no tiling, no -p/--pipeline, no ";
+        std::cerr << "-pg/--progressive, and no ";
+        std::cerr << "-pc/--procedural-cell-size\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Procedural cells.
+    if (query && !(procedural_cell_size > 0)) {
+        std::cerr << "Unhandled exception in command line arguments!\n";
+        std::cerr << "exception.what(): query requires ";
+        std::cerr << "-pc/--procedural-cell-size\n";
+        std::exit(EXIT_FAILURE);
+    }
+    if (procedural_cell_size > 0 && 
+            (!sampler_random || clumping_index < 1 || pipeline)) {
+        std::cerr << "Unhandled exception in command line arguments!\n";
+        std::cerr << "exception.what(): -pc/--procedural-cell-size ";
+        std::cerr << "requires -sa/--sampler random, no clumping, and ";
+        std::cerr << "no -p/--pipeline\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Forest, with crowns after other volumes.
+    if (!inventory_filenames.empty()) {
+        try {
+            TraceSpan span("inventory");
+            LeafInventory inventory;
+            for (const std::string& inventory_filename : 
+                        inventory_filenames) {
+                inventory.loadCsv(
+                        inventory_filename, lai, radius, 
+                        angle_distribution_args);
+            }
+            std::size_t angle_distribution_offset = 
+                angle_distributions.size();
+            for (LeafAngleDistributionVariant& angle_distribution : 
+                        inventory.angleDistributions()) {
+                angle_distributions.push_back(std::move(angle_distribution));
+            }
+            for (LeafCrown& crown : inventory.crowns()) {
+                addVolume(
+                        crown.volume.release(), 
+                        crown.lai, crown.leaf_radius, 
+                        angle_distribution_offset + 
+                            crown.angle_distribution);
+            }
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in input!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Exclusion.
+    LeafExclusion exclusion;
+    if (!exclusion_filenames.empty()) {
+        // Tiles are generated in tile-local coordinates, so the meshes 
+        // would be in the wrong frame.
+        if (!ifs_filename.empty() || procedural_cell_size > 0 || 
+                tile_size > 0) {
+            std::cerr << "Unhandled exception in command line arguments!\n";
+            std::cerr << "exception.what(): -x/--exclude requires no ";
+            std::cerr << "-i/--input, no -pc/--procedural-cell-size, ";
+            std::cerr << "and no -t/--tile\n";
+            std::exit(EXIT_FAILURE);
+        }
+        try {
+            TraceSpan span("exclusion");
+            for (const std::string& exclusion_filename : 
+                        exclusion_filenames) {
+                exclusion.loadObj(exclusion_filename);
+            }
+            exclusion.build(exclusion_clearance, num_threads);
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in input!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Tile.
+    if (tile_size > 0) {
+        const BoxLeafVolume* box_volume = 
+            volumes.size() == 1 ? 
+            dynamic_cast<const BoxLeafVolume*>(volumes[0].get()) : nullptr;
+        if (!box_volume) {
+            std::cerr << "Unhandled exception in command line arguments!\n";
+            std::cerr << "exception.what(): -t/--tile requires exactly 1 ";
+            std::cerr << "box\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        // Tiles dividing the box evenly.
+        pre::aabb3<Float> box = box_volume->bounds();
+        GListTiling tiling;
+        for (int j = 0; j < 2; j++) {
+            Float extent = box[1][j] - box[0][j];
+            tiling.num_tiles[j] = 
+                std::max<long long>(std::llround(extent / tile_size), 1);
+            tiling.tile_size[j] = extent / tiling.num_tiles[j];
+            tiling.origin[j] = box[0][j];
+        }
+
+        // Distinct from the sequence and clumping seeds.
+        tiling.seed = hashCombine(hashCombine(seed, 0), 2);
+
+        // Generate the tile only, in tile coordinates.
+        volumes[0].reset(
+            new BoxLeafVolume({
+                Vec3<Float>{0, 0, box[0][2]},
+                Vec3<Float>{
+                    tiling.tile_size[0], 
+                    tiling.tile_size[1], 
+                    box[1][2]
+                }
+            }));
+        try {
+            writer.reset(
+                new TiledGListLeafWriter(
+                    ofs_filename, writer_options, tiling));
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in output!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // First leaf per volume, beyond those in the output if appending.
+    std::vector<std::uint64_t> first_leaves(volumes.size());
+    if (progressive_from >= 0) {
+        try {
+            std::uint64_t num_leaves_existing = 0;
+            for (std::size_t v = 0; v < volumes.size(); v++) {
+                first_leaves[v] = 
+                    volumes[v]->numLeaves(progressive_from, volume_radii[v]);
+                num_leaves_existing += first_leaves[v];
+            }
+            if (!writer) {
+                writer_options.append_num_leaves = num_leaves_existing;
+                writer = 
+                    LeafWriter::fromFilename(ofs_filename, writer_options);
+                obj_writer = dynamic_cast<ObjLeafWriter*>(writer.get());
+            }
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in output!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Flutter, inside sort so that leaf order matches the output. This
+    // is why bucketing, which reorders leaves inside the writer, is 
+    // rejected with flutter.
+    if (!flutter_filename.empty()) {
+        try {
+            writer.reset(
+                new FlutterLeafWriter(
+                    std::move(writer), flutter_filename,
+                    LeafFlutter(
+                        pre::numeric_constants<Float>::M_pi() / 180 * 
+                            flutter_amplitude,
+                        flutter_frequency,
+                        hashCombine(hashCombine(seed, 0), 3)),
+                    flutter_num_frames, flutter_frame_time, num_threads));
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in output!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Sort output.
+    if (output_sort && !volumes.empty()) {
+        pre::aabb3<Float> bounds = volumes[0]->bounds();
+        for (const std::unique_ptr<LeafVolume>& volume : volumes) {
+            bounds[0] = pre::min(bounds[0], volume->bounds()[0]);
+            bounds[1] = pre::max(bounds[1], volume->bounds()[1]);
+        }
+        writer.reset(
+            new MortonSortLeafWriter(
+                std::move(writer), bounds, 
+                output_sort_memory << 20, num_threads, 
+                output_sort_packed));
+    }
+
+    // Check planned counts, before allocating anything per leaf.
+    try {
+        std::uint64_t num_leaves_total = 0;
+        for (std::size_t v = 0; v < volumes.size(); v++) {
+            if (!ifs_filename.empty()) {
+                break;
+            }
+            std::uint64_t num_leaves = 
+                volumes[v]->numLeaves(volume_lais[v], volume_radii[v]);
+            if (!sampler_random && num_leaves > (std::uint64_t(1) << 32)) {
+                throw 
+                    std::runtime_error(
+                    "-sa/--sampler sobol and halton support at most 2^32 "
+                    "leaves per volume");
+            }
+            if (num_leaves > UINT64_MAX - num_leaves_total) {
+                throw std::runtime_error("too many leaves");
+            }
+            num_leaves_total += num_leaves;
+        }
+        writer->checkCapacity(num_leaves_total);
+    }
+    catch (const std::exception& exception) {
+        std::cerr << "Unhandled exception in output!\n";
+        std::cerr << "exception.what(): " << exception.what() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Low-discrepancy sequence per volume.
+    std::vector<LowDiscrepancySequence> sequences;
+    if (!sampler_random) {
+        for (std::size_t v = 0; v < volumes.size(); v++) {
+            sequences.emplace_back(sampler_type, hashCombine(seed, v));
+        }
+    }
+
+    // Clumping per volume.
+    std::vector<std::unique_ptr<ThomasLeafClumping>> clumpings;
+    if (clumping_index < 1 && ifs_filename.empty()) {
+
+        // G-function at nadir per angle distribution, by the same 
+        // quadrature as the analysis reference, so independent of seed.
+        std::vector<Float> gs;
+        for (const LeafAngleDistributionVariant& angle_distribution : 
+                    angle_distributions) {
+            Float g = 0;
+            const int num_g_nodes = 1 << 8;
+            visitQuadratureNormals(
+                    toLeafAngleDistribution(angle_distribution), 
+                    num_g_nodes,
+                    [&](const Vec3<Float>& normal) {
+                g += pre::fabs(normal[2]);
+            });
+            gs.push_back(g / (num_g_nodes * num_g_nodes));
+        }
+        for (std::size_t v = 0; v < volumes.size(); v++) {
+            Float leaves_per_cluster = 
+                ThomasLeafClumping::leavesPerCluster(
+                        clumping_index, cluster_radius, 
+                        pre::numeric_constants<Float>::M_pi() * 
+                            volume_radii[v] * volume_radii[v],
+                        gs[volume_angle_distributions[v]]);
+
+            // Distinct from the sequence seed.
+            clumpings.emplace_back(
+                    new ThomasLeafClumping(
+                        *volumes[v], 
+                        volumes[v]->numLeaves(
+                            volume_lais[v], volume_radii[v]),
+                        leaves_per_cluster, cluster_radius,
+                        hashCombine(hashCombine(seed, v), 1),
+                        tile_size > 0));
+        }
+    }
+
+    // Sample leaf k in volume v. Pseudo-random numbers come from the
+    // given generator. Sequence dimensions 0 to 2 go to position, and
+    // 3 to 4 go to normal. Clumped positions always use pseudo-random
+    // offsets, since offsets are rejection sampled. Leaves that are 
+    // excluded are resampled pseudo-randomly. This is generic over the
+    // concrete distribution, so callers should visit the distribution
+    // outside their loops.
+    auto sampleLeaf = [&](
+            const auto& distribution,
+            std::size_t v, std::size_t k, 
+            Pcg32& leaf_pcg, LeafDisk& leaf_disk) {
+        const LeafVolume& volume = *volumes[v];
+        if (sampler_random) {
+            leaf_disk.pos = 
+                clumpings.empty() ? 
+                volume.samplePosition(generateCanonical3(leaf_pcg)) :
+                clumpings[v]->samplePosition(k, leaf_pcg);
+            leaf_disk.normal = distribution.sampleNormal(leaf_pcg);
+        }
+        else {
+            const LowDiscrepancySequence& sequence = sequences[v];
+            leaf_disk.pos = 
+                clumpings.empty() ? 
+                volume.samplePosition(sequence.generate3(k, 0)) :
+                clumpings[v]->samplePosition(k, leaf_pcg);
+            leaf_disk.normal = 
+                distribution.sampleNormal(sequence.generate2(k, 3));
+        }
+        leaf_disk.radius = volume_radii[v];
+        if (!exclusion.empty()) {
+            const int max_attempts = 1000;
+            for (int attempt = 1; 
+                     exclusion.excludes(leaf_disk); attempt++) {
+                if (attempt == max_attempts) {
+                    throw 
+                        std::runtime_error(
+                        "no leaf outside -x/--exclude meshes after 1000 "
+                        "attempts, as they cover too much of the volume");
+                }
+                leaf_disk.pos = 
+                    clumpings.empty() ? 
+                    volume.samplePosition(generateCanonical3(leaf_pcg)) :
+                    clumpings[v]->samplePosition(k, leaf_pcg);
+                leaf_disk.normal = distribution.sampleNormal(leaf_pcg);
+            }
+        }
+    };
+
+    // Sample leaves k0 to k0 + count - 1 in volume v, the same as 
+    // sampleLeaf() would one at a time. For distributions with batched
+    // normals, no clumping, and no exclusion, this draws each leaf's 
+    // position and canonical numbers in the same order, then maps the 
+    // numbers to normals in blocks.
+    auto sampleLeaves = [&](
+            const auto& distribution,
+            std::size_t v, std::uint64_t k0, std::size_t count,
+            Pcg32& leaf_pcg, LeafDisk* leaf_disks) {
+        typedef std::decay_t<decltype(distribution)> Distribution;
+        if constexpr (Distribution::is_batched) {
+            if (clumpings.empty() && exclusion.empty()) {
+                const LeafVolume& volume = *volumes[v];
+                const std::size_t block_size = 256;
+                Vec2<Float> u[block_size];
+                Vec3<Float> normals[block_size];
+                for (std::size_t b = 0; b < count; b += block_size) {
+                    std::size_t n = std::min(block_size, count - b);
+                    LeafDisk* block = leaf_disks + b;
+                    for (std::size_t k = 0; k < n; k++) {
+                        if (sampler_random) {
+                            block[k].pos = 
+                                volume.samplePosition(
+                                    generateCanonical3(leaf_pcg));
+                            u[k][0] = generateCanonical(leaf_pcg);
+                            u[k][1] = generateCanonical(leaf_pcg);
+                        }
+                        else {
+                            const LowDiscrepancySequence& sequence = 
+                                sequences[v];
+                            block[k].pos = 
+                                volume.samplePosition(
+                                    sequence.generate3(k0 + b + k, 0));
+                            u[k] = sequence.generate2(k0 + b + k, 3);
+                        }
+                    }
+                    distribution.sampleNormals(u, normals, n);
+                    for (std::size_t k = 0; k < n; k++) {
+                        block[k].normal = normals[k];
+                        block[k].radius = volume_radii[v];
+                    }
+                }
+                return;
+            }
+        }
+        for (std::size_t k = 0; k < count; k++) {
+            sampleLeaf(distribution, v, k0 + k, leaf_pcg, leaf_disks[k]);
+        }
+    };
+
+    // Seed of leaf k in volume v, if progressive. Distinct from the 
+    // sequence and clumping seeds.
+    auto leafSeed = [&](std::size_t v, std::uint64_t k) {
+        return hashCombine(hashCombine(hashCombine(seed, v), 5), k);
+    };
+
+    // Read or generate.
+    if (!ifs_filename.empty()) {
+        try {
+            TraceSpan span("read input");
+            LeafReader reader(ifs_filename);
+            reader.read(emit, num_threads);
+
+            // Check capacity of what was read, since the count wasn't 
+            // known in advance. No more leaves are coming, but writers
+            // that buffer, such as GLB, may already hold too many.
+            writer->checkCapacity(0);
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in input!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+        for (const std::unique_ptr<LeafVolume>& volume : volumes) {
+            analysis.addGroundArea(volume->groundArea());
+        }
+    }
+    else if (procedural_cell_size > 0) {
+        for (std::size_t v = 0; v < volumes.size(); v++) {
+            TraceSpan span("volume", v);
+
+            // Distinct from the sequence and clumping seeds.
+            LeafCellGenerator cells(
+                    *volumes[v], volume_lais[v], volume_radii[v], 
+                    procedural_cell_size,
+                    hashCombine(hashCombine(seed, v), 4));
+            std::visit([&](const auto& distribution) {
+                if (query) {
+                    cells.query(query_bounds, distribution, emit);
+                }
+                else {
+                    cells.generate(distribution, emit);
+                }
+            }, 
+            angle_distributions[volume_angle_distributions[v]]);
+            if (query) {
+                // Ground area of query over volume bounds.
+                pre::aabb3<Float> bounds = volumes[v]->bounds();
+                Float ground_area = 1;
+                for (int j = 0; j < 2; j++) {
+                    ground_area *= std::max<Float>(
+                            std::min(bounds[1][j], query_bounds[1][j]) -
+                            std::max(bounds[0][j], query_bounds[0][j]), 
+                            0);
+                }
+                analysis.addGroundArea(ground_area);
+            }
+            else {
+                analysis.addGroundArea(volumes[v]->groundArea());
+            }
+            volume_leaf_ends.push_back(leaf_disks.size());
+        }
+    }
+    else if (pipeline) {
+
+        // Batches, each within one volume.
+        const std::size_t max_batch_size = 4096;
+        std::vector<std::size_t> batch_volumes;
+        std::vector<std::size_t> batch_firsts;
+        std::vector<std::size_t> batch_sizes;
+        for (std::size_t v = 0; v < volumes.size(); v++) {
+            std::size_t num_leaves = 
+                volumes[v]->numLeaves(volume_lais[v], volume_radii[v]);
+            for (std::size_t k = first_leaves[v]; 
+                             k < num_leaves; k += max_batch_size) {
+                batch_volumes.push_back(v);
+                batch_firsts.push_back(k);
+                batch_sizes.push_back(
+                        std::min(max_batch_size, num_leaves - k));
+            }
+            analysis.addGroundArea(volumes[v]->groundArea());
+            volume_leaf_ends.push_back(
+                    (v == 0 ? 0 : volume_leaf_ends.back()) + 
+                    num_leaves - first_leaves[v]);
+        }
+
+        // Sample batch.
+        auto sample = [&](
+                std::size_t batch_index, 
+                LeafDisk* batch_leaf_disks, 
+                std::size_t batch_size) {
+            Pcg32 batch_pcg(hashCombine(seed, batch_index));
+            std::size_t v = batch_volumes[batch_index];
+            std::visit([&](const auto& distribution) {
+                if (!progressive) {
+                    sampleLeaves(
+                        distribution, v, batch_firsts[batch_index], 
+                        batch_size, batch_pcg, batch_leaf_disks);
+                    return;
+                }
+                for (std::size_t k = 0; k < batch_size; k++) {
+                    std::size_t leaf_index = batch_firsts[batch_index] + k;
+                    Pcg32 leaf_pcg(leafSeed(v, leaf_index));
+                    sampleLeaf(
+                        distribution, v, leaf_index,
+                        leaf_pcg, batch_leaf_disks[k]);
+                }
+            }, 
+            angle_distributions[volume_angle_distributions[v]]);
+        };
+
+        try {
+            TraceSpan span("pipeline");
+            runLeafPipeline(
+                    batch_sizes, sample, *writer, observe, num_threads);
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in output!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else {
+        try {
+            for (std::size_t v = 0; v < volumes.size(); v++) {
+                TraceSpan span("volume", v);
+                std::uint64_t num_leaves = 
+                    volumes[v]->numLeaves(volume_lais[v], volume_radii[v]);
+                std::visit([&](const auto& distribution) {
+                    if (!progressive) {
+                        // Blocks, such that normals may be batched.
+                        const std::size_t block_size = 256;
+                        LeafDisk block[block_size];
+                        for (std::uint64_t k = first_leaves[v]; 
+                                           k < num_leaves; k += block_size) {
+                            std::size_t n = 
+                                std::min<std::uint64_t>(
+                                    block_size, num_leaves - k);
+                            sampleLeaves(distribution, v, k, n, pcg, block);
+                            for (std::size_t i = 0; i < n; i++) {
+                                emit(block[i]);
+                            }
+                        }
+                    }
+                    else {
+                        for (std::uint64_t k = first_leaves[v]; 
+                                           k < num_leaves; k++) {
+                            LeafDisk leaf_disk;
+                            Pcg32 leaf_pcg(leafSeed(v, k));
+                            sampleLeaf(
+                                distribution, v, k, leaf_pcg, leaf_disk);
+                            emit(leaf_disk);
+                        }
+                    }
+                }, 
+                angle_distributions[volume_angle_distributions[v]]);
+                analysis.addGroundArea(volumes[v]->groundArea());
+                volume_leaf_ends.push_back(leaf_disks.size());
+            }
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in output!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    try {
+        // Finish output.
+        TraceSpan span("finish output");
+        writer->finish();
+    }
+    catch (const std::exception& exception) {
+        std::cerr << "Unhandled exception in output!\n";
+        std::cerr << "exception.what(): " << exception.what() << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+
+    // Report level of detail.
+    if (obj_writer && !output_lod_viewpoints.empty()) {
+        std::uint64_t num_triangles = obj_writer->numTriangles();
+        std::uint64_t num_triangles_budget = obj_writer->numTrianglesBudget();
+        std::cout << "Level of detail: " << num_triangles << " triangles ";
+        std::cout << "of budget " << num_triangles_budget << " (";
+        std::cout << (num_triangles_budget == 0 ? 100 :
+                      100.0 * num_triangles / num_triangles_budget);
+        std::cout << "%)\n";
+    }
+
+    if (!analysis_filename.empty()) {
+        TraceSpan span("analysis");
+
+        // Compute.
+        analysis.setDirectionGrid(
+                analysis_num_zenith, 
+                analysis_num_azimuth);
+        analysis.compute(num_threads);
+
+        // Reference from midpoint quadrature over the leaf angle 
+        // distributions, mapping a regular grid of canonical numbers 
+        // through each, so it shares no randomness with the generated 
+        // leaves. Weighted by the leaf area of the volumes using each.
+        std::vector<Float> reference_weights(angle_distributions.size());
+        Float reference_weight_sum = 0;
+        for (std::size_t v = 0; v < volumes.size(); v++) {
+            Float leaf_area = volume_lais[v] * volumes[v]->groundArea();
+            reference_weights[volume_angle_distributions[v]] += leaf_area;
+            reference_weight_sum += leaf_area;
+        }
+        if (!(reference_weight_sum > 0)) {
+            reference_weights[0] = 1;
+            reference_weight_sum = 1;
+        }
+        std::size_t num_reference_distributions = 
+            reference_weights.size() - 
+            std::count(reference_weights.begin(), 
+                       reference_weights.end(), Float(0));
+        int num_reference_nodes = 
+            std::max<int>(
+                std::sqrt(Float((1 << 20) / num_reference_distributions)),
+                1 << 6);
+        CanopyAnalysis reference;
+        for (std::size_t d = 0; d < angle_distributions.size(); d++) {
+            if (reference_weights[d] == 0) {
+                continue;
+            }
+            visitQuadratureNormals(
+                    toLeafAngleDistribution(angle_distributions[d]),
+                    num_reference_nodes,
+                    [&](const Vec3<Float>& normal) {
+                reference.addLeaf(
+                        normal, 
+                        reference_weights[d] / reference_weight_sum);
+            });
+        }
+        reference.setDirectionGrid(
+                analysis_num_zenith, 
+                analysis_num_azimuth);
+        reference.compute(num_threads);
+        analysis.setReference(reference);
+
+        // Write.
+        std::ofstream analysis_ofs(analysis_filename);
+        if (!analysis_ofs.is_open()) {
+            std::cerr << "Can't open " << analysis_filename << "!\n";
+            std::exit(EXIT_FAILURE);
+        }
+        pre::ci_string ci_analysis_filename = analysis_filename.c_str();
+        if (hasExtension(ci_analysis_filename, ".json")) {
+            analysis.writeJson(analysis_ofs);
+        }
+        else {
+            analysis.writeCsv(analysis_ofs);
+        }
+    }
+
+    if (!gap_fraction_filename.empty()) {
+        TraceSpan span("gap fraction");
+
+        // Compute, with G-functions per angle distribution, unless the 
+        // leaves were read, in which case their volumes are unknown.
+        gap_fraction.seed = seed;
+        gap_fraction.compute(
+                leaf_disks, volumes, volume_lais, 
+                ifs_filename.empty() ? 
+                    volume_angle_distributions : std::vector<std::size_t>(),
+                volume_leaf_ends, num_threads);
+
+        // Write.
+        std::ofstream gap_fraction_ofs(gap_fraction_filename);
+        if (!gap_fraction_ofs.is_open()) {
+            std::cerr << "Can't open " << gap_fraction_filename << "!\n";
+            std::exit(EXIT_FAILURE);
+        }
+        pre::ci_string ci_gap_fraction_filename = 
+                gap_fraction_filename.c_str();
+        if (hasExtension(ci_gap_fraction_filename, ".json")) {
+            gap_fraction.writeJson(gap_fraction_ofs);
+        }
+        else {
+            gap_fraction.writeCsv(gap_fraction_ofs);
+        }
     }
 
-    delete angle_distribution;
+    if (!voxel_filename.empty() && !volumes.empty()) {
+        TraceSpan span("voxel");
+
+        // Compute over all volumes.
+        pre::aabb3<Float> bounds = volumes[0]->bounds();
+        for (const std::unique_ptr<LeafVolume>& volume : volumes) {
+            bounds[0] = pre::min(bounds[0], volume->bounds()[0]);
+            bounds[1] = pre::max(bounds[1], volume->bounds()[1]);
+        }
+        try {
+            voxel_grid.compute(leaf_disks, bounds, num_threads);
+        }
+        catch (const std::exception& exception) {
+            std::cerr << "Unhandled exception in output!\n";
+            std::cerr << "exception.what(): " << exception.what() << "\n";
+            std::exit(EXIT_FAILURE);
+        }
+
+        // Write.
+        std::ofstream voxel_ofs(
+                voxel_filename, std::ios::out | std::ios::binary);
+        if (!voxel_ofs.is_open()) {
+            std::cerr << "Can't open " << voxel_filename << "!\n";
+            std::exit(EXIT_FAILURE);
+        }
+        voxel_grid.writeNrrd(voxel_ofs);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,211 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <leaf-disk-gen/trace.hpp>
+
+namespace ld {
+
+namespace {
+
+// Trace event.
+struct TraceEvent
+{
+    const char* name;
+    std::uint64_t begin;
+    std::uint64_t end;
+    std::int64_t arg;
+};
+
+// Trace buffer, being one timeline track.
+struct TraceBuffer
+{
+    std::size_t index = 0;
+    std::vector<TraceEvent> events;
+};
+
+// Trace state.
+struct TraceState
+{
+    std::mutex mutex;
+    std::string filename;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::vector<TraceBuffer*> free_buffers;
+};
+
+// Trace state, constructed on start.
+TraceState& traceState()
+{
+    static TraceState state;
+    return state;
+}
+
+// Trace thread, returning its buffer on exit.
+struct TraceThread
+{
+    TraceBuffer* buffer = nullptr;
+
+    ~TraceThread()
+    {
+        if (buffer) {
+            TraceState& state = traceState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.free_buffers.push_back(buffer);
+        }
+    }
+};
+
+// Trace thread of calling thread.
+thread_local TraceThread trace_thread;
+
+// Buffer of calling thread, taking the lowest free one if necessary.
+TraceBuffer& threadBuffer()
+{
+    if (!trace_thread.buffer) {
+        TraceState& state = traceState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.free_buffers.empty()) {
+            state.buffers.emplace_back(new TraceBuffer);
+            state.buffers.back()->index = state.buffers.size() - 1;
+            trace_thread.buffer = state.buffers.back().get();
+        }
+        else {
+            auto itr = std::min_element(
+                    state.free_buffers.begin(), 
+                    state.free_buffers.end(),
+                    [](const TraceBuffer* buffer0, 
+                       const TraceBuffer* buffer1) {
+                        return buffer0->index < buffer1->index;
+                    });
+            trace_thread.buffer = *itr;
+            state.free_buffers.erase(itr);
+        }
+    }
+    return *trace_thread.buffer;
+}
+
+// Write at exit.
+void writeAtExit()
+{
+    const std::string& filename = traceState().filename;
+    std::ofstream ofs(filename);
+    if (!ofs.is_open()) {
+        std::cerr << "Can't open " << filename << "!\n";
+        return;
+    }
+    Trace::writeJson(ofs);
+}
+
+} // namespace
+
+// Is recording?
+std::atomic<bool> Trace::is_enabled_ = {false};
+
+// Start.
+void Trace::start(const std::string& filename)
+{
+    TraceState& state = traceState();
+    state.filename = filename;
+    state.origin = std::chrono::steady_clock::now();
+
+    // Calling thread is the main track.
+    threadBuffer();
+    is_enabled_.store(true);
+    std::atexit(writeAtExit);
+}
+
+// Now.
+std::uint64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now() - traceState().origin).count();
+}
+
+// Record.
+void Trace::record(
+            const char* name, 
+            std::uint64_t begin, 
+            std::uint64_t end, 
+            std::int64_t arg)
+{
+    threadBuffer().events.push_back({name, begin, end, arg});
+}
+
+// Write Chrome trace JSON.
+void Trace::writeJson(std::ostream& ostr)
+{
+    TraceState& state = traceState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    ostr << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool is_first = true;
+    auto microseconds = [&](std::uint64_t ns) {
+        ostr << ns / 1000 << '.';
+        char digits[4] = {
+            char('0' + ns / 100 % 10), 
+            char('0' + ns / 10 % 10), 
+            char('0' + ns % 10), 
+            '\0'
+        };
+        ostr << digits;
+    };
+    for (const std::unique_ptr<TraceBuffer>& buffer : state.buffers) {
+        ostr << (is_first ? "" : ",\n");
+        is_first = false;
+        ostr << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, ";
+        ostr << "\"tid\": " << buffer->index << ", \"args\": {\"name\": ";
+        if (buffer->index == 0) {
+            ostr << "\"main\"}}";
+        }
+        else {
+            ostr << "\"worker " << buffer->index << "\"}}";
+        }
+        for (const TraceEvent& event : buffer->events) {
+            ostr << ",\n{\"name\": \"" << event.name << "\", ";
+            ostr << "\"ph\": \"X\", \"pid\": 1, ";
+            ostr << "\"tid\": " << buffer->index << ", \"ts\": ";
+            microseconds(event.begin);
+            ostr << ", \"dur\": ";
+            microseconds(event.end - event.begin);
+            if (event.arg >= 0) {
+                ostr << ", \"args\": {\"index\": " << event.arg << "}";
+            }
+            ostr << "}";
+        }
+    }
+    ostr << "\n]}\n";
+}
+
+} // namespace ld
@@ -0,0 +1,127 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <variant>
+#include <leaf-disk-gen/leaf_angle_distribution.hpp>
+
+// Benchmarks sampling normals through virtual dispatch against 
+// sampling them inside std::visit, as the generation loops do, in 
+// nanoseconds per normal. Pass the number of normals as the first 
+// argument, by default 2^24.
+
+using namespace ld;
+
+namespace {
+
+// Weights of normal components to sum, using every component so that 
+// none of the sampling is dead code.
+const Vec3<Float> weights = {Float(0.3), Float(0.5), Float(0.8)};
+
+// Sample normals through virtual dispatch. Not inlined, so that the
+// compiler cannot see the concrete type.
+[[gnu::noinline]]
+Float sampleVirtual(
+            const LeafAngleDistribution& distribution, 
+            std::uint64_t num_normals)
+{
+    Pcg32 pcg(0);
+    Float sum = 0;
+    for (std::uint64_t k = 0; k < num_normals; k++) {
+        sum += pre::dot(distribution.sampleNormal(pcg), weights);
+    }
+    return sum;
+}
+
+// Sample normals inside std::visit, so each call resolves statically.
+[[gnu::noinline]]
+Float sampleVisit(
+            const LeafAngleDistributionVariant& variant, 
+            std::uint64_t num_normals)
+{
+    return std::visit([&](const auto& distribution) {
+        Pcg32 pcg(0);
+        Float sum = 0;
+        for (std::uint64_t k = 0; k < num_normals; k++) {
+            sum += pre::dot(distribution.sampleNormal(pcg), weights);
+        }
+        return sum;
+    }, variant);
+}
+
+// Time function, in nanoseconds per normal.
+template <typename Func>
+double timeNormals(Func&& func, std::uint64_t num_normals, Float& sum)
+{
+    auto start = std::chrono::steady_clock::now();
+    sum = func();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / 
+           num_normals;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::uint64_t num_normals = 1 << 24;
+    if (argc > 1) {
+        num_normals = std::stoull(argv[1]);
+    }
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "distribution,virtual_ns,visit_ns\n";
+    for (const char* name : {
+            "Uniform", 
+            "Trigonometric Planophile", 
+            "TrowbridgeReitz 0.3 0.8", 
+            "Beckmann 0.3 0.8"}) {
+        LeafAngleDistributionVariant variant = 
+            LeafAngleDistribution::variantFromString(name);
+        Float sum_virtual = 0;
+        Float sum_visit = 0;
+        double ns_virtual = timeNormals([&]() {
+            return sampleVirtual(
+                    toLeafAngleDistribution(variant), num_normals);
+        }, num_normals, sum_virtual);
+        double ns_visit = timeNormals([&]() {
+            return sampleVisit(variant, num_normals);
+        }, num_normals, sum_visit);
+        std::cout << name << "," << ns_virtual << "," << ns_visit << "\n";
+
+        // Same normals either way.
+        if (sum_virtual != sum_visit) {
+            std::cerr << name << ": virtual and visit disagree\n";
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
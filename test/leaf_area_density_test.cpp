@@ -0,0 +1,148 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <leaf-disk-gen/leaf_area_density.hpp>
+
+// Validates that the leaf area density grid conserves leaf area, and 
+// that leaves sticking out of the bounds deposit their area in the 
+// padding rather than in the outer voxels of the bounds. Voxelizes 
+// randomly oriented leaves in a thin box, then vertical leaves 
+// centered on its top face, half of which is above the bounds.
+
+using namespace ld;
+
+namespace {
+
+// Bounds, thin in Z.
+const pre::aabb3<Float> bounds = {
+    Vec3<Float>{0, 0, 0}, 
+    Vec3<Float>{2, 2, Float(0.2)}
+};
+
+// Total area in the grid, and the part of it above height.
+struct Areas
+{
+    Float total = 0;
+    Float above = 0;
+};
+
+// Compute areas.
+Areas computeAreas(const LeafAreaDensityGrid& grid, Float height)
+{
+    Areas areas;
+    const int* dims = grid.dims();
+    Vec3<Float> spacing = grid.spacing();
+    Float voxel_volume = spacing[0] * spacing[1] * spacing[2];
+    for (int k = 0; k < dims[2]; k++)
+    for (int j = 0; j < dims[1]; j++)
+    for (int i = 0; i < dims[0]; i++) {
+        std::size_t v = (std::size_t(k) * dims[1] + j) * dims[0] + i;
+        Float area = grid.values()[v] * voxel_volume;
+        areas.total += area;
+        if (grid.bounds()[0][2] + (k + Float(0.5)) * spacing[2] > 
+                height) {
+            areas.above += area;
+        }
+    }
+    return areas;
+}
+
+} // namespace
+
+int main()
+{
+    bool success = true;
+    std::cout << std::setprecision(8);
+
+    // Random leaves.
+    {
+        Pcg32 pcg(1);
+        std::vector<LeafDisk> leaf_disks(4096);
+        Float leaf_area = 0;
+        for (LeafDisk& leaf_disk : leaf_disks) {
+            leaf_disk.pos = 
+                bounds[0] + 
+                (bounds[1] - bounds[0]) * generateCanonical3(pcg);
+            Vec2<Float> u = generateCanonical2(pcg);
+            Float cos_theta = 2 * u[0] - 1;
+            Float sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+            Float phi = 2 * pre::numeric_constants<Float>::M_pi() * u[1];
+            leaf_disk.normal = {
+                sin_theta * std::cos(phi), 
+                sin_theta * std::sin(phi), 
+                cos_theta
+            };
+            leaf_disk.radius = 
+                Float(0.05) + Float(0.1) * generateCanonical(pcg);
+            leaf_area += leaf_disk.computeArea();
+        }
+        LeafAreaDensityGrid grid;
+        grid.compute(leaf_disks, bounds, 2);
+        Areas areas = computeAreas(grid, bounds[1][2]);
+        std::cout << "random leaves, area " << leaf_area;
+        std::cout << ", grid area " << areas.total << "\n";
+        if (!(std::fabs(areas.total - leaf_area) < 1e-9 * leaf_area)) {
+            std::cout << "  FAIL: area not conserved\n";
+            success = false;
+        }
+    }
+
+    // Vertical leaves centered on the top face.
+    {
+        Pcg32 pcg(2);
+        std::vector<LeafDisk> leaf_disks(256);
+        Float leaf_area = 0;
+        for (LeafDisk& leaf_disk : leaf_disks) {
+            Vec2<Float> u = generateCanonical2(pcg);
+            leaf_disk.pos = {2 * u[0], 2 * u[1], bounds[1][2]};
+            leaf_disk.normal = {1, 0, 0};
+            leaf_disk.radius = Float(0.1);
+            leaf_area += leaf_disk.computeArea();
+        }
+        LeafAreaDensityGrid grid;
+        grid.compute(leaf_disks, bounds, 2);
+        Areas areas = computeAreas(grid, bounds[1][2]);
+        std::cout << "top face leaves, area " << leaf_area;
+        std::cout << ", grid area above bounds " << areas.above << "\n";
+        if (!(std::fabs(areas.total - leaf_area) < 1e-9 * leaf_area)) {
+            std::cout << "  FAIL: area not conserved\n";
+            success = false;
+        }
+        if (!(std::fabs(areas.above - leaf_area / 2) < 
+                    Float(0.01) * leaf_area)) {
+            std::cout << "  FAIL: area above bounds not half\n";
+            success = false;
+        }
+    }
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
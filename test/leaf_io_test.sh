@@ -0,0 +1,167 @@
+#!/bin/sh
+# Test for reading, merging, and splitting output. Writes the same 
+# leaves as GList, OBJ, and relative OBJ, reads each back with -i, and
+# checks that the leaves match the originals to the precision of the 
+# text. Then merges two OBJs, splits the result by count and by cell,
+# and checks that every face index of every file resolves to the right
+# vertices, by resolving faces to vertex positions and comparing them 
+# against the inputs. GList merge and split are checked the same way, 
+# by instances.
+#
+# Usage: leaf_io_test.sh LEAF_DISK_GEN
+set -e
+leaf_disk_gen="$1"
+dir="$(mktemp -d)"
+trap 'rm -rf "$dir"' EXIT
+cd "$dir"
+scene="-l 1 box --to [2,2,1] sphere"
+
+# Compare files line by line, numbers within the tolerance of the
+# text precision, and everything else exactly.
+compare() {
+    awk '
+        function tokens(line, fields) {
+            gsub(/[<>,]/, " ", line)
+            return split(line, fields)
+        }
+        function isNumber(token) {
+            return token ~ /^[-+]?[0-9]*\.?[0-9]+([eE][-+]?[0-9]+)?$/
+        }
+        NR == FNR {
+            lines[FNR] = $0
+            num_lines = FNR
+            next
+        }
+        {
+            n = tokens(lines[FNR], expected)
+            if (tokens($0, actual) != n) {
+                bad = 1
+            }
+            for (j = 1; j <= n && !bad; j++) {
+                if (expected[j] == actual[j]) {
+                    continue
+                }
+                if (!(isNumber(expected[j]) && isNumber(actual[j]))) {
+                    bad = 1
+                    break
+                }
+                diff = expected[j] - actual[j]
+                size = expected[j] < 0 ? -expected[j] : expected[j]
+                if (diff < 0) {
+                    diff = -diff
+                }
+                if (!(diff <= 1e-5 * (size + 1))) {
+                    bad = 1
+                }
+            }
+            if (bad) {
+                print FILENAME ": line " FNR " differs: " $0 > "/dev/stderr"
+                exit 1
+            }
+        }
+        END {
+            if (bad) {
+                exit 1
+            }
+            if (FNR != num_lines) {
+                print FILENAME ": " FNR " lines, expected " num_lines \
+                      > "/dev/stderr"
+                exit 1
+            }
+        }' "$1" "$2"
+}
+
+# Resolve OBJ faces to vertex positions, absolute or relative, checking
+# that every index refers to a vertex.
+resolve() {
+    for file in "$@"; do
+        awk '
+            $1 == "v" {
+                vers[++num_vers] = $2 " " $3 " " $4
+                next
+            }
+            $1 == "f" {
+                line = "f"
+                for (j = 2; j <= NF; j++) {
+                    split($j, fields, "/")
+                    index_ = fields[1] + 0
+                    if (index_ < 0) {
+                        index_ += num_vers + 1
+                    }
+                    if (!(index_ >= 1 && index_ <= num_vers)) {
+                        print FILENAME ": bad face index " $j \
+                              " after " num_vers " vertices" > "/dev/stderr"
+                        bad = 1
+                        exit 1
+                    }
+                    line = line " " vers[index_]
+                }
+                print line
+            }
+            END {
+                if (bad) {
+                    exit 1
+                }
+            }' "$file"
+    done
+}
+
+# Instances of GList files.
+instances() {
+    grep -h "<staticinstance>" "$@"
+}
+
+# Parts of split, in index order.
+parts() {
+    ls "$1"_*."$2" | sort -t _ -k 2 -n
+}
+
+# Read back.
+"$leaf_disk_gen" -o leaves.glist $scene > /dev/null
+"$leaf_disk_gen" -o leaves.obj $scene > /dev/null
+"$leaf_disk_gen" -o relative.obj -or $scene > /dev/null
+"$leaf_disk_gen" -i leaves.glist -o glist_glist.glist > /dev/null
+"$leaf_disk_gen" -i leaves.glist -o glist_obj.obj > /dev/null
+"$leaf_disk_gen" -i leaves.obj -o obj_obj.obj > /dev/null
+"$leaf_disk_gen" -i relative.obj -o relative_obj.obj > /dev/null
+compare leaves.glist glist_glist.glist
+compare leaves.obj glist_obj.obj
+compare leaves.obj obj_obj.obj
+compare leaves.obj relative_obj.obj
+echo "$(grep -c "<staticinstance>" leaves.glist) leaves read back"
+
+# Merge OBJ, absolute and relative, and GList.
+"$leaf_disk_gen" -o other.obj -or -s 2 $scene > /dev/null
+"$leaf_disk_gen" -o other.glist -s 2 $scene > /dev/null
+"$leaf_disk_gen" -mg leaves.obj -mg other.obj -o merged.obj > /dev/null
+"$leaf_disk_gen" -mg leaves.glist -mg other.glist -o merged.glist \
+    > /dev/null
+resolve leaves.obj other.obj > expected.txt
+resolve merged.obj > actual.txt
+cmp expected.txt actual.txt
+instances leaves.glist other.glist > expected.txt
+instances merged.glist > actual.txt
+cmp expected.txt actual.txt
+echo "$(grep -c '^f' merged.obj) faces merged"
+
+# Split by count, in order.
+"$leaf_disk_gen" -sp merged.obj -sn 100 -o count.obj > /dev/null
+"$leaf_disk_gen" -sp merged.glist -sn 100 -o count.glist > /dev/null
+resolve merged.obj > expected.txt
+resolve $(parts count obj) > actual.txt
+cmp expected.txt actual.txt
+instances merged.glist > expected.txt
+instances $(parts count glist) > actual.txt
+cmp expected.txt actual.txt
+echo "$(parts count obj | wc -l) parts split by count"
+
+# Split by cell, in any order.
+"$leaf_disk_gen" -sp merged.obj -sc 1 -o cell.obj > /dev/null
+"$leaf_disk_gen" -sp merged.glist -sc 1 -o cell.glist > /dev/null
+resolve merged.obj | sort > expected.txt
+resolve cell_*.obj | sort > actual.txt
+cmp expected.txt actual.txt
+instances merged.glist | sort > expected.txt
+instances cell_*.glist | sort > actual.txt
+cmp expected.txt actual.txt
+echo "$(ls cell_*.obj | wc -l) parts split by cell"
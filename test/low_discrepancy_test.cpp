@@ -0,0 +1,162 @@
+/* Copyright (c) 2020 M. Grady Saunders
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ *   1. Redistributions of source code must retain the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer.
+ * 
+ *   2. Redistributions in binary form must reproduce the above
+ *      copyright notice, this list of conditions and the following
+ *      disclaimer in the documentation and/or other materials
+ *      provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*+-+*/
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <leaf-disk-gen/leaf_angle_distribution.hpp>
+#include <leaf-disk-gen/low_discrepancy.hpp>
+
+// Validates that randomized low-discrepancy sequences reduce the 
+// variance over seeds of leaf estimates, without biasing them. Over 
+// each seed, estimates G at 60 degrees zenith and the mean height of 
+// as many leaves as a 1x1x1 box at LAI 1, the same way leaf-disk-gen 
+// samples normals and positions for each sampler.
+
+using namespace ld;
+
+namespace {
+
+// Number of seeds.
+constexpr int num_seeds = 64;
+
+// Number of leaves per seed.
+constexpr int num_leaves = 127;
+
+// Mean and standard deviation over seeds.
+struct Stats
+{
+    Float mean = 0;
+    Float stddev = 0;
+};
+
+// Compute stats.
+Stats computeStats(const std::vector<Float>& values)
+{
+    Stats stats;
+    for (Float value : values) {
+        stats.mean += value;
+    }
+    stats.mean /= values.size();
+    for (Float value : values) {
+        stats.stddev += (value - stats.mean) * (value - stats.mean);
+    }
+    stats.stddev = std::sqrt(stats.stddev / (values.size() - 1));
+    return stats;
+}
+
+// Estimates over seeds.
+struct Estimates
+{
+    Stats g;
+    Stats height;
+};
+
+// Estimate over seeds, where sampler is "random", "sobol", or 
+// "halton".
+Estimates estimate(
+            const LeafAngleDistribution& distribution,
+            const std::string& sampler)
+{
+    Float theta = pre::numeric_constants<Float>::M_pi() / 3;
+    Vec3<Float> dir = {std::sin(theta), 0, std::cos(theta)};
+    std::vector<Float> g_values;
+    std::vector<Float> height_values;
+    for (int seed = 0; seed < num_seeds; seed++) {
+        Float g = 0;
+        Float height = 0;
+        if (sampler == "random") {
+            Pcg32 pcg(hashCombine(seed, 0));
+            for (int k = 0; k < num_leaves; k++) {
+                height += generateCanonical3(pcg)[2];
+                g += std::fabs(
+                     pre::dot(dir, distribution.sampleNormal(pcg)));
+            }
+        }
+        else {
+            LowDiscrepancySequence sequence(
+                LowDiscrepancySequence::typeFromString(sampler), 
+                hashCombine(seed, 0));
+            for (int k = 0; k < num_leaves; k++) {
+                height += sequence.generate3(k, 0)[2];
+                g += std::fabs(pre::dot(dir, 
+                     distribution.sampleNormal(sequence.generate2(k, 3))));
+            }
+        }
+        g_values.push_back(g / num_leaves);
+        height_values.push_back(height / num_leaves);
+    }
+    return {computeStats(g_values), computeStats(height_values)};
+}
+
+} // namespace
+
+int main()
+{
+    bool success = true;
+    std::cout << std::fixed << std::setprecision(4);
+    for (const char* name : {"Trigonometric Planophile", "Beckmann 0.5 0.5"}) {
+        LeafAngleDistributionVariant variant = 
+            LeafAngleDistribution::variantFromString(name);
+        const LeafAngleDistribution& distribution = 
+            toLeafAngleDistribution(variant);
+        Estimates random = estimate(distribution, "random");
+        std::cout << name << "\n";
+        for (const char* sampler : {"random", "sobol", "halton"}) {
+            Estimates estimates = estimate(distribution, sampler);
+            std::cout << "  " << std::setw(6) << sampler;
+            std::cout << "  G(60) " << estimates.g.mean;
+            std::cout << " +/- " << estimates.g.stddev;
+            std::cout << "  height " << estimates.height.mean;
+            std::cout << " +/- " << estimates.height.stddev << "\n";
+
+            // Unbiased, within 4 standard errors of random.
+            Float g_error = 4 * random.g.stddev / std::sqrt(num_seeds);
+            Float height_error = 
+                4 * random.height.stddev / std::sqrt(num_seeds);
+            if (!(std::fabs(estimates.g.mean - random.g.mean) < g_error &&
+                  std::fabs(estimates.height.mean - Float(0.5)) < 
+                  height_error)) {
+                std::cout << "  FAIL: biased\n";
+                success = false;
+            }
+
+            // At least halves the standard deviation of random.
+            if (sampler != std::string("random") &&
+                !(estimates.g.stddev < random.g.stddev / 2 &&
+                  estimates.height.stddev < random.height.stddev / 2)) {
+                std::cout << "  FAIL: no variance reduction\n";
+                success = false;
+            }
+        }
+    }
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Test for relative OBJ output. Writes the same leaves with absolute and
+# relative (negative) vertex indices, resolves the faces of each to the
+# vertex positions they refer to, and checks that the geometry matches,
+# and that the relative output is in fact relative.
+#
+# Usage: obj_relative_test.sh LEAF_DISK_GEN
+set -e
+leaf_disk_gen="$1"
+dir="$(mktemp -d)"
+trap 'rm -rf "$dir"' EXIT
+for mode in absolute relative; do
+    if [ "$mode" = relative ]; then
+        relative=-or
+    else
+        relative=
+    fi
+    "$leaf_disk_gen" -o "$dir/$mode.obj" $relative -ov 5 -l 2 \
+        box --to "[2,2,1]" sphere > /dev/null
+    awk -v mode="$mode" '
+        $1 == "v" {
+            vers[++num_vers] = $2 " " $3 " " $4
+            next
+        }
+        $1 == "f" {
+            line = "f"
+            for (j = 2; j <= NF; j++) {
+                split($j, fields, "/")
+                index_ = fields[1] + 0
+                if (index_ < 0) {
+                    num_negative++
+                    index_ += num_vers + 1
+                }
+                if (!(index_ >= 1 && index_ <= num_vers)) {
+                    print mode ": bad face index " $j \
+                          " after " num_vers " vertices" > "/dev/stderr"
+                    bad = 1
+                    exit 1
+                }
+                line = line " " vers[index_]
+            }
+            print line
+            num_faces++
+            next
+        }
+        {
+            print
+        }
+        END {
+            if (bad) {
+                exit 1
+            }
+            if (num_faces == 0) {
+                print mode ": no faces" > "/dev/stderr"
+                exit 1
+            }
+            if (mode == "relative" && num_negative == 0) {
+                print mode ": no relative indices" > "/dev/stderr"
+                exit 1
+            }
+        }' "$dir/$mode.obj" > "$dir/$mode.txt"
+done
+cmp "$dir/absolute.txt" "$dir/relative.txt"
+echo "$(grep -c '^f' "$dir/absolute.txt") faces match"
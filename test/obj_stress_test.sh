@@ -0,0 +1,42 @@
+#!/bin/sh
+# Stress test for 64-bit OBJ output. Streams a box of SIZE x SIZE meters
+# at LAI 10 and 33 vertices per leaf through a pipe, under a virtual 
+# memory limit, and checks that every face index refers to the vertices
+# of the latest leaf. By default, SIZE is 400, for about 2e8 leaves and
+# 6.6e9 vertices, which takes hours.
+#
+# Usage: obj_stress_test.sh LEAF_DISK_GEN [SIZE]
+set -e
+leaf_disk_gen="$1"
+size="${2:-400}"
+ver_res=32
+dir="$(mktemp -d)"
+trap 'rm -rf "$dir"' EXIT
+ln -s /dev/fd/3 "$dir/leaves.obj"
+(
+    # Generous for thread stacks, but far less than the output.
+    ulimit -v 2097152
+    "$leaf_disk_gen" -o "$dir/leaves.obj" -ov "$ver_res" -l 10 \
+        box --to "[$size,$size,1]" 3>&1 > /dev/null || 
+        touch "$dir/failed"
+) | 
+awk -v ver_res="$ver_res" '
+    $1 == "v" {
+        num_vers++
+    }
+    $1 == "f" {
+        for (j = 2; j <= NF; j++) {
+            if (!($j > num_vers - ver_res - 1 && $j <= num_vers)) {
+                print "bad face index " $j " after " num_vers " vertices"
+                bad = 1
+                exit
+            }
+        }
+    }
+    END {
+        if (bad) {
+            exit 1
+        }
+        printf "%.0f vertices\n", num_vers
+    }'
+test ! -e "$dir/failed"